@@ -0,0 +1,583 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "apu.h"
+#include "mixer.h"
+#include "../memory/memory.h"
+#include "../util/util.h"
+
+#define WAVE_RAM 0xFF30
+
+// The step in the output of a channel for each level of its volume.
+#define LEVEL_SCALE 64
+
+// The waveforms of the square channel duty cycles, one bit per step.
+static const uint8_t duty_cycles[] = {0x80, 0x81, 0xE1, 0x7E};
+
+// The bits of FF10 - FF2F that always read as 1.
+static const uint8_t read_masks[] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF, // NR10 - NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF, // NR21 - NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF, // NR30 - NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF, // NR41 - NR44
+    0x00, 0x00, 0x70, 0xFF, 0xFF, // NR50 - NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF
+};
+
+APU::APU() {
+    cycles = 0;
+    next_event = APU_NO_EVENT;
+
+    time = 0;
+    next_step = FRAME_SEQUENCER_PERIOD;
+    step = 0;
+
+    // The registers as the boot ROM leaves them.
+    memset(registers, 0xFF, sizeof(registers));
+    reg(NR_10) = 0x80;
+    reg(NR_11) = 0xBF;
+    reg(NR_12) = 0xF3;
+    reg(NR_14) = 0xBF;
+    reg(NR_21) = 0x3F;
+    reg(NR_22) = 0x00;
+    reg(NR_24) = 0xBF;
+    reg(NR_30) = 0x7F;
+    reg(NR_31) = 0xFF;
+    reg(NR_32) = 0x9F;
+    reg(NR_34) = 0xBF;
+    reg(NR_41) = 0xFF;
+    reg(NR_42) = 0x00;
+    reg(NR_43) = 0x00;
+    reg(NR_44) = 0xBF;
+    reg(NR_50) = 0x77;
+    reg(NR_51) = 0xF3;
+    reg(NR_52) = 0xF1;
+    powered = true;
+
+    memset(channels, 0, sizeof(channels));
+    channels[NOISE].lfsr = 0x7FFF;
+
+    // The boot sound has faded out, but channel 1 is still on.
+    channels[SQUARE_1].enabled = true;
+    channels[SQUARE_1].dac_enabled = true;
+    channels[SQUARE_1].length = 64;
+
+    sweep_enabled = false;
+    sweep_frequency = 0;
+    sweep_timer = 8;
+
+    sink = nullptr;
+    frame_start = 0;
+    rate_ratio = 1;
+    block_frames = 0;
+}
+
+inline uint8_t& APU::reg(uint16_t address) {
+    return registers[address - NR_10];
+}
+
+/*
+ * @return: The address of the first register of a channel, NRx0.
+ */
+static inline uint16_t channel_base(int channel) {
+    return NR_10 + 5 * channel;
+}
+
+inline uint16_t APU::frequency(int channel) {
+    uint16_t base = channel_base(channel);
+    return reg(base + 3) | ((reg(base + 4) & 0b111) << 8);
+}
+
+uint32_t APU::period(int channel) {
+    if (channel == NOISE) {
+        uint8_t nr43 = reg(NR_43);
+        uint8_t shift = nr43 >> 4;
+        uint8_t divisor = nr43 & 0b111;
+
+        // The noise channel isn't clocked at all with the top two shifts.
+        if (shift >= 14) {
+            return 0;
+        }
+        return (divisor == 0 ? 8 : divisor * 16) << shift;
+    }
+    return (2048 - frequency(channel)) * (channel == WAVE ? 2 : 4);
+}
+
+int APU::amplitude(int channel) {
+    SoundChannel & c = channels[channel];
+    if (!c.enabled) {
+        return 0;
+    }
+
+    if (channel == WAVE) {
+        uint8_t volume_code = (reg(NR_32) >> 5) & 0b11;
+        if (volume_code == 0) {
+            return 0;
+        }
+
+        uint8_t samples = registers[WAVE_RAM - NR_10 + c.position / 2];
+        uint8_t sample = c.position & 1 ? samples & 0x0F : samples >> 4;
+        return sample >> (volume_code - 1);
+    }
+    else if (channel == NOISE) {
+        return c.lfsr & 1 ? 0 : c.volume;
+    }
+
+    uint8_t duty = reg(channel_base(channel) + 1) >> 6;
+    return (duty_cycles[duty] >> c.position) & 1 ? c.volume : 0;
+}
+
+void APU::update_output(int channel, uint64_t at) {
+    if (sink == nullptr) {
+        return;
+    }
+
+    SoundChannel & c = channels[channel];
+    int level = amplitude(channel);
+
+    if (level != c.output) {
+        buffers[channel].add_delta(static_cast<uint32_t>(at - frame_start), (level - c.output) * LEVEL_SCALE);
+        c.output = level;
+    }
+}
+
+void APU::run_channel(int channel, uint64_t end) {
+    SoundChannel & c = channels[channel];
+    uint32_t p = period(channel);
+
+    if (!c.enabled or p == 0) {
+        return;
+    }
+
+    uint64_t t = time + c.timer;
+
+    if (channel == NOISE) {
+        bool short_mode = get_bit(reg(NR_43), 3);
+
+        for (; t < end; t += p) {
+            uint16_t bit = (c.lfsr ^ (c.lfsr >> 1)) & 1;
+            c.lfsr = (c.lfsr >> 1) | (bit << 14);
+            if (short_mode) {
+                c.lfsr = (c.lfsr & ~0x40) | (bit << 6);
+            }
+            update_output(channel, t);
+        }
+    }
+    else {
+        uint8_t mask = channel == WAVE ? 31 : 7;
+
+        if (c.output == 0 and amplitude(channel) == 0 and
+            (channel == WAVE ? (reg(NR_32) & 0x60) == 0 : c.volume == 0)) {
+            // The channel is silent, so only the position needs to move on.
+            if (t < end) {
+                uint64_t steps = (end - t + p - 1) / p;
+                c.position = (c.position + steps) & mask;
+                t += steps * p;
+            }
+        }
+
+        for (; t < end; t += p) {
+            c.position = (c.position + 1) & mask;
+            update_output(channel, t);
+        }
+    }
+
+    c.timer = static_cast<uint32_t>(t - end);
+}
+
+void APU::clock_frame_sequencer() {
+    if (powered) {
+        if (step % 2 == 0) {
+            for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+                clock_length(channel);
+            }
+        }
+        if (step == 2 or step == 6) {
+            clock_sweep();
+        }
+        if (step == 7) {
+            clock_envelope(SQUARE_1);
+            clock_envelope(SQUARE_2);
+            clock_envelope(NOISE);
+        }
+    }
+    step = (step + 1) & 7;
+}
+
+void APU::clock_length(int channel) {
+    SoundChannel & c = channels[channel];
+
+    if (c.length_enabled and c.length > 0) {
+        c.length -= 1;
+        if (c.length == 0) {
+            disable(channel);
+        }
+    }
+}
+
+void APU::clock_envelope(int channel) {
+    SoundChannel & c = channels[channel];
+    uint8_t envelope = reg(channel_base(channel) + 2);
+    uint8_t envelope_period = envelope & 0b111;
+
+    if (envelope_period == 0) {
+        return;
+    }
+
+    c.envelope_timer -= 1;
+    if (c.envelope_timer == 0) {
+        c.envelope_timer = envelope_period;
+
+        if (get_bit(envelope, 3) and c.volume < 15) {
+            c.volume += 1;
+            update_output(channel, time);
+        }
+        else if (!get_bit(envelope, 3) and c.volume > 0) {
+            c.volume -= 1;
+            update_output(channel, time);
+        }
+    }
+}
+
+void APU::clock_sweep() {
+    if (sweep_timer > 0) {
+        sweep_timer -= 1;
+    }
+    if (sweep_timer != 0) {
+        return;
+    }
+
+    uint8_t sweep_period = (reg(NR_10) >> 4) & 0b111;
+    sweep_timer = sweep_period == 0 ? 8 : sweep_period;
+
+    if (sweep_enabled and sweep_period != 0) {
+        uint16_t f = next_sweep_frequency();
+
+        if (f <= 2047 and (reg(NR_10) & 0b111) != 0) {
+            sweep_frequency = f;
+            reg(NR_13) = f & 0xFF;
+            reg(NR_14) = (reg(NR_14) & ~0b111) | (f >> 8);
+
+            // The next frequency is only checked for overflow.
+            next_sweep_frequency();
+        }
+    }
+}
+
+uint16_t APU::next_sweep_frequency() {
+    uint16_t delta = sweep_frequency >> (reg(NR_10) & 0b111);
+    uint16_t f = get_bit(reg(NR_10), 3) ? sweep_frequency - delta : sweep_frequency + delta;
+
+    if (f > 2047) {
+        disable(SQUARE_1);
+    }
+    return f;
+}
+
+void APU::trigger(int channel) {
+    SoundChannel & c = channels[channel];
+    uint8_t envelope = reg(channel_base(channel) + 2);
+
+    c.enabled = c.dac_enabled;
+    if (c.length == 0) {
+        c.length = channel == WAVE ? 256 : 64;
+    }
+    c.timer = period(channel);
+    c.volume = envelope >> 4;
+    c.envelope_timer = (envelope & 0b111) == 0 ? 8 : envelope & 0b111;
+
+    if (channel == WAVE) {
+        c.position = 0;
+    }
+    else if (channel == NOISE) {
+        c.lfsr = 0x7FFF;
+    }
+    else if (channel == SQUARE_1) {
+        uint8_t sweep_period = (reg(NR_10) >> 4) & 0b111;
+        uint8_t sweep_shift = reg(NR_10) & 0b111;
+
+        sweep_frequency = frequency(SQUARE_1);
+        sweep_timer = sweep_period == 0 ? 8 : sweep_period;
+        sweep_enabled = sweep_period != 0 or sweep_shift != 0;
+        if (sweep_shift != 0) {
+            next_sweep_frequency();
+        }
+    }
+
+    update_output(channel, time);
+}
+
+void APU::disable(int channel) {
+    channels[channel].enabled = false;
+    update_output(channel, time);
+}
+
+void APU::power_off() {
+    for (uint16_t address = NR_10; address <= NR_51; address++) {
+        reg(address) = 0;
+    }
+
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        disable(channel);
+        channels[channel].dac_enabled = false;
+        channels[channel].length_enabled = false;
+    }
+    powered = false;
+}
+
+void APU::run(uint64_t until) {
+    while (time < until) {
+        uint64_t end = until < next_step ? until : next_step;
+
+        if (sink != nullptr) {
+            for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+                run_channel(channel, end);
+            }
+        }
+        time = end;
+
+        if (time == next_step) {
+            clock_frame_sequencer();
+            next_step += FRAME_SEQUENCER_PERIOD;
+        }
+    }
+
+    if (sink != nullptr) {
+        for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+            buffers[channel].end_frame(static_cast<uint32_t>(time - frame_start));
+        }
+        frame_start = time;
+        mix_samples();
+    }
+    schedule();
+}
+
+void APU::mix_samples() {
+    int avail = buffers[0].samples_avail();
+
+    while (avail > 0) {
+        int count = avail < AUDIO_BLOCK_FRAMES - block_frames ? avail : AUDIO_BLOCK_FRAMES - block_frames;
+
+        for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+            buffers[channel].read_samples(&channel_samples[channel * AUDIO_BLOCK_FRAMES], count);
+        }
+
+        if (sink->uses_stems()) {
+            sink->write_stems(channel_samples.data(), AUDIO_BLOCK_FRAMES, count);
+        }
+
+        if (sink->uses_float()) {
+            mix_frames(channel_samples.data(), AUDIO_BLOCK_FRAMES, count, reg(NR_50), reg(NR_51),
+                       &float_block[block_frames * 2]);
+        }
+        else {
+            mix_frames(channel_samples.data(), AUDIO_BLOCK_FRAMES, count, reg(NR_50), reg(NR_51),
+                       &block[block_frames * 2]);
+        }
+
+        block_frames += count;
+        avail -= count;
+
+        if (block_frames == AUDIO_BLOCK_FRAMES) {
+            write_block();
+
+            double ratio = sink->get_rate_ratio();
+            if (ratio != rate_ratio) {
+                set_rate_ratio(ratio);
+            }
+        }
+    }
+}
+
+void APU::write_block() {
+    if (sink->uses_float()) {
+        sink->write_frames(float_block.data(), block_frames);
+    }
+    else {
+        sink->write_frames(block.data(), block_frames);
+    }
+    block_frames = 0;
+}
+
+void APU::set_rate_ratio(double ratio) {
+    rate_ratio = ratio;
+    for (StepBuffer & buffer : buffers) {
+        buffer.set_rates(APU_CLOCK_RATE, AUDIO_SAMPLE_RATE * ratio);
+    }
+}
+
+void APU::schedule() {
+    if (sink == nullptr) {
+        next_event = APU_NO_EVENT;
+    }
+    else {
+        next_event = frame_start + buffers[0].clocks_needed(AUDIO_BLOCK_FRAMES - block_frames);
+    }
+}
+
+void APU::handle_event() {
+    run(cycles);
+}
+
+void APU::set_sink(AudioSink *sink) {
+    run(cycles);
+
+    // Hand the last part of a block to the old sink, so it has every frame.
+    if (this->sink != nullptr and block_frames > 0) {
+        write_block();
+    }
+    this->sink = sink;
+
+    if (sink != nullptr) {
+        if (buffers.empty()) {
+            buffers.assign(NUM_SOUND_CHANNELS, StepBuffer(AUDIO_BLOCK_FRAMES * 2));
+            channel_samples.assign(NUM_SOUND_CHANNELS * AUDIO_BLOCK_FRAMES, 0);
+            block.assign(AUDIO_BLOCK_FRAMES * 2, 0);
+            float_block.assign(AUDIO_BLOCK_FRAMES * 2, 0);
+        }
+
+        set_rate_ratio(1);
+        restart_output();
+    }
+    schedule();
+}
+
+void APU::restart_output() {
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        buffers[channel].clear();
+        channels[channel].output = 0;
+    }
+    frame_start = time;
+    block_frames = 0;
+
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        update_output(channel, time);
+    }
+}
+
+void APU::save_state(StateWriter & writer) {
+    writer.write(&cycles, sizeof(cycles));
+    writer.write(&time, sizeof(time));
+    writer.write(&next_step, sizeof(next_step));
+    writer.write(&step, sizeof(step));
+    writer.write(registers, sizeof(registers));
+    writer.write(&powered, sizeof(powered));
+    writer.write(channels, sizeof(channels));
+    writer.write(&sweep_enabled, sizeof(sweep_enabled));
+    writer.write(&sweep_frequency, sizeof(sweep_frequency));
+    writer.write(&sweep_timer, sizeof(sweep_timer));
+}
+
+bool APU::load_state(StateReader & reader) {
+    // Hand the sink everything up to the moment the state is loaded.
+    if (sink != nullptr) {
+        run(cycles);
+        if (block_frames > 0) {
+            write_block();
+        }
+    }
+
+    bool loaded = reader.read(&cycles, sizeof(cycles)) and
+                  reader.read(&time, sizeof(time)) and
+                  reader.read(&next_step, sizeof(next_step)) and
+                  reader.read(&step, sizeof(step)) and
+                  reader.read(registers, sizeof(registers)) and
+                  reader.read(&powered, sizeof(powered)) and
+                  reader.read(channels, sizeof(channels)) and
+                  reader.read(&sweep_enabled, sizeof(sweep_enabled)) and
+                  reader.read(&sweep_frequency, sizeof(sweep_frequency)) and
+                  reader.read(&sweep_timer, sizeof(sweep_timer));
+
+    if (sink != nullptr) {
+        restart_output();
+    }
+    schedule();
+    return loaded;
+}
+
+uint8_t APU::load_byte(uint16_t address) {
+    if (address >= WAVE_RAM) {
+        return registers[address - NR_10];
+    }
+    else if (address == NR_52) {
+        run(cycles);
+
+        uint8_t status = powered ? 0xF0 : 0x70;
+        for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+            if (channels[channel].enabled) {
+                set_bit(status, channel);
+            }
+        }
+        return status;
+    }
+    return reg(address) | read_masks[address - NR_10];
+}
+
+void APU::store_byte(uint16_t address, uint8_t value) {
+    run(cycles);
+
+    if (address >= WAVE_RAM) {
+        registers[address - NR_10] = value;
+        update_output(WAVE, time);
+        return;
+    }
+    else if (address == NR_52) {
+        if (!get_bit(value, 7) and powered) {
+            power_off();
+        }
+        else if (get_bit(value, 7) and !powered) {
+            powered = true;
+            step = 0;
+        }
+        return;
+    }
+    else if (!powered or address > NR_52) {
+        // Ignore writes while the APU is off, and to the unused registers.
+        return;
+    }
+
+    reg(address) = value;
+    if (address >= NR_50) {
+        return;
+    }
+
+    int channel = (address - NR_10) / 5;
+    SoundChannel & c = channels[channel];
+
+    switch ((address - NR_10) % 5) {
+        case 0:
+            if (channel == WAVE) {
+                c.dac_enabled = get_bit(value, 7);
+                if (!c.dac_enabled) {
+                    disable(channel);
+                }
+            }
+            break;
+        case 1:
+            c.length = channel == WAVE ? 256 - value : 64 - (value & 0x3F);
+            break;
+        case 2:
+            if (channel != WAVE) {
+                c.dac_enabled = (value & 0xF8) != 0;
+                if (!c.dac_enabled) {
+                    disable(channel);
+                }
+            }
+            break;
+        case 4:
+            c.length_enabled = get_bit(value, 6);
+            if (get_bit(value, 7)) {
+                trigger(channel);
+            }
+            break;
+        default:
+            break;
+    }
+
+    // The duty cycle or the wave volume may have changed.
+    update_output(channel, time);
+}
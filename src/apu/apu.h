@@ -0,0 +1,204 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_APU_H
+#define GAME_BOY_EMULATOR_APU_H
+
+#include <cstdint>
+#include <vector>
+
+#include "audio_sink.h"
+#include "step_buffer.h"
+#include "../state/state_format.h"
+
+#define APU_CLOCK_RATE 4194304
+#define AUDIO_SAMPLE_RATE 48000
+
+// The number of frames mixed before they are handed to the sink, about 5 ms.
+#define AUDIO_BLOCK_FRAMES 256
+
+// The frame sequencer clocks the length counters, sweep and envelopes at 512 Hz.
+#define FRAME_SEQUENCER_PERIOD 8192
+
+// The deadline of an APU with no sink.
+#define APU_NO_EVENT UINT64_MAX
+
+#define NUM_SOUND_CHANNELS 4
+#define SQUARE_1 0
+#define SQUARE_2 1
+#define WAVE 2
+#define NOISE 3
+
+using namespace std;
+
+/*
+ * The state of one sound channel. Not every field is used by every channel.
+ */
+struct SoundChannel {
+    bool enabled;
+    bool dac_enabled;
+
+    bool length_enabled;
+    uint16_t length;
+
+    // Cycles until the next step of the waveform.
+    uint32_t timer;
+    // The position in the duty cycle or wave RAM.
+    uint8_t position;
+
+    uint8_t volume;
+    uint8_t envelope_timer;
+
+    uint16_t lfsr;
+
+    // The level last sent to the step buffer.
+    int output;
+};
+
+/*
+ * The audio processing unit: two square channels, a wave channel and a noise
+ * channel, and the NR10 - NR52 registers and wave RAM that control them.
+ *
+ * The APU never runs on its own after each instruction. Instead it catches up
+ * to the CPU in one go when it has to: when one of its registers is read or
+ * written, or when enough cycles have passed to fill a block of audio. The
+ * channels report the steps in their output levels to a StepBuffer each, which
+ * band limits them, and the samples are mixed into stereo once the block is
+ * done.
+ *
+ * With no sink to send audio to, the channels aren't synthesized at all. Only
+ * the frame sequencer is run, to keep the length counters and sweep up to
+ * date for the channel status bits in NR52.
+ *
+ * Example usage:
+ *
+ *  apu.set_sink(&sink);
+ *  while (Emulator is running) {
+ *      apu.tick(cycles);
+ *  }
+ */
+class APU {
+
+private:
+
+    uint64_t cycles; // The number of cycles since the APU was created.
+    uint64_t next_event; // The cycle count at which the next block is mixed.
+
+    uint64_t time; // The cycle count the APU has caught up to.
+    uint64_t next_step; // The cycle count of the next frame sequencer step.
+    uint8_t step; // The next frame sequencer step, from 0 to 7.
+
+    // FF10 - FF3F, as they were written.
+    uint8_t registers[0x30];
+    bool powered;
+
+    SoundChannel channels[NUM_SOUND_CHANNELS];
+
+    bool sweep_enabled;
+    uint16_t sweep_frequency;
+    uint8_t sweep_timer;
+
+    AudioSink *sink;
+
+    // The cycle count at the start of the step buffer frame.
+    uint64_t frame_start;
+    // The sample rate, as a multiple of AUDIO_SAMPLE_RATE.
+    double rate_ratio;
+    vector<StepBuffer> buffers;
+    vector<int32_t> channel_samples;
+    vector<int16_t> block;
+    vector<float> float_block;
+    int block_frames;
+
+    uint8_t& reg(uint16_t address);
+
+    uint16_t frequency(int channel);
+    uint32_t period(int channel);
+    int amplitude(int channel);
+
+    /*
+     * Send the level of a channel to its step buffer, if it has changed.
+     *
+     * @param at: The cycle count of the change.
+     */
+    void update_output(int channel, uint64_t at);
+
+    void run_channel(int channel, uint64_t end);
+
+    void clock_frame_sequencer();
+    void clock_length(int channel);
+    void clock_envelope(int channel);
+    void clock_sweep();
+    uint16_t next_sweep_frequency();
+
+    void trigger(int channel);
+    void disable(int channel);
+    void power_off();
+
+    /*
+     * Run the frame sequencer and the channels up to a cycle count, and mix
+     * any samples that are ready.
+     */
+    void run(uint64_t until);
+    void mix_samples();
+    void write_block();
+    void set_rate_ratio(double ratio);
+
+    /*
+     * Start the sink's audio again from the current time, dropping any
+     * samples that haven't been mixed.
+     */
+    void restart_output();
+    void schedule();
+    void handle_event();
+
+public:
+
+    APU();
+
+    /*
+     * Move the cycle count forward, mixing the next block if it is due.
+     *
+     * @param elapsed: The number of cycles that have passed.
+     */
+    inline void tick(uint32_t elapsed) {
+        cycles += elapsed;
+        if (cycles >= next_event) {
+            handle_event();
+        }
+    }
+
+    /*
+     * Start or stop sending audio to a sink.
+     *
+     * @param sink: Receives every block of audio, or nullptr to stop.
+     */
+    void set_sink(AudioSink *sink);
+
+    /*
+     * @return: The current value of a register in FF10 - FF3F.
+     */
+    uint8_t load_byte(uint16_t address);
+
+    /*
+     * Write to a register in FF10 - FF3F.
+     */
+    void store_byte(uint16_t address, uint8_t value);
+
+    /*
+     * Add the state of the APU to a save state. The sink and the samples that
+     * haven't been mixed aren't saved.
+     */
+    void save_state(StateWriter & writer);
+
+    /*
+     * Restore the state of the APU from the open chunk of a save state. The
+     * sink keeps playing, from the restored state onwards.
+     *
+     * @return: False if the chunk is too short.
+     */
+    bool load_state(StateReader & reader);
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <chrono>
+#include <string.h>
+
+#include "audio_output.h"
+#include "apu.h"
+
+// Where the ring is kept. Blocks are written once the ring drops below the
+// limit, so it sits between the two.
+#define AUDIO_TARGET_FRAMES (AUDIO_LATENCY_FRAMES - AUDIO_BLOCK_FRAMES / 2)
+
+AudioOutput::AudioOutput(const char *path) : period(AUDIO_PERIOD_FRAMES * 2, 0), stopping(false),
+                                             underruns(0), max_fill(0) {
+    rate_ratio = 1;
+    is_pipe = path[0] == '|';
+    if (is_pipe) {
+        file = popen(path + 1, "w");
+    }
+    else {
+        file = fopen(path, "wb");
+    }
+    if (file != nullptr) {
+        audio_thread = thread(&AudioOutput::play, this);
+    }
+}
+
+AudioOutput::~AudioOutput() {
+    close();
+}
+
+bool AudioOutput::is_open() {
+    return file != nullptr;
+}
+
+void AudioOutput::play() {
+    // Let the ring fill up to the target first, or the first periods would
+    // run dry.
+    while (!stopping and ring.get_fill() < AUDIO_TARGET_FRAMES) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    chrono::nanoseconds period_length(static_cast<int64_t>(AUDIO_PERIOD_FRAMES) * 1000000000 / AUDIO_SAMPLE_RATE);
+    chrono::steady_clock::time_point next_period = chrono::steady_clock::now();
+
+    while (!stopping) {
+        int fill = ring.get_fill();
+        if (fill > max_fill) {
+            max_fill = fill;
+        }
+
+        int count = ring.read(period.data(), AUDIO_PERIOD_FRAMES);
+        if (count < AUDIO_PERIOD_FRAMES) {
+            // Play silence for the frames that aren't ready.
+            memset(&period[count * 2], 0, (AUDIO_PERIOD_FRAMES - count) * 2 * sizeof(int16_t));
+            underruns += 1;
+        }
+        fwrite(period.data(), sizeof(int16_t), period.size(), file);
+
+        // Start again from now if the thread has fallen far behind, rather
+        // than play a burst of periods to catch up.
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        next_period += period_length;
+        if (now > next_period + period_length * 4) {
+            next_period = now;
+        }
+        this_thread::sleep_until(next_period);
+    }
+}
+
+void AudioOutput::write_frames(const int16_t *frames, int count) {
+    if (file == nullptr) {
+        return;
+    }
+
+    while (count > 0 and !stopping) {
+        int space = AUDIO_LATENCY_FRAMES - ring.get_fill();
+        if (space <= 0) {
+            this_thread::sleep_for(chrono::microseconds(500));
+            continue;
+        }
+
+        int written = ring.write(frames, count < space ? count : space);
+        frames += written * 2;
+        count -= written;
+    }
+
+    // Mix a little faster when the ring is emptier than the target, and a
+    // little slower when it is fuller.
+    double error = static_cast<double>(AUDIO_TARGET_FRAMES - ring.get_fill()) / AUDIO_TARGET_FRAMES;
+    error = error > 1 ? 1 : (error < -1 ? -1 : error);
+    rate_ratio = 1 + AUDIO_MAX_RATE_DELTA * error;
+}
+
+double AudioOutput::get_rate_ratio() {
+    return rate_ratio;
+}
+
+void AudioOutput::close() {
+    stopping = true;
+    if (audio_thread.joinable()) {
+        audio_thread.join();
+    }
+    if (file != nullptr) {
+        if (is_pipe) {
+            pclose(file);
+        }
+        else {
+            fclose(file);
+        }
+        file = nullptr;
+    }
+}
+
+uint64_t AudioOutput::get_underruns() {
+    return underruns;
+}
+
+double AudioOutput::get_max_latency() {
+    return (max_fill + AUDIO_PERIOD_FRAMES) * 1000.0 / AUDIO_SAMPLE_RATE;
+}
@@ -0,0 +1,113 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_AUDIO_OUTPUT_H
+#define GAME_BOY_EMULATOR_AUDIO_OUTPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "audio_sink.h"
+#include "audio_ring.h"
+
+// The most frames that are waiting to be played, about 21 ms. The emulator
+// waits for the audio thread rather than go over this.
+#define AUDIO_LATENCY_FRAMES 1024
+
+// The number of frames the audio thread plays at a time, about 5 ms.
+#define AUDIO_PERIOD_FRAMES 256
+
+// The most the sample rate is changed by to keep the ring on target.
+#define AUDIO_MAX_RATE_DELTA 0.005
+
+using namespace std;
+
+/*
+ * Plays the audio from the APU in real time, by writing it as raw 16 bit
+ * stereo samples at 48 kHz to a player such as aplay, through a pipe.
+ *
+ * The frames are passed to an audio thread through an AudioRing. The audio
+ * thread wakes up every AUDIO_PERIOD_FRAMES frames, like the callback of a
+ * sound card, and writes out a period whether or not the emulator has kept
+ * up. This makes the audio the clock the emulator runs to: it waits in
+ * write_frames whenever it gets more than AUDIO_LATENCY_FRAMES ahead.
+ *
+ * The sample rate the APU mixes at is also nudged up or down by up to
+ * AUDIO_MAX_RATE_DELTA, depending on how full the ring is, so that it stays
+ * near its target rather than running dry or making the emulator wait.
+ *
+ * Example usage:
+ *
+ *  AudioOutput output("|aplay -f S16_LE -c 2 -r 48000");
+ *  apu.set_sink(&output);
+ *  // Run the emulator.
+ *  apu.set_sink(nullptr);
+ *  output.close();
+ */
+class AudioOutput : public AudioSink {
+
+private:
+
+    FILE *file;
+    bool is_pipe;
+
+    AudioRing ring;
+    vector<int16_t> period;
+
+    thread audio_thread;
+    atomic<bool> stopping;
+
+    // Only changed on the emulation thread.
+    double rate_ratio;
+
+    // Only changed on the audio thread.
+    atomic<uint64_t> underruns;
+    atomic<int> max_fill;
+
+    /*
+     * The audio thread.
+     */
+    void play();
+
+public:
+
+    /*
+     * Open the file and start the audio thread.
+     *
+     * @param path: The file to write to, or a command to pipe to after a '|'.
+     */
+    AudioOutput(const char *path);
+
+    ~AudioOutput();
+
+    /*
+     * @return: True if the file could be opened.
+     */
+    bool is_open();
+
+    void write_frames(const int16_t *frames, int count);
+
+    double get_rate_ratio();
+
+    /*
+     * Stop the audio thread and close the file.
+     */
+    void close();
+
+    /*
+     * @return: The number of periods the emulator didn't keep up with.
+     */
+    uint64_t get_underruns();
+
+    /*
+     * @return: The longest time a frame has waited to be played, in
+     * milliseconds.
+     */
+    double get_max_latency();
+};
+
+#endif
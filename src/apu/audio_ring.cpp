@@ -0,0 +1,60 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "audio_ring.h"
+
+#define RING_MASK (AUDIO_RING_FRAMES - 1)
+
+AudioRing::AudioRing() : samples(AUDIO_RING_FRAMES * 2, 0), written(0), read_count(0) {
+}
+
+/*
+ * Copy frames between a ring and a flat buffer, wrapping around the end of
+ * the ring.
+ *
+ * @param to_ring: True to copy from the buffer into the ring.
+ */
+static void copy_frames(int16_t *ring, uint64_t position, int16_t *buffer, int count, bool to_ring) {
+    int start = position & RING_MASK;
+    int first = count < AUDIO_RING_FRAMES - start ? count : AUDIO_RING_FRAMES - start;
+
+    if (to_ring) {
+        memcpy(ring + start * 2, buffer, first * 2 * sizeof(int16_t));
+        memcpy(ring, buffer + first * 2, (count - first) * 2 * sizeof(int16_t));
+    }
+    else {
+        memcpy(buffer, ring + start * 2, first * 2 * sizeof(int16_t));
+        memcpy(buffer + first * 2, ring, (count - first) * 2 * sizeof(int16_t));
+    }
+}
+
+int AudioRing::write(const int16_t *frames, int count) {
+    uint64_t n = written.load(memory_order_relaxed);
+    int space = AUDIO_RING_FRAMES - static_cast<int>(n - read_count.load(memory_order_acquire));
+    if (count > space) {
+        count = space;
+    }
+
+    copy_frames(samples.data(), n, const_cast<int16_t *>(frames), count, true);
+    written.store(n + count, memory_order_release);
+    return count;
+}
+
+int AudioRing::read(int16_t *frames, int count) {
+    uint64_t n = read_count.load(memory_order_relaxed);
+    int fill = static_cast<int>(written.load(memory_order_acquire) - n);
+    if (count > fill) {
+        count = fill;
+    }
+
+    copy_frames(samples.data(), n, frames, count, false);
+    read_count.store(n + count, memory_order_release);
+    return count;
+}
+
+int AudioRing::get_fill() {
+    return static_cast<int>(written.load(memory_order_acquire) - read_count.load(memory_order_acquire));
+}
@@ -0,0 +1,70 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_AUDIO_RING_H
+#define GAME_BOY_EMULATOR_AUDIO_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// The number of stereo frames the ring holds. Must be a power of 2.
+#define AUDIO_RING_FRAMES 2048
+
+using namespace std;
+
+/*
+ * A ring of stereo frames from the emulation thread to the audio thread,
+ * which never locks. Only one thread may write and only one may read.
+ *
+ * Example usage:
+ *
+ *  // On the emulation thread.
+ *  ring.write(frames, count);
+ *
+ *  // On the audio thread.
+ *  ring.read(out, count);
+ */
+class AudioRing {
+
+private:
+
+    vector<int16_t> samples;
+
+    // The number of frames written and read. Each is only changed by one
+    // thread.
+    atomic<uint64_t> written;
+    atomic<uint64_t> read_count;
+
+public:
+
+    AudioRing();
+
+    /*
+     * Called by the writing thread.
+     *
+     * @param frames: The stereo frames to add.
+     * @param count: The number of frames.
+     * @return: The number of frames added, which is less than count if the
+     * ring fills up.
+     */
+    int write(const int16_t *frames, int count);
+
+    /*
+     * Called by the reading thread.
+     *
+     * @param frames: Where to copy the frames to.
+     * @param count: The number of frames wanted.
+     * @return: The number of frames copied, which is less than count if the
+     * ring runs out.
+     */
+    int read(int16_t *frames, int count);
+
+    /*
+     * @return: The number of frames waiting to be read.
+     */
+    int get_fill();
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_AUDIO_SINK_H
+#define GAME_BOY_EMULATOR_AUDIO_SINK_H
+
+#include <cstdint>
+
+/*
+ * Receives the audio mixed by the APU, one block at a time.
+ */
+class AudioSink {
+
+public:
+
+    virtual ~AudioSink() {}
+
+    /*
+     * @return: True if the sink takes samples from -1 to 1, rather than 16
+     * bit samples.
+     */
+    virtual bool uses_float() {
+        return false;
+    }
+
+    /*
+     * Called by the APU on the emulation thread whenever a block is mixed.
+     *
+     * @param frames: The stereo frames, with the left and right samples of each
+     * frame next to each other.
+     * @param count: The number of frames.
+     */
+    virtual void write_frames(const int16_t *frames, int count) {}
+
+    /*
+     * The same as above, for a sink that uses floats.
+     */
+    virtual void write_frames(const float *frames, int count) {}
+
+    /*
+     * @return: True if the sink wants the samples of each channel as well.
+     */
+    virtual bool uses_stems() {
+        return false;
+    }
+
+    /*
+     * Called with the samples of each channel before they are panned and
+     * mixed. The samples for a block come before the block itself, and may be
+     * split over several calls.
+     *
+     * @param samples: The samples of each channel, one channel after the other.
+     * @param stride: The distance between the first samples of two channels.
+     * @param count: The number of samples of each channel.
+     */
+    virtual void write_stems(const int32_t *samples, int stride, int count) {}
+
+    /*
+     * Asked after every block, to let the sink speed up or slow down the
+     * audio a little to match the rate it is played at.
+     *
+     * @return: The amount to multiply the sample rate by.
+     */
+    virtual double get_rate_ratio() {
+        return 1;
+    }
+};
+
+#endif
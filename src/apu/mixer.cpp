@@ -0,0 +1,205 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mixer.h"
+#include "apu.h"
+
+#define SAMPLE_LIMIT 32767.0f
+#define FLOAT_SCALE (1.0f / 32768.0f)
+
+/*
+ * The masks and volumes that NR50 and NR51 turn into.
+ */
+struct MixGains {
+    // All 1 bits if a channel goes to the speaker, otherwise 0.
+    int32_t left_mask[NUM_SOUND_CHANNELS];
+    int32_t right_mask[NUM_SOUND_CHANNELS];
+
+    float left_volume;
+    float right_volume;
+};
+
+static MixGains get_gains(uint8_t nr50, uint8_t nr51) {
+    MixGains gains;
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        gains.left_mask[channel] = (nr51 >> (channel + 4)) & 1 ? -1 : 0;
+        gains.right_mask[channel] = (nr51 >> channel) & 1 ? -1 : 0;
+    }
+    gains.left_volume = static_cast<float>(((nr50 >> 4) & 0b111) + 1);
+    gains.right_volume = static_cast<float>((nr50 & 0b111) + 1);
+    return gains;
+}
+
+/*
+ * Mix one frame, with each speaker clipped to the range of a 16 bit sample.
+ */
+static inline void mix_frame_scalar(const int32_t *samples, int stride, int i, const MixGains & gains,
+                                    float & left, float & right) {
+    int32_t l = 0;
+    int32_t r = 0;
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        int32_t sample = samples[channel * stride + i];
+        l += sample & gains.left_mask[channel];
+        r += sample & gains.right_mask[channel];
+    }
+
+    left = static_cast<float>(l) * gains.left_volume;
+    right = static_cast<float>(r) * gains.right_volume;
+    left = left > SAMPLE_LIMIT ? SAMPLE_LIMIT : (left < -SAMPLE_LIMIT ? -SAMPLE_LIMIT : left);
+    right = right > SAMPLE_LIMIT ? SAMPLE_LIMIT : (right < -SAMPLE_LIMIT ? -SAMPLE_LIMIT : right);
+}
+
+static void mix_scalar(const int32_t *samples, int stride, int start, int count, const MixGains & gains,
+                       int16_t *out) {
+    for (int i = start; i < count; i++) {
+        float left, right;
+        mix_frame_scalar(samples, stride, i, gains, left, right);
+        out[2 * i] = static_cast<int16_t>(left);
+        out[2 * i + 1] = static_cast<int16_t>(right);
+    }
+}
+
+static void mix_scalar(const int32_t *samples, int stride, int start, int count, const MixGains & gains,
+                       float *out) {
+    for (int i = start; i < count; i++) {
+        float left, right;
+        mix_frame_scalar(samples, stride, i, gains, left, right);
+        out[2 * i] = left * FLOAT_SCALE;
+        out[2 * i + 1] = right * FLOAT_SCALE;
+    }
+}
+
+#if defined(__AVX2__)
+
+/*
+ * Mix 8 frames into a speaker each, clipped to the range of a 16 bit sample.
+ */
+static inline void mix_vector(const int32_t *samples, int stride, int i, const MixGains & gains,
+                              __m256 & left, __m256 & right) {
+    __m256i l = _mm256_setzero_si256();
+    __m256i r = _mm256_setzero_si256();
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + channel * stride + i));
+        l = _mm256_add_epi32(l, _mm256_and_si256(s, _mm256_set1_epi32(gains.left_mask[channel])));
+        r = _mm256_add_epi32(r, _mm256_and_si256(s, _mm256_set1_epi32(gains.right_mask[channel])));
+    }
+
+    __m256 high = _mm256_set1_ps(SAMPLE_LIMIT);
+    __m256 low = _mm256_set1_ps(-SAMPLE_LIMIT);
+    left = _mm256_mul_ps(_mm256_cvtepi32_ps(l), _mm256_set1_ps(gains.left_volume));
+    right = _mm256_mul_ps(_mm256_cvtepi32_ps(r), _mm256_set1_ps(gains.right_volume));
+    left = _mm256_max_ps(_mm256_min_ps(left, high), low);
+    right = _mm256_max_ps(_mm256_min_ps(right, high), low);
+}
+
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, int16_t *out) {
+    MixGains gains = get_gains(nr50, nr51);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 left, right;
+        mix_vector(samples, stride, i, gains, left, right);
+
+        // The unpacks and the pack both work within 128-bit lanes, so the
+        // frames end up in order.
+        __m256i l = _mm256_cvttps_epi32(left);
+        __m256i r = _mm256_cvttps_epi32(right);
+        __m256i frames = _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i), frames);
+    }
+    mix_scalar(samples, stride, i, count, gains, out);
+}
+
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, float *out) {
+    MixGains gains = get_gains(nr50, nr51);
+    __m256 scale = _mm256_set1_ps(FLOAT_SCALE);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 left, right;
+        mix_vector(samples, stride, i, gains, left, right);
+
+        left = _mm256_mul_ps(left, scale);
+        right = _mm256_mul_ps(right, scale);
+        __m256 low = _mm256_unpacklo_ps(left, right);
+        __m256 high = _mm256_unpackhi_ps(left, right);
+        _mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+        _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+    }
+    mix_scalar(samples, stride, i, count, gains, out);
+}
+
+#elif defined(__SSE2__)
+
+/*
+ * Mix 4 frames into a speaker each, clipped to the range of a 16 bit sample.
+ */
+static inline void mix_vector(const int32_t *samples, int stride, int i, const MixGains & gains,
+                              __m128 & left, __m128 & right) {
+    __m128i l = _mm_setzero_si128();
+    __m128i r = _mm_setzero_si128();
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + channel * stride + i));
+        l = _mm_add_epi32(l, _mm_and_si128(s, _mm_set1_epi32(gains.left_mask[channel])));
+        r = _mm_add_epi32(r, _mm_and_si128(s, _mm_set1_epi32(gains.right_mask[channel])));
+    }
+
+    __m128 high = _mm_set1_ps(SAMPLE_LIMIT);
+    __m128 low = _mm_set1_ps(-SAMPLE_LIMIT);
+    left = _mm_mul_ps(_mm_cvtepi32_ps(l), _mm_set1_ps(gains.left_volume));
+    right = _mm_mul_ps(_mm_cvtepi32_ps(r), _mm_set1_ps(gains.right_volume));
+    left = _mm_max_ps(_mm_min_ps(left, high), low);
+    right = _mm_max_ps(_mm_min_ps(right, high), low);
+}
+
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, int16_t *out) {
+    MixGains gains = get_gains(nr50, nr51);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 left, right;
+        mix_vector(samples, stride, i, gains, left, right);
+
+        __m128i l = _mm_cvttps_epi32(left);
+        __m128i r = _mm_cvttps_epi32(right);
+        __m128i frames = _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), frames);
+    }
+    mix_scalar(samples, stride, i, count, gains, out);
+}
+
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, float *out) {
+    MixGains gains = get_gains(nr50, nr51);
+    __m128 scale = _mm_set1_ps(FLOAT_SCALE);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 left, right;
+        mix_vector(samples, stride, i, gains, left, right);
+
+        left = _mm_mul_ps(left, scale);
+        right = _mm_mul_ps(right, scale);
+        _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(left, right));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(left, right));
+    }
+    mix_scalar(samples, stride, i, count, gains, out);
+}
+
+#else
+
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, int16_t *out) {
+    mix_scalar(samples, stride, 0, count, get_gains(nr50, nr51), out);
+}
+
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, float *out) {
+    mix_scalar(samples, stride, 0, count, get_gains(nr50, nr51), out);
+}
+
+#endif
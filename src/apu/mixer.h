@@ -0,0 +1,32 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_MIXER_H
+#define GAME_BOY_EMULATOR_MIXER_H
+
+#include <cstdint>
+
+/*
+ * Mix the samples of the 4 sound channels into stereo frames.
+ *
+ * Each channel goes to the left and right speakers if its bits in NR51 are
+ * set, and each speaker is then scaled by its master volume in NR50. The
+ * frames are mixed 4 or 8 at a time with SSE2 or AVX2.
+ *
+ * @param samples: The samples of each channel, one channel after the other.
+ * @param stride: The distance between the first samples of two channels.
+ * @param count: The number of frames to mix.
+ * @param nr50: The master volumes.
+ * @param nr51: The channels sent to each speaker.
+ * @param out: Where to write the frames, with the left and right samples of
+ * each frame next to each other. Samples that are too loud are clipped.
+ */
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, int16_t *out);
+
+/*
+ * The same as above, but with samples from -1 to 1.
+ */
+void mix_frames(const int32_t *samples, int stride, int count, uint8_t nr50, uint8_t nr51, float *out);
+
+#endif
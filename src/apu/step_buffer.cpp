@@ -0,0 +1,122 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <cmath>
+#include <string.h>
+
+#include "step_buffer.h"
+
+// How quickly the samples return to 0, as a shift. 9 removes anything below
+// about 15 Hz at 48 kHz.
+#define BASS_SHIFT 9
+
+// The highest frequency kept, as a fraction of half the sample rate. Leaving
+// a gap below half the sample rate lets the kernel be short.
+#define STEP_CUTOFF 0.9
+
+/*
+ * The kernels for every phase, worked out once and shared by every buffer.
+ */
+struct StepKernels {
+    int16_t taps[STEP_PHASES][STEP_KERNEL_WIDTH];
+
+    StepKernels() {
+        int half = STEP_KERNEL_WIDTH / 2;
+
+        for (int phase = 0; phase < STEP_PHASES; phase++) {
+            double fraction = static_cast<double>(phase) / STEP_PHASES;
+            double kernel[STEP_KERNEL_WIDTH];
+            double total = 0;
+
+            // A Blackman windowed sinc, centred between the two middle taps
+            // at the position of the step.
+            for (int i = 0; i < STEP_KERNEL_WIDTH; i++) {
+                double x = i - (half - 1) - fraction;
+                double sinc = x == 0 ? 1 : sin(M_PI * STEP_CUTOFF * x) / (M_PI * STEP_CUTOFF * x);
+                double window = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half);
+
+                kernel[i] = sinc * window;
+                total += kernel[i];
+            }
+
+            // Each kernel has to add up to exactly the same amount, or the
+            // steps wouldn't cancel out when the level goes back to where it
+            // was. Any rounding error goes on the largest tap.
+            int sum = 0;
+            int largest = half - 1;
+            for (int i = 0; i < STEP_KERNEL_WIDTH; i++) {
+                taps[phase][i] = static_cast<int16_t>(lround(kernel[i] / total * (1 << STEP_KERNEL_BITS)));
+                sum += taps[phase][i];
+                if (taps[phase][i] > taps[phase][largest]) {
+                    largest = i;
+                }
+            }
+            taps[phase][largest] += (1 << STEP_KERNEL_BITS) - sum;
+        }
+    }
+};
+
+static const StepKernels & get_kernels() {
+    static const StepKernels kernels;
+    return kernels;
+}
+
+StepBuffer::StepBuffer(int size) : deltas(size + STEP_KERNEL_WIDTH, 0) {
+    kernels = get_kernels().taps;
+    factor = 0;
+    offset = 0;
+    sum = 0;
+}
+
+void StepBuffer::add_delta(uint32_t time, int delta) {
+    uint64_t position = offset + time * factor;
+    const int16_t *kernel = kernels[(position >> (32 - STEP_PHASE_BITS)) & (STEP_PHASES - 1)];
+    int32_t *out = &deltas[position >> 32];
+
+    for (int i = 0; i < STEP_KERNEL_WIDTH; i++) {
+        out[i] += kernel[i] * delta;
+    }
+}
+
+void StepBuffer::set_rates(double clock_rate, double sample_rate) {
+    factor = static_cast<uint64_t>(sample_rate / clock_rate * 4294967296.0 + 0.5);
+}
+
+void StepBuffer::end_frame(uint32_t time) {
+    offset += time * factor;
+}
+
+int StepBuffer::samples_avail() {
+    return static_cast<int>(offset >> 32);
+}
+
+uint32_t StepBuffer::clocks_needed(int samples) {
+    uint64_t needed = static_cast<uint64_t>(samples) << 32;
+    if (needed <= offset) {
+        return 0;
+    }
+    return static_cast<uint32_t>((needed - offset + factor - 1) / factor);
+}
+
+void StepBuffer::read_samples(int32_t *out, int count) {
+    int32_t s = sum;
+    for (int i = 0; i < count; i++) {
+        s += deltas[i];
+        out[i] = s >> STEP_KERNEL_BITS;
+        s -= s >> BASS_SHIFT;
+    }
+    sum = s;
+
+    // Move the steps that haven't been read yet to the start.
+    int remaining = samples_avail() + STEP_KERNEL_WIDTH - count;
+    memmove(deltas.data(), deltas.data() + count, remaining * sizeof(int32_t));
+    memset(deltas.data() + remaining, 0, count * sizeof(int32_t));
+    offset -= static_cast<uint64_t>(count) << 32;
+}
+
+void StepBuffer::clear() {
+    memset(deltas.data(), 0, deltas.size() * sizeof(int32_t));
+    offset &= 0xFFFFFFFF;
+    sum = 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_STEP_BUFFER_H
+#define GAME_BOY_EMULATOR_STEP_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+// The number of samples each step is spread over.
+#define STEP_KERNEL_WIDTH 16
+
+// The number of positions between two samples that a step can be placed at,
+// as a power of 2.
+#define STEP_PHASE_BITS 6
+#define STEP_PHASES (1 << STEP_PHASE_BITS)
+
+// The kernels add up to 1 << STEP_KERNEL_BITS.
+#define STEP_KERNEL_BITS 15
+
+using namespace std;
+
+/*
+ * Turns the changes in the output level of a channel into samples.
+ *
+ * Rather than working out the level of the channel at every sample, the
+ * channel only reports when its level steps up or down, at the clock cycle it
+ * happens. The steps are added up into samples when they are read. Frames of
+ * clock cycles are added with end_frame, and the samples for them can be read
+ * once the frame is over.
+ *
+ * A step isn't placed in a single sample, which would alias any frequency
+ * above half the sample rate back into the audible range. Instead it is
+ * spread over STEP_KERNEL_WIDTH samples by a windowed sinc kernel, picked for
+ * where the step falls between two samples, so that the output is band
+ * limited. This delays the output by half the width of the kernel.
+ *
+ * Times are kept as 32.32 fixed point sample positions, so the fraction of a
+ * sample left over at the end of one frame carries over to the next.
+ *
+ * Example usage:
+ *
+ *  buffer.add_delta(100, 15);
+ *  buffer.end_frame(8192);
+ *  buffer.read_samples(samples, buffer.samples_avail());
+ */
+class StepBuffer {
+
+private:
+
+    uint64_t factor; // Samples per clock cycle.
+    uint64_t offset; // The position of the start of the frame.
+
+    const int16_t (*kernels)[STEP_KERNEL_WIDTH];
+
+    vector<int32_t> deltas;
+    int32_t sum;
+
+public:
+
+    /*
+     * @param size: The most samples that can be waiting to be read.
+     */
+    StepBuffer(int size);
+
+    /*
+     * @param clock_rate: The number of clock cycles per second.
+     * @param sample_rate: The number of samples per second.
+     */
+    void set_rates(double clock_rate, double sample_rate);
+
+    /*
+     * Step the output level.
+     *
+     * @param time: The clock cycle of the step, from the start of the frame.
+     * @param delta: How much the level changes by.
+     */
+    void add_delta(uint32_t time, int delta);
+
+    /*
+     * End the current frame, and start the next one.
+     *
+     * @param time: The length of the frame, in clock cycles.
+     */
+    void end_frame(uint32_t time);
+
+    /*
+     * @return: The number of samples that can be read.
+     */
+    int samples_avail();
+
+    /*
+     * @param samples: A number of samples.
+     * @return: The number of clock cycles from the start of the frame until
+     * that many samples can be read.
+     */
+    uint32_t clocks_needed(int samples);
+
+    /*
+     * Read samples, removing them from the buffer. The samples slowly return to
+     * 0 when the level doesn't change, which takes out any DC offset.
+     *
+     * @param out: Where to write the samples.
+     * @param count: The number of samples, at most samples_avail().
+     */
+    void read_samples(int32_t *out, int count);
+
+    /*
+     * Remove all the samples and steps.
+     */
+    void clear();
+};
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "frame_capture.h"
+
+FrameCapture::FrameCapture(const char *path, CaptureFormat format, int interval) :
+        FrameCapture(path, format, interval, NO_SCALING) {
+
+}
+
+FrameCapture::FrameCapture(const char *path, CaptureFormat format, int interval, ScaleFilter filter) {
+    this->format = format;
+    this->interval = interval > 0 ? interval : 1;
+
+    // Recordings store the 4 shades of the screen, which scaling would add to.
+    if (format == RECORDING_CAPTURE) {
+        filter = NO_SCALING;
+    }
+    width = SCREEN_WIDTH * scale_factor(filter);
+    height = SCREEN_HEIGHT * scale_factor(filter);
+
+    frames_seen = 0;
+    frames_written = 0;
+    frames_dropped = 0;
+    stopping = false;
+
+    // The first frame is written in full.
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        pending_lines[y] = true;
+    }
+
+    is_pipe = path[0] == '|';
+    if (is_pipe) {
+        file = popen(path + 1, "w");
+    }
+    else {
+        file = fopen(path, "wb");
+    }
+
+    recording = nullptr;
+    scaler = nullptr;
+    if (file == nullptr) {
+        slots = nullptr;
+        return;
+    }
+
+    if (filter != NO_SCALING) {
+        scaler = new Scaler(filter);
+        unscaled.resize(NUM_PIXELS);
+        scaled.resize(width * height);
+    }
+
+    switch (format) {
+        case Y4M_CAPTURE:
+            frame.resize(width * height * 3);
+            break;
+
+        case RAW_RGBA_CAPTURE:
+            frame.resize(width * height * 4);
+            break;
+
+        case RECORDING_CAPTURE:
+            frame.resize(RECORDING_FRAME_SIZE);
+            break;
+    }
+
+    slots = new Slot[CAPTURE_POOL_SIZE];
+    for (int i = 0; i < CAPTURE_POOL_SIZE; i++) {
+        free_slots.push_back(slots + i);
+    }
+
+    write_header();
+    writer = std::thread(&FrameCapture::write_frames, this);
+}
+
+FrameCapture::~FrameCapture() {
+    close();
+    delete[] slots;
+    delete recording;
+    delete scaler;
+}
+
+bool FrameCapture::is_open() {
+    return file != nullptr;
+}
+
+void FrameCapture::write_header() {
+    if (format == Y4M_CAPTURE) {
+        write_y4m_header(file, width, height, FRAME_CYCLES * interval);
+    }
+    else if (format == RECORDING_CAPTURE) {
+        recording = new RecordingWriter(file, FRAME_CYCLES * interval,
+                                        RECORDING_KEYFRAME_INTERVAL);
+    }
+}
+
+void FrameCapture::write_y4m_header(FILE *file, int width, int height, uint32_t frame_duration) {
+    // The Game Boy's CPU runs at 4194304 cycles per second.
+    fprintf(file, "YUV4MPEG2 W%d H%d F4194304:%u Ip A1:1 C444\n", width, height, frame_duration);
+}
+
+void FrameCapture::convert_y4m_line(const Pixel *line, int y, int width, int height, uint8_t *frame) {
+    // BT.601 studio swing, with each plane stored one after the other.
+    uint8_t *y_plane = frame + y * width;
+    uint8_t *u_plane = y_plane + width * height;
+    uint8_t *v_plane = u_plane + width * height;
+
+    for (int x = 0; x < width; x++) {
+        int r = line[x].r;
+        int g = line[x].g;
+        int b = line[x].b;
+
+        y_plane[x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u_plane[x] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v_plane[x] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+}
+
+void FrameCapture::capture_frame(GPU & gpu) {
+    if (file == nullptr) {
+        return;
+    }
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        pending_lines[y] = pending_lines[y] or gpu.is_line_dirty(y);
+    }
+
+    if (frames_seen++ % interval != 0) {
+        return;
+    }
+
+    Slot *slot = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+    }
+
+    if (slot == nullptr) {
+        // The lines stay pending, so the next captured frame is still correct.
+        frames_dropped += 1;
+        return;
+    }
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        slot->dirty_lines[y] = pending_lines[y];
+        if (pending_lines[y]) {
+            memcpy(slot->pixels + y * SCREEN_WIDTH, gpu.get_line(y), SCREEN_WIDTH * sizeof(Pixel));
+            pending_lines[y] = false;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready_slots.push_back(slot);
+    }
+    ready.notify_one();
+}
+
+void FrameCapture::convert_line(const Pixel *line, int y) {
+    if (format == Y4M_CAPTURE) {
+        convert_y4m_line(line, y, width, height, frame.data());
+    }
+    else if (format == RECORDING_CAPTURE) {
+        pack_recording_line(line, frame.data() + y * RECORDING_LINE_SIZE);
+    }
+    else {
+        uint8_t *rgba = frame.data() + y * width * 4;
+
+        for (int x = 0; x < width; x++) {
+            rgba[x * 4] = line[x].r;
+            rgba[x * 4 + 1] = line[x].g;
+            rgba[x * 4 + 2] = line[x].b;
+            rgba[x * 4 + 3] = 255;
+        }
+    }
+}
+
+void FrameCapture::convert_slot(Slot *slot) {
+    if (scaler == nullptr) {
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            if (slot->dirty_lines[y]) {
+                convert_line(slot->pixels + y * SCREEN_WIDTH, y);
+            }
+        }
+        return;
+    }
+
+    bool changed = false;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        if (slot->dirty_lines[y]) {
+            memcpy(unscaled.data() + y * SCREEN_WIDTH, slot->pixels + y * SCREEN_WIDTH,
+                   SCREEN_WIDTH * sizeof(Pixel));
+            changed = true;
+        }
+    }
+
+    // Every scaled line depends on the lines around it, so the whole frame is
+    // scaled again whenever any line changes.
+    if (changed) {
+        scaler->scale(unscaled.data(), scaled.data());
+        for (int y = 0; y < height; y++) {
+            convert_line(scaled.data() + y * width, y);
+        }
+    }
+}
+
+void FrameCapture::write_frames() {
+    while (true) {
+        Slot *slot;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping or !ready_slots.empty(); });
+
+            if (ready_slots.empty()) {
+                return; // Stopping, and every frame has been written.
+            }
+            slot = ready_slots.front();
+            ready_slots.pop_front();
+        }
+
+        convert_slot(slot);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            free_slots.push_back(slot);
+        }
+
+        if (format == RECORDING_CAPTURE) {
+            recording->write_frame(frame.data());
+        }
+        else {
+            if (format == Y4M_CAPTURE) {
+                fputs("FRAME\n", file);
+            }
+            fwrite(frame.data(), 1, frame.size(), file);
+        }
+        frames_written += 1;
+    }
+}
+
+void FrameCapture::close() {
+    if (file == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_one();
+    writer.join();
+
+    if (recording != nullptr) {
+        recording->finish();
+    }
+
+    if (is_pipe) {
+        pclose(file);
+    }
+    else {
+        fclose(file);
+    }
+    file = nullptr;
+}
+
+uint64_t FrameCapture::get_frames_written() {
+    return frames_written;
+}
+
+uint64_t FrameCapture::get_frames_dropped() {
+    return frames_dropped;
+}
+
+int FrameCapture::get_width() {
+    return width;
+}
+
+int FrameCapture::get_height() {
+    return height;
+}
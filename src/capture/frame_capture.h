@@ -0,0 +1,195 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_FRAME_CAPTURE_H
+#define GAME_BOY_EMULATOR_FRAME_CAPTURE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../gpu/gpu.h"
+#include "../gpu/scaler.h"
+#include "recording.h"
+
+#define CAPTURE_POOL_SIZE 8
+
+/*
+ * File formats that frames can be captured to.
+ */
+enum CaptureFormat {
+    Y4M_CAPTURE, // YUV4MPEG2 video with 4:4:4 chroma.
+    RAW_RGBA_CAPTURE, // Frames of raw RGBA pixels, top line first.
+    RECORDING_CAPTURE // Compact 2 bit per pixel recording, see recording.h.
+};
+
+/*
+ * Streams presented frames to a file or a pipe.
+ *
+ * Frames are copied into a small pool of buffers and written by a separate
+ * writer thread, so the emulator never waits for the disk. Only the lines that
+ * changed since the last captured frame are copied, and only those lines are
+ * converted by the writer thread. If every buffer is in use when a frame is
+ * captured, the frame is dropped.
+ *
+ * Frames can be scaled up before they are written. Scaling is done by the
+ * writer thread, so it costs the emulator nothing.
+ *
+ * Example usage:
+ *
+ *  FrameCapture capture("out.y4m", Y4M_CAPTURE, 1);
+ *  gpu.set_capture(&capture);
+ */
+class FrameCapture {
+
+private:
+
+    /*
+     * A frame waiting to be written.
+     */
+    struct Slot {
+        Pixel pixels[NUM_PIXELS]; // Top line first.
+        bool dirty_lines[SCREEN_HEIGHT];
+    };
+
+    FILE *file;
+    bool is_pipe;
+
+    CaptureFormat format;
+
+    // The size of the frames written to the file.
+    int width;
+    int height;
+
+    // Scales frames before they are converted, if set. The unscaled frame is
+    // kept up to date from the changed lines of each captured frame.
+    Scaler *scaler;
+    std::vector<Pixel> unscaled;
+    std::vector<Pixel> scaled;
+
+    // Capture 1 of every interval frames.
+    int interval;
+    uint64_t frames_seen;
+
+    // Lines that changed since the last captured frame.
+    bool pending_lines[SCREEN_HEIGHT];
+
+    Slot *slots;
+    std::vector<Slot *> free_slots;
+    std::deque<Slot *> ready_slots;
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::thread writer;
+    bool stopping;
+
+    std::atomic<uint64_t> frames_written;
+    uint64_t frames_dropped;
+
+    // The converted frame, which is kept up to date by the writer thread.
+    std::vector<uint8_t> frame;
+
+    // Encodes frames when capturing to a recording.
+    RecordingWriter *recording;
+
+    void write_header();
+    void convert_line(const Pixel *line, int y);
+    void convert_slot(Slot *slot);
+    void write_frames();
+
+public:
+
+    /*
+     * Open a file and start the writer thread.
+     *
+     * @param path: The file to write to. If the path starts with '|', the
+     * rest of the path is run as a command and frames are piped to it.
+     * @param format: The format to write frames in.
+     * @param interval: Capture 1 of every interval frames.
+     */
+    FrameCapture(const char *path, CaptureFormat format, int interval);
+
+    /*
+     * Open a file and start the writer thread.
+     *
+     * @param path: The file to write to. If the path starts with '|', the
+     * rest of the path is run as a command and frames are piped to it.
+     * @param format: The format to write frames in.
+     * @param interval: Capture 1 of every interval frames.
+     * @param filter: The filter used to scale frames before they are written.
+     * Recordings are always written unscaled.
+     */
+    FrameCapture(const char *path, CaptureFormat format, int interval, ScaleFilter filter);
+
+    /*
+     * Write any frames that are still waiting and close the file.
+     */
+    ~FrameCapture();
+
+    /*
+     * @return: True if the file was opened successfully.
+     */
+    bool is_open();
+
+    /*
+     * Queue the frame that the GPU has just presented. Never blocks.
+     *
+     * @param gpu: The GPU that presented the frame.
+     */
+    void capture_frame(GPU & gpu);
+
+    /*
+     * Wait until every queued frame has been written and close the file.
+     */
+    void close();
+
+    /*
+     * @return: The number of frames written to the file.
+     */
+    uint64_t get_frames_written();
+
+    /*
+     * @return: The number of frames dropped because the writer fell behind.
+     */
+    uint64_t get_frames_dropped();
+
+    /*
+     * @return: The width of the frames written to the file.
+     */
+    int get_width();
+
+    /*
+     * @return: The height of the frames written to the file.
+     */
+    int get_height();
+
+    /*
+     * Write the YUV4MPEG2 stream header.
+     *
+     * @param file: The file to write to.
+     * @param width: The width of a frame.
+     * @param height: The height of a frame.
+     * @param frame_duration: The number of CPU cycles that each frame lasts.
+     */
+    static void write_y4m_header(FILE *file, int width, int height, uint32_t frame_duration);
+
+    /*
+     * Convert a line of pixels to Y, U and V samples.
+     *
+     * @param line: The width pixels that make up the line.
+     * @param y: The line, where 0 is the top of the frame.
+     * @param width: The width of the frame.
+     * @param height: The height of the frame.
+     * @param frame: The Y4M frame to write the samples to, which holds
+     * width * height * 3 bytes.
+     */
+    static void convert_y4m_line(const Pixel *line, int y, int width, int height, uint8_t *frame);
+};
+
+#endif
@@ -0,0 +1,561 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "recording.h"
+#include "frame_capture.h"
+
+#define RLE_MAX_LITERAL 128
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN 130
+#define RLE_RUN_BIAS 125
+
+#define RECORD_HEADER_SIZE 3
+
+#define PNG_ROW_SIZE (RECORDING_LINE_SIZE + 1) // Each row starts with a filter byte.
+#define PNG_IMAGE_SIZE (PNG_ROW_SIZE * SCREEN_HEIGHT)
+
+static const char recording_magic[8] = {'G', 'B', 'R', 'E', 'C', 0, 0, 0};
+static const char index_magic[8] = {'G', 'B', 'R', 'I', 'N', 'D', 'E', 'X'};
+
+static const Pixel shades[4] = {WHITE, LIGHT_GREY, DARK_GREY, BLACK};
+
+static void put_le(uint8_t *out, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        out[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+static uint64_t get_le(const uint8_t *data, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+    return value;
+}
+
+static void put_be32(uint8_t *out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+/*
+ * @return: The shade (0 is white, 3 is black) closest to a pixel.
+ */
+static uint8_t pixel_shade(const Pixel & pixel) {
+    if (pixel.r >= 224) {
+        return 0;
+    }
+    if (pixel.r >= 144) {
+        return 1;
+    }
+    if (pixel.r >= 48) {
+        return 2;
+    }
+    return 3;
+}
+
+/*
+ * Write literal bytes in blocks of at most RLE_MAX_LITERAL bytes.
+ *
+ * @return: The number of encoded bytes.
+ */
+static size_t rle_literals(const uint8_t *data, size_t length, uint8_t *out) {
+    size_t size = 0;
+    while (length > 0) {
+        size_t count = length < RLE_MAX_LITERAL ? length : RLE_MAX_LITERAL;
+        out[size++] = static_cast<uint8_t>(count - 1);
+        memcpy(out + size, data, count);
+        size += count;
+        data += count;
+        length -= count;
+    }
+    return size;
+}
+
+size_t rle_encode(const uint8_t *data, size_t length, uint8_t *out) {
+    size_t size = 0;
+    size_t literal_start = 0;
+    size_t i = 0;
+
+    while (i < length) {
+        size_t run = 1;
+        while (i + run < length and run < RLE_MAX_RUN and data[i + run] == data[i]) {
+            run++;
+        }
+
+        // Runs that are too short to encode are left as literals.
+        if (run < RLE_MIN_RUN) {
+            i += run;
+            continue;
+        }
+
+        size += rle_literals(data + literal_start, i - literal_start, out + size);
+        out[size++] = static_cast<uint8_t>(run + RLE_RUN_BIAS);
+        out[size++] = data[i];
+
+        i += run;
+        literal_start = i;
+    }
+
+    return size + rle_literals(data + literal_start, length - literal_start, out + size);
+}
+
+bool rle_decode(const uint8_t *data, size_t length, uint8_t *out, size_t out_length) {
+    size_t i = 0;
+    size_t size = 0;
+
+    while (i < length) {
+        uint8_t control = data[i++];
+
+        if (control < RLE_MAX_LITERAL) {
+            size_t count = control + 1;
+            if (i + count > length or size + count > out_length) {
+                return false;
+            }
+            memcpy(out + size, data + i, count);
+            i += count;
+            size += count;
+        }
+        else {
+            size_t count = control - RLE_RUN_BIAS;
+            if (i >= length or size + count > out_length) {
+                return false;
+            }
+            memset(out + size, data[i++], count);
+            size += count;
+        }
+    }
+    return size == out_length;
+}
+
+void pack_recording_line(const Pixel *line, uint8_t *out) {
+    for (int x = 0; x < SCREEN_WIDTH; x += 4) {
+        out[x / 4] = static_cast<uint8_t>((pixel_shade(line[x]) << 6) |
+                                          (pixel_shade(line[x + 1]) << 4) |
+                                          (pixel_shade(line[x + 2]) << 2) |
+                                          pixel_shade(line[x + 3]));
+    }
+}
+
+void unpack_recording_frame(const uint8_t *frame, Pixel *pixels) {
+    for (int i = 0; i < NUM_PIXELS; i++) {
+        pixels[i] = shades[(frame[i / 4] >> (6 - (i % 4) * 2)) & 0x03];
+    }
+}
+
+RecordingWriter::RecordingWriter(FILE *file, uint32_t frame_duration, uint32_t keyframe_interval) {
+    this->file = file;
+    this->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+
+    offset = 0;
+    num_frames = 0;
+
+    uint8_t header[RECORDING_HEADER_SIZE];
+    memcpy(header, recording_magic, sizeof(recording_magic));
+    put_le(header + 8, RECORDING_VERSION, 4);
+    put_le(header + 12, SCREEN_WIDTH, 2);
+    put_le(header + 14, SCREEN_HEIGHT, 2);
+    put_le(header + 16, frame_duration, 4);
+    put_le(header + 20, this->keyframe_interval, 4);
+    write(header, sizeof(header));
+}
+
+void RecordingWriter::write(const void *data, size_t length) {
+    fwrite(data, 1, length, file);
+    offset += length;
+}
+
+void RecordingWriter::write_record(RecordType type, size_t length) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    header[0] = static_cast<uint8_t>(type);
+    put_le(header + 1, length, 2);
+
+    write(header, sizeof(header));
+    write(payload, length);
+}
+
+void RecordingWriter::write_frame(const uint8_t *frame) {
+    if (num_frames % keyframe_interval == 0) {
+        keyframe_offsets.push_back(offset);
+        write_record(KEYFRAME_RECORD, rle_encode(frame, RECORDING_FRAME_SIZE, payload));
+    }
+    else {
+        uint8_t changed = 0;
+        for (int i = 0; i < RECORDING_FRAME_SIZE; i++) {
+            delta[i] = frame[i] ^ previous[i];
+            changed |= delta[i];
+        }
+
+        if (changed) {
+            write_record(DELTA_RECORD, rle_encode(delta, RECORDING_FRAME_SIZE, payload));
+        }
+        else {
+            write_record(REPEAT_RECORD, 0);
+        }
+    }
+
+    memcpy(previous, frame, RECORDING_FRAME_SIZE);
+    num_frames += 1;
+}
+
+void RecordingWriter::finish() {
+    write_record(END_RECORD, 0);
+
+    uint64_t index_offset = offset;
+    for (uint64_t keyframe_offset : keyframe_offsets) {
+        uint8_t entry[8];
+        put_le(entry, keyframe_offset, 8);
+        write(entry, sizeof(entry));
+    }
+
+    uint8_t footer[RECORDING_FOOTER_SIZE];
+    put_le(footer, num_frames, 8);
+    put_le(footer + 8, index_offset, 8);
+    memcpy(footer + 16, index_magic, sizeof(index_magic));
+    write(footer, sizeof(footer));
+
+    fflush(file);
+}
+
+uint64_t RecordingWriter::get_bytes_written() {
+    return offset;
+}
+
+RecordingReader::RecordingReader(const char *path) {
+    num_frames = 0;
+    next_frame = UINT64_MAX; // Forces the first seek to go to a keyframe.
+    memset(frame, 0, sizeof(frame));
+
+    file = fopen(path, "rb");
+    if (file == nullptr) {
+        return;
+    }
+
+    if (!read_header()) {
+        fclose(file);
+        file = nullptr;
+        return;
+    }
+
+    if (!read_index()) {
+        build_index();
+    }
+    seek(0);
+}
+
+RecordingReader::~RecordingReader() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+bool RecordingReader::read_header() {
+    uint8_t header[RECORDING_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        return false;
+    }
+
+    if (memcmp(header, recording_magic, sizeof(recording_magic)) != 0 or
+        get_le(header + 8, 4) != RECORDING_VERSION or
+        get_le(header + 12, 2) != SCREEN_WIDTH or
+        get_le(header + 14, 2) != SCREEN_HEIGHT) {
+        return false;
+    }
+
+    frame_duration = static_cast<uint32_t>(get_le(header + 16, 4));
+    keyframe_interval = static_cast<uint32_t>(get_le(header + 20, 4));
+    return keyframe_interval > 0;
+}
+
+bool RecordingReader::read_index() {
+    uint8_t footer[RECORDING_FOOTER_SIZE];
+    if (fseek(file, -RECORDING_FOOTER_SIZE, SEEK_END) != 0 or
+        fread(footer, 1, sizeof(footer), file) != sizeof(footer) or
+        memcmp(footer + 16, index_magic, sizeof(index_magic)) != 0) {
+        return false;
+    }
+
+    num_frames = get_le(footer, 8);
+    uint64_t num_keyframes = (num_frames + keyframe_interval - 1) / keyframe_interval;
+
+    if (fseek(file, static_cast<long>(get_le(footer + 8, 8)), SEEK_SET) != 0) {
+        return false;
+    }
+
+    keyframe_offsets.clear();
+    for (uint64_t i = 0; i < num_keyframes; i++) {
+        uint8_t entry[8];
+        if (fread(entry, 1, sizeof(entry), file) != sizeof(entry)) {
+            return false;
+        }
+        keyframe_offsets.push_back(get_le(entry, 8));
+    }
+    return true;
+}
+
+void RecordingReader::build_index() {
+    num_frames = 0;
+    keyframe_offsets.clear();
+    fseek(file, RECORDING_HEADER_SIZE, SEEK_SET);
+
+    // Walk the records, stopping at the end of the recording or at the first
+    // record that was cut short.
+    while (true) {
+        long offset = ftell(file);
+
+        uint8_t header[RECORD_HEADER_SIZE];
+        if (fread(header, 1, sizeof(header), file) != sizeof(header) or header[0] == END_RECORD) {
+            break;
+        }
+
+        size_t length = static_cast<size_t>(get_le(header + 1, 2));
+        if (length > RECORDING_MAX_PAYLOAD or fread(payload, 1, length, file) != length) {
+            break;
+        }
+
+        if (header[0] == KEYFRAME_RECORD) {
+            keyframe_offsets.push_back(static_cast<uint64_t>(offset));
+        }
+        else if (keyframe_offsets.empty()) {
+            break;
+        }
+        num_frames += 1;
+    }
+
+    // A frame can only be decoded if its keyframe was written.
+    uint64_t decodable = keyframe_offsets.size() * static_cast<uint64_t>(keyframe_interval);
+    if (num_frames > decodable) {
+        num_frames = decodable;
+    }
+}
+
+bool RecordingReader::is_open() {
+    return file != nullptr;
+}
+
+uint64_t RecordingReader::get_num_frames() {
+    return num_frames;
+}
+
+uint32_t RecordingReader::get_frame_duration() {
+    return frame_duration;
+}
+
+bool RecordingReader::seek(uint64_t n) {
+    if (file == nullptr or n >= num_frames) {
+        return false;
+    }
+
+    uint64_t keyframe = n / keyframe_interval;
+    uint64_t keyframe_start = keyframe * keyframe_interval;
+
+    // Decoding on from the current frame is cheaper when it is already
+    // between the keyframe and the target.
+    if (next_frame < keyframe_start or next_frame > n) {
+        if (fseek(file, static_cast<long>(keyframe_offsets[keyframe]), SEEK_SET) != 0) {
+            return false;
+        }
+        next_frame = keyframe_start;
+    }
+
+    while (next_frame < n) {
+        if (!read_frame()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RecordingReader::read_frame() {
+    if (file == nullptr or next_frame >= num_frames) {
+        return false;
+    }
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        return false;
+    }
+
+    size_t length = static_cast<size_t>(get_le(header + 1, 2));
+    if (length > RECORDING_MAX_PAYLOAD or fread(payload, 1, length, file) != length) {
+        return false;
+    }
+
+    switch (header[0]) {
+        case KEYFRAME_RECORD:
+            if (!rle_decode(payload, length, frame, RECORDING_FRAME_SIZE)) {
+                return false;
+            }
+            break;
+
+        case DELTA_RECORD:
+            if (!rle_decode(payload, length, delta, RECORDING_FRAME_SIZE)) {
+                return false;
+            }
+            for (int i = 0; i < RECORDING_FRAME_SIZE; i++) {
+                frame[i] ^= delta[i];
+            }
+            break;
+
+        case REPEAT_RECORD:
+            break;
+
+        default:
+            return false;
+    }
+
+    next_frame += 1;
+    return true;
+}
+
+const uint8_t* RecordingReader::get_frame() {
+    return frame;
+}
+
+/*
+ * @return: The CRC-32 used by PNG chunks.
+ */
+static uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void write_png_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t length) {
+    uint8_t header[8];
+    put_be32(header, length);
+    memcpy(header + 4, type, 4);
+
+    uint8_t crc[4];
+    put_be32(crc, crc32(data, length, crc32(header + 4, 4, 0)));
+
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(data, 1, length, file);
+    fwrite(crc, 1, sizeof(crc), file);
+}
+
+bool write_recording_png(const char *path, const uint8_t *frame) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, sizeof(signature), file);
+
+    // A 2 bit image with a palette of the 4 shades.
+    uint8_t header[13];
+    put_be32(header, SCREEN_WIDTH);
+    put_be32(header + 4, SCREEN_HEIGHT);
+    header[8] = 2; // Bit depth.
+    header[9] = 3; // Color type (indexed).
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+    write_png_chunk(file, "IHDR", header, sizeof(header));
+
+    uint8_t palette[12];
+    for (int i = 0; i < 4; i++) {
+        palette[i * 3] = shades[i].r;
+        palette[i * 3 + 1] = shades[i].g;
+        palette[i * 3 + 2] = shades[i].b;
+    }
+    write_png_chunk(file, "PLTE", palette, sizeof(palette));
+
+    // The rows are already packed the way PNG expects, so the image is stored
+    // in a single uncompressed deflate block.
+    uint8_t data[2 + 5 + PNG_IMAGE_SIZE + 4];
+    data[0] = 0x78; // zlib header.
+    data[1] = 0x01;
+    data[2] = 0x01; // Final, uncompressed block.
+    put_le(data + 3, PNG_IMAGE_SIZE, 2);
+    put_le(data + 5, static_cast<uint16_t>(~PNG_IMAGE_SIZE), 2);
+
+    uint8_t *image = data + 7;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        image[y * PNG_ROW_SIZE] = 0; // No filter.
+        memcpy(image + y * PNG_ROW_SIZE + 1, frame + y * RECORDING_LINE_SIZE, RECORDING_LINE_SIZE);
+    }
+
+    // Adler-32 of the image.
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (int i = 0; i < PNG_IMAGE_SIZE; i++) {
+        a = (a + image[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_be32(image + PNG_IMAGE_SIZE, (b << 16) | a);
+
+    write_png_chunk(file, "IDAT", data, sizeof(data));
+    write_png_chunk(file, "IEND", nullptr, 0);
+
+    return fclose(file) == 0;
+}
+
+static bool convert_recording_to_y4m(RecordingReader & recording, const char *output_path) {
+    FILE *file = fopen(output_path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    FrameCapture::write_y4m_header(file, SCREEN_WIDTH, SCREEN_HEIGHT, recording.get_frame_duration());
+
+    std::vector<Pixel> pixels(NUM_PIXELS);
+    std::vector<uint8_t> frame(NUM_PIXELS * 3);
+
+    bool ok = true;
+    for (uint64_t n = 0; n < recording.get_num_frames(); n++) {
+        if (!recording.read_frame()) {
+            ok = false;
+            break;
+        }
+
+        unpack_recording_frame(recording.get_frame(), pixels.data());
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            FrameCapture::convert_y4m_line(pixels.data() + y * SCREEN_WIDTH, y, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                           frame.data());
+        }
+
+        fputs("FRAME\n", file);
+        fwrite(frame.data(), 1, frame.size(), file);
+    }
+
+    return fclose(file) == 0 and ok;
+}
+
+bool convert_recording(const char *recording_path, const char *output_path, uint64_t frame) {
+    RecordingReader recording(recording_path);
+    if (!recording.is_open()) {
+        return false;
+    }
+
+    size_t length = strlen(output_path);
+    if (length >= 4 and !strcmp(output_path + length - 4, ".y4m")) {
+        return convert_recording_to_y4m(recording, output_path);
+    }
+
+    // A single image.
+    if (strchr(output_path, '%') == nullptr) {
+        return recording.seek(frame) and recording.read_frame() and
+               write_recording_png(output_path, recording.get_frame());
+    }
+
+    std::vector<char> path(length + 32);
+    for (uint64_t n = 0; n < recording.get_num_frames(); n++) {
+        snprintf(path.data(), path.size(), output_path, static_cast<int>(n));
+        if (!recording.read_frame() or !write_recording_png(path.data(), recording.get_frame())) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,276 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * A compact recording format for the Game Boy screen.
+ *
+ * The Game Boy can only show 4 shades, so each pixel is stored in 2 bits and
+ * a frame takes up RECORDING_FRAME_SIZE bytes. Pixels are packed 4 to a byte,
+ * with the leftmost pixel in the highest 2 bits, and lines are stored top
+ * first. Shade 0 is white and shade 3 is black.
+ *
+ * A recording starts with a header:
+ *
+ *  8 bytes  "GBREC\0\0\0"
+ *  4 bytes  Version (RECORDING_VERSION)
+ *  2 bytes  Width
+ *  2 bytes  Height
+ *  4 bytes  The number of CPU cycles that each frame lasts.
+ *  4 bytes  The number of frames between keyframes.
+ *
+ * and is followed by one record per frame:
+ *
+ *  1 byte   Record type (RecordType)
+ *  2 bytes  Payload size
+ *  N bytes  Payload
+ *
+ * A keyframe stores the run length encoded frame. A delta frame stores the run
+ * length encoded XOR of the frame and the frame before it, so lines that did
+ * not change become long runs of zeros. A repeated frame has no payload.
+ *
+ * When the recording is finished, an END_RECORD is written followed by an
+ * index of every keyframe, so that a reader can seek to any frame by decoding
+ * at most one keyframe interval. A recording that was cut short has no index,
+ * in which case the reader builds the index by walking the records.
+ *
+ * All numbers are little endian.
+ */
+
+#ifndef GAME_BOY_EMULATOR_RECORDING_H
+#define GAME_BOY_EMULATOR_RECORDING_H
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "../gpu/gpu.h"
+
+#define RECORDING_VERSION 1
+#define RECORDING_HEADER_SIZE 24
+#define RECORDING_FOOTER_SIZE 24
+
+#define RECORDING_LINE_SIZE (SCREEN_WIDTH / 4)
+#define RECORDING_FRAME_SIZE (RECORDING_LINE_SIZE * SCREEN_HEIGHT)
+
+// The largest payload that run length encoding a frame can produce.
+#define RECORDING_MAX_PAYLOAD (RECORDING_FRAME_SIZE + RECORDING_FRAME_SIZE / 128 + 1)
+
+#define RECORDING_KEYFRAME_INTERVAL 600 // 10 seconds.
+
+/*
+ * The types of record in a recording.
+ */
+enum RecordType {
+    KEYFRAME_RECORD = 0,
+    DELTA_RECORD = 1,
+    REPEAT_RECORD = 2,
+    END_RECORD = 0xFF
+};
+
+/*
+ * Run length encode a block of memory. A control byte c below 128 is followed
+ * by c + 1 literal bytes. A control byte c of 128 or more is followed by a
+ * single byte that is repeated c - 125 times.
+ *
+ * @param data: The bytes to encode.
+ * @param length: The number of bytes to encode.
+ * @param out: The encoded bytes. Must have room for
+ * length + length / 128 + 1 bytes.
+ * @return: The number of encoded bytes.
+ */
+size_t rle_encode(const uint8_t *data, size_t length, uint8_t *out);
+
+/*
+ * Decode a block of memory encoded by rle_encode.
+ *
+ * @param data: The encoded bytes.
+ * @param length: The number of encoded bytes.
+ * @param out: The decoded bytes.
+ * @param out_length: The number of decoded bytes expected.
+ * @return: False if the encoded bytes are corrupt or do not decode to exactly
+ * out_length bytes.
+ */
+bool rle_decode(const uint8_t *data, size_t length, uint8_t *out, size_t out_length);
+
+/*
+ * Pack a line of pixels into 2 bits per pixel.
+ *
+ * @param line: The SCREEN_WIDTH pixels that make up the line.
+ * @param out: The RECORDING_LINE_SIZE bytes to pack the line into.
+ */
+void pack_recording_line(const Pixel *line, uint8_t *out);
+
+/*
+ * Unpack a frame stored at 2 bits per pixel.
+ *
+ * @param frame: The RECORDING_FRAME_SIZE bytes that make up the frame.
+ * @param pixels: The NUM_PIXELS pixels to unpack into, top line first.
+ */
+void unpack_recording_frame(const uint8_t *frame, Pixel *pixels);
+
+/*
+ * Encodes frames and writes them to a recording.
+ *
+ * Example usage:
+ *
+ *  RecordingWriter recording(file, FRAME_CYCLES, RECORDING_KEYFRAME_INTERVAL);
+ *  recording.write_frame(frame);
+ *  recording.finish();
+ */
+class RecordingWriter {
+
+private:
+
+    FILE *file;
+
+    uint32_t keyframe_interval;
+
+    // The number of bytes written so far, which is used instead of ftell so
+    // that recordings can be written to a pipe.
+    uint64_t offset;
+
+    uint64_t num_frames;
+    std::vector<uint64_t> keyframe_offsets;
+
+    uint8_t previous[RECORDING_FRAME_SIZE];
+    uint8_t delta[RECORDING_FRAME_SIZE];
+    uint8_t payload[RECORDING_MAX_PAYLOAD];
+
+    void write(const void *data, size_t length);
+    void write_record(RecordType type, size_t length);
+
+public:
+
+    /*
+     * Write the recording header.
+     *
+     * @param file: The file to write to.
+     * @param frame_duration: The number of CPU cycles that each frame lasts.
+     * @param keyframe_interval: The number of frames between keyframes.
+     */
+    RecordingWriter(FILE *file, uint32_t frame_duration, uint32_t keyframe_interval);
+
+    /*
+     * Encode and write a frame.
+     *
+     * @param frame: The RECORDING_FRAME_SIZE bytes that make up the frame.
+     */
+    void write_frame(const uint8_t *frame);
+
+    /*
+     * Write the keyframe index. No frames may be written afterwards.
+     */
+    void finish();
+
+    /*
+     * @return: The number of bytes written to the file.
+     */
+    uint64_t get_bytes_written();
+};
+
+/*
+ * Reads frames from a recording.
+ *
+ * Example usage:
+ *
+ *  RecordingReader recording("out.gbrec");
+ *  recording.seek(100);
+ *  recording.read_frame(); // Frame 100 is now in get_frame().
+ */
+class RecordingReader {
+
+private:
+
+    FILE *file;
+
+    uint32_t frame_duration;
+    uint32_t keyframe_interval;
+
+    uint64_t num_frames;
+    std::vector<uint64_t> keyframe_offsets;
+
+    // The frame that will be returned by the next call to read_frame.
+    uint64_t next_frame;
+
+    uint8_t frame[RECORDING_FRAME_SIZE];
+    uint8_t delta[RECORDING_FRAME_SIZE];
+    uint8_t payload[RECORDING_MAX_PAYLOAD];
+
+    bool read_header();
+    bool read_index();
+    void build_index();
+
+public:
+
+    /*
+     * Open a recording and load its keyframe index.
+     *
+     * @param path: The recording to read.
+     */
+    RecordingReader(const char *path);
+
+    ~RecordingReader();
+
+    /*
+     * @return: True if the recording was opened and its header is valid.
+     */
+    bool is_open();
+
+    /*
+     * @return: The number of frames in the recording.
+     */
+    uint64_t get_num_frames();
+
+    /*
+     * @return: The number of CPU cycles that each frame lasts.
+     */
+    uint32_t get_frame_duration();
+
+    /*
+     * Move to a frame, so that it is the frame returned by the next call to
+     * read_frame. Starts decoding from the closest keyframe before it.
+     *
+     * @param n: The frame to move to.
+     * @return: False if the frame is not in the recording.
+     */
+    bool seek(uint64_t n);
+
+    /*
+     * Decode the next frame.
+     *
+     * @return: False if there are no more frames, or the recording is corrupt.
+     */
+    bool read_frame();
+
+    /*
+     * @return: The RECORDING_FRAME_SIZE bytes of the last frame read.
+     */
+    const uint8_t* get_frame();
+};
+
+/*
+ * Convert a recording to a Y4M video or PNG images.
+ *
+ * If the output path ends in ".y4m" every frame is written to a single video.
+ * Otherwise every frame is written to a PNG image, and the output path must
+ * contain a printf style integer (such as "frame_%05d.png") which is replaced
+ * by the frame number. If the output path has no integer, only the given
+ * frame is written.
+ *
+ * @param recording_path: The recording to convert.
+ * @param output_path: Where to write the video or images.
+ * @param frame: The frame to write when writing a single image.
+ * @return: False if the recording could not be read or the output could not
+ * be written.
+ */
+bool convert_recording(const char *recording_path, const char *output_path, uint64_t frame);
+
+/*
+ * Write a frame to a PNG image.
+ *
+ * @param path: The image to write.
+ * @param frame: The RECORDING_FRAME_SIZE bytes that make up the frame.
+ * @return: False if the image could not be written.
+ */
+bool write_recording_png(const char *path, const uint8_t *frame);
+
+#endif
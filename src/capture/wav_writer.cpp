@@ -0,0 +1,219 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "wav_writer.h"
+#include "../util/hash.h"
+
+// The stems are quieter than the mix, so they are turned up to the level of
+// a channel at full master volume.
+#define STEM_GAIN 8
+
+static const char *stem_names[NUM_SOUND_CHANNELS] = {"_square1", "_square2", "_wave", "_noise"};
+
+static void put_le(uint8_t *out, uint32_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        out[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+/*
+ * Write a WAV header for 16 bit samples at the audio sample rate.
+ *
+ * @param data_size: The number of bytes of samples that follow the header.
+ */
+static void write_wav_header(FILE *file, int num_channels, uint32_t data_size) {
+    uint8_t header[WAV_HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    put_le(header + 4, WAV_HEADER_SIZE - 8 + data_size, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, 16, 4); // The size of the format chunk.
+    put_le(header + 20, 1, 2); // PCM.
+    put_le(header + 22, num_channels, 2);
+    put_le(header + 24, AUDIO_SAMPLE_RATE, 4);
+    put_le(header + 28, AUDIO_SAMPLE_RATE * num_channels * 2, 4);
+    put_le(header + 32, num_channels * 2, 2);
+    put_le(header + 34, 16, 2);
+    memcpy(header + 36, "data", 4);
+    put_le(header + 40, data_size, 4);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+WavWriter::WavWriter(const char *path, bool stems) {
+    this->stems = stems;
+    file = nullptr;
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        stem_files[channel] = nullptr;
+    }
+
+    slots = nullptr;
+    current = nullptr;
+    stem_count = 0;
+    stopping = false;
+    frames_written = 0;
+    audio_hash = 0;
+
+    if (path == nullptr) {
+        return;
+    }
+
+    file = fopen(path, "wb");
+    if (file == nullptr) {
+        return;
+    }
+    write_wav_header(file, 2, 0);
+
+    if (stems) {
+        string base = path;
+        if (base.size() > 4 and base.compare(base.size() - 4, 4, ".wav") == 0) {
+            base.resize(base.size() - 4);
+        }
+
+        for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+            stem_files[channel] = fopen((base + stem_names[channel] + ".wav").c_str(), "wb");
+            if (stem_files[channel] == nullptr) {
+                close();
+                return;
+            }
+            write_wav_header(stem_files[channel], 1, 0);
+        }
+    }
+
+    slots = new Slot[WAV_POOL_SIZE];
+    for (int i = 0; i < WAV_POOL_SIZE; i++) {
+        free_slots.push_back(slots + i);
+    }
+
+    writer = std::thread(&WavWriter::write_slots, this);
+}
+
+WavWriter::~WavWriter() {
+    close();
+    delete[] slots;
+}
+
+bool WavWriter::is_open() {
+    return file != nullptr;
+}
+
+WavWriter::Slot* WavWriter::take_free_slot() {
+    std::unique_lock<std::mutex> guard(lock);
+    freed.wait(guard, [this] { return !free_slots.empty(); });
+
+    Slot *slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+}
+
+void WavWriter::write_frames(const int16_t *frames, int count) {
+    uint64_t parts[2] = {audio_hash, hash64(frames, count * 2 * sizeof(int16_t))};
+    audio_hash = hash64(parts, sizeof(parts));
+
+    if (file == nullptr) {
+        return;
+    }
+
+    if (current == nullptr) {
+        current = take_free_slot();
+    }
+    memcpy(current->frames, frames, count * 2 * sizeof(int16_t));
+    current->count = count;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready_slots.push_back(current);
+    }
+    ready.notify_one();
+
+    current = nullptr;
+    stem_count = 0;
+}
+
+bool WavWriter::uses_stems() {
+    return stems and file != nullptr;
+}
+
+void WavWriter::write_stems(const int32_t *samples, int stride, int count) {
+    if (current == nullptr) {
+        current = take_free_slot();
+    }
+
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        int16_t *stem = current->stems[channel] + stem_count;
+        for (int i = 0; i < count; i++) {
+            int32_t sample = samples[channel * stride + i] * STEM_GAIN;
+            stem[i] = static_cast<int16_t>(sample > INT16_MAX ? INT16_MAX : (sample < -INT16_MAX ? -INT16_MAX : sample));
+        }
+    }
+    stem_count += count;
+}
+
+void WavWriter::write_slots() {
+    while (true) {
+        Slot *slot;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping or !ready_slots.empty(); });
+
+            if (ready_slots.empty()) {
+                return; // Stopping, and every block has been written.
+            }
+            slot = ready_slots.front();
+            ready_slots.pop_front();
+        }
+
+        fwrite(slot->frames, sizeof(int16_t), slot->count * 2, file);
+        if (stems) {
+            for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+                fwrite(slot->stems[channel], sizeof(int16_t), slot->count, stem_files[channel]);
+            }
+        }
+        frames_written += slot->count;
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            free_slots.push_back(slot);
+        }
+        freed.notify_one();
+    }
+}
+
+void WavWriter::close() {
+    if (file == nullptr) {
+        return;
+    }
+
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_one();
+        writer.join();
+    }
+
+    uint32_t frames = static_cast<uint32_t>(frames_written);
+    write_wav_header(file, 2, frames * 4);
+    fclose(file);
+    file = nullptr;
+
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        if (stem_files[channel] != nullptr) {
+            write_wav_header(stem_files[channel], 1, frames * 2);
+            fclose(stem_files[channel]);
+            stem_files[channel] = nullptr;
+        }
+    }
+}
+
+uint64_t WavWriter::get_frames_written() {
+    return frames_written;
+}
+
+uint64_t WavWriter::get_audio_hash() {
+    return audio_hash;
+}
@@ -0,0 +1,127 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_WAV_WRITER_H
+#define GAME_BOY_EMULATOR_WAV_WRITER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../apu/apu.h"
+
+#define WAV_POOL_SIZE 16
+#define WAV_HEADER_SIZE 44
+
+/*
+ * Streams the audio from the APU to a WAV file, as fast as the emulator can
+ * make it. Used to record audio when running headless, and to check the
+ * audio in tests without a sound device.
+ *
+ * Blocks are copied into a pool of buffers that are allocated up front, and
+ * written by a separate writer thread. Unlike frame captures, no audio is ever
+ * dropped: if every buffer is in use, the emulator waits for the disk.
+ *
+ * Each channel can also be written to a stem of its own, before it is panned
+ * and mixed, to help track down which channel a problem is in. Stems are mono
+ * and named after the main file, e.g. out_square1.wav for out.wav.
+ *
+ * The hash of every frame written is kept, so tests can check the audio the
+ * same way they check the screen with GPU::screen_hash.
+ *
+ * Example usage:
+ *
+ *  WavWriter wav("out.wav", false);
+ *  apu.set_sink(&wav);
+ *  // Run the emulator.
+ *  apu.set_sink(nullptr);
+ *  wav.close();
+ */
+class WavWriter : public AudioSink {
+
+private:
+
+    /*
+     * A block waiting to be written.
+     */
+    struct Slot {
+        int16_t frames[AUDIO_BLOCK_FRAMES * 2];
+        int16_t stems[NUM_SOUND_CHANNELS][AUDIO_BLOCK_FRAMES];
+        int count;
+    };
+
+    FILE *file;
+    FILE *stem_files[NUM_SOUND_CHANNELS];
+    bool stems;
+
+    Slot *slots;
+    std::vector<Slot *> free_slots;
+    std::deque<Slot *> ready_slots;
+
+    // The slot that the stems of the next block are copied into.
+    Slot *current;
+    int stem_count;
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::condition_variable freed;
+    std::thread writer;
+    bool stopping;
+
+    std::atomic<uint64_t> frames_written;
+    uint64_t audio_hash;
+
+    Slot* take_free_slot();
+    void write_slots();
+
+public:
+
+    /*
+     * Open the files and start the writer thread.
+     *
+     * @param path: The file to write to, or nullptr to only hash the audio.
+     * @param stems: True to write a file for each channel as well.
+     */
+    WavWriter(const char *path, bool stems);
+
+    /*
+     * Write any blocks that are still waiting and close the files.
+     */
+    ~WavWriter();
+
+    /*
+     * @return: True if the files were opened successfully.
+     */
+    bool is_open();
+
+    void write_frames(const int16_t *frames, int count);
+
+    bool uses_stems();
+
+    void write_stems(const int32_t *samples, int stride, int count);
+
+    /*
+     * Write any blocks that are still waiting, fill in the sizes in the
+     * headers and close the files.
+     */
+    void close();
+
+    /*
+     * @return: The number of stereo frames written to the file.
+     */
+    uint64_t get_frames_written();
+
+    /*
+     * @return: The hash of every frame passed to the writer so far.
+     */
+    uint64_t get_audio_hash();
+};
+
+#endif
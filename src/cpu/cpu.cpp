@@ -26,15 +26,12 @@ CPU::CPU(Memory & mem) : memory(mem) {
     SP = 0xFFFE;
     PC = 0x0100;
 
-    // Initialize cycle counters
-    div_cycles = 0;
-    timer_cycles = 0;
-    total_cycles = 0;
-
     // Initialize CPU state flags
     halted = false;
+    stopped = false;
     ime_flag = false;
     num_instructions = 0;
+    io_loaded = false;
 }
 
 inline uint8_t CPU::cc(uint8_t n) {
@@ -97,6 +94,13 @@ inline uint8_t & CPU::r(uint8_t n) {
         case 5:
             return L;
         case 6:
+            if (HL >= 0xFF00 and HL <= 0xFF7F) {
+                if (!io_loaded) {
+                    io_byte = memory.load_byte(HL);
+                    io_loaded = true;
+                }
+                return io_byte;
+            }
             return memory.get_byte_reference(HL);
         case 7:
             return A;
@@ -105,6 +109,29 @@ inline uint8_t & CPU::r(uint8_t n) {
     }
 }
 
+/*
+ * Like r, for instructions that only write to the register. (HL) isn't read
+ * first when it is an IO register.
+ */
+inline uint8_t & CPU::w(uint8_t n) {
+    if (n == 6 and HL >= 0xFF00 and HL <= 0xFF7F) {
+        io_loaded = true;
+        return io_byte;
+    }
+    return r(n);
+}
+
+/*
+ * Write the copy of the IO register at (HL) back to memory, if the
+ * instruction changed it.
+ */
+inline void CPU::write_back(uint8_t n) {
+    if (n == 6 and io_loaded) {
+        memory.store_byte(HL, io_byte);
+        io_loaded = false;
+    }
+}
+
 inline void CPU::alu(uint8_t op, uint8_t val) {
     uint8_t old_C = C_;
     switch (op) {
@@ -234,6 +261,7 @@ inline void CPU::rot(uint8_t op, uint8_t i) {
             break;
     }
     Z_ = (r(i) == 0)? 1 : 0;
+    write_back(i);
 }
 
 inline void CPU::bit(uint8_t b, uint8_t z) {
@@ -253,6 +281,7 @@ inline void CPU::res(uint8_t y, uint8_t z) {
         case 6:
         case 7:
             reset_bit(r(z), y);
+            write_back(z);
             break;
         default:
             throw "Invalid bit index";
@@ -270,6 +299,7 @@ inline void CPU::set(uint8_t y, uint8_t z) {
         case 6:
         case 7:
             set_bit(r(z), y);
+            write_back(z);
             break;
         default:
             throw "Invalid bit index";
@@ -278,20 +308,22 @@ inline void CPU::set(uint8_t y, uint8_t z) {
 
 uint32_t CPU::execute_next_instr() {
     uint32_t cycles = 0;
-    if (!halted) {
+    if (!halted and !stopped) {
         cycles = fetch_execute_instruction();
     }
     else {
-        // NOPs
+        // NOPs. STOP ends once a button is held down on a selected line.
+        if (stopped and memory.get_joypad().line_low()) {
+            stopped = false;
+        }
         cycles += 4;
     }
 
-    // Handle memory flags that were raised after executing the instruction.
-    handle_memory_flags();
-
-    // Update timer and serial transfer registers.
+    // Update timer, serial transfer, sound registers and OAM DMA.
     update_timer(cycles);
     update_serial(cycles);
+    update_sound(cycles);
+    update_dma(cycles);
     return cycles;
  }
 
@@ -324,6 +356,7 @@ string CPU::to_string() {
 
 inline uint32_t CPU::fetch_execute_instruction() {
     uint8_t instr = memory.load_byte(PC);
+    io_loaded = false;
     uint8_t x = instr >> 6; // Bits (6-7) of the instruction.
     uint8_t y = (instr & 0x38) >> 3; // Bits (3-5) of the instruction.
     uint8_t z = (instr & 0x07); // Bits (0-2) of the instruction.
@@ -380,6 +413,7 @@ inline uint32_t CPU::fetch_execute_instruction() {
             }
             else if (y == 2) {
                 // STOP
+                stopped = !memory.get_joypad().line_low();
                 PC += 2;
                 cycles += 4;
             }
@@ -492,6 +526,7 @@ inline uint32_t CPU::fetch_execute_instruction() {
             H_ = half_carry_8(r(y), 1);
             r(y) += 1;
             Z_ = (r(y) == 0) ? 1 : 0;
+            write_back(y);
             PC += 1;
             cycles += 4;
             if (y == 6) {
@@ -504,6 +539,7 @@ inline uint32_t CPU::fetch_execute_instruction() {
             H_ = half_borrow_8(r(y), 1);
             r(y) -= 1;
             Z_ = (r(y) == 0) ? 1 : 0;
+            write_back(y);
             PC += 1;
             cycles += 4;
             if (y == 6) {
@@ -512,7 +548,8 @@ inline uint32_t CPU::fetch_execute_instruction() {
         }
         else if (z == 6) {
             // LD r[y], n
-            r(y) = memory.load_byte(PC + 1);
+            w(y) = memory.load_byte(PC + 1);
+            write_back(y);
             PC += 2;
             cycles += 8;
             if (y == 6) {
@@ -595,7 +632,8 @@ inline uint32_t CPU::fetch_execute_instruction() {
         }
         else {
             // LD r[y], r[z]
-            r(y) = r(z);
+            w(y) = r(z);
+            write_back(y);
             PC += 1;
             cycles += 4;
             if (y == 6 or z == 6) {
@@ -846,13 +884,19 @@ inline uint32_t CPU::fetch_execute_instruction() {
 }
 
 void CPU::handle_interrupts() {
-    uint8_t interrupt_flag = memory.load_byte(IF);
-    uint8_t interrupts = memory.load_byte(IE) & interrupt_flag;
+    // Memory keeps track of IE & IF, so nothing is read unless an interrupt
+    // may be pending.
+    if (!memory.get_pending_interrupts()) {
+        return;
+    }
 
-    // Check if any of the enabled interrupts have fired.
-    if (!interrupts) {
+    // Check if any of the enabled interrupts have fired. Only the joypad can
+    // wake the CPU from STOP.
+    uint8_t interrupts = memory.refresh_pending_interrupts();
+    if (!interrupts or stopped) {
         return;
     }
+    uint8_t interrupt_flag = memory.load_byte(IF);
 
     halted = false;
 
@@ -896,149 +940,69 @@ void CPU::handle_interrupts() {
 }
 
 inline void CPU::update_timer(uint32_t cycles) {
-    div_cycles += cycles;
-    timer_cycles += cycles;
-    total_cycles += cycles;
-
-    // Increment the div register.
-    if (div_cycles > 256) {
-        div_cycles -= 256;
-        memory.get_byte_reference(DIV) += 1;
-    }
-
-    uint8_t tac = memory.load_byte(TAC);
-    uint8_t timer = memory.load_byte(TIMA);
-    uint8_t interrupt_flag = memory.load_byte(IF);
-
-    uint32_t times[] = {1024, 16, 64, 256};
-    uint32_t timer_threshold = times[tac & 0b00000011];
-
-    // If timer is not enabled, then don't update it.
-    if (!get_bit(tac, 2)) {
-        return;
-    }
-
-    // Wait 4 cycles before reloading the timer.
-    if (timer_cycles >= 4 && memory.get_flag(RELOAD_TIMER_A_FLAG)) {
-        memory.set_flag(RELOAD_TIMER_A_FLAG, false);
-        memory.set_flag(RELOAD_TIMER_B_FLAG, true);
-        timer = memory.get_new_timer_value();
-    }
-
-    else if (timer_cycles >= 8 && memory.get_flag(RELOAD_TIMER_B_FLAG)) {
-        memory.set_flag(RELOAD_TIMER_B_FLAG, false);
-    }
-
-    while (timer_cycles >= timer_threshold) {
-        if (timer == 0xFF) {
-            timer = 0x00;
-
-            set_bit(interrupt_flag, 2);
-            memory.set_new_timer_value();
-            memory.set_flag(RELOAD_TIMER_A_FLAG, true);
-        }
-        else {
-            timer += 1;
-        }
-        timer_cycles -= timer_threshold;
+    // DIV and TIMA are worked out when they are read, so the timer only needs
+    // attention when TIMA overflows.
+    if (memory.get_timer().tick(cycles)) {
+        memory.request_interrupt(TIMER_INTERRUPT);
     }
-
-    memory.get_byte_reference(TIMA) = timer;
-    memory.store_byte(IF, interrupt_flag);
 }
 
 inline void CPU::update_serial(uint32_t cycles) {
-    uint8_t sc = memory.load_byte(SC);
-    uint8_t sb = memory.load_byte(SB);
-    uint8_t interrupt_flag = memory.load_byte(IF);
-
-    if (get_bit(sc, 7) && get_bit(sc, 0)) {
-        serial_cycles += cycles;
-
-        if (serial_bits < 0) {
-            serial_bits = 0;
-            serial_cycles = 0;
-        }
-        else if (serial_cycles >= 512) {
-            if (serial_bits > 7) {
-                reset_bit(sc, 7);
-                set_bit(interrupt_flag, 3);
-                serial_bits = -1;
-            }
-            else {
-                sb = sb << 1;
-                set_bit(sb, 0);
-                serial_cycles -= 512;
-                serial_bits += 1;
-            }
-        }
+    if (memory.get_serial().tick(cycles)) {
+        memory.request_interrupt(SERIAL_INTERRUPT);
     }
+}
 
-    memory.store_byte(SB, sb);
-    memory.store_byte(SC, sc);
-    memory.store_byte(IF, interrupt_flag);
+inline void CPU::update_sound(uint32_t cycles) {
+    // The APU catches up on its own when its registers are used, so this only
+    // mixes a block of audio once one is due.
+    memory.get_apu().tick(cycles);
+}
+
+inline void CPU::update_dma(uint32_t cycles) {
+    memory.tick_oam_dma(cycles);
 }
 
 long unsigned CPU::get_num_instructions() {
     return num_instructions;
 }
 
-uint8_t CPU::get_timer_mux(uint16_t timer_cycles, uint8_t tac) {
-    uint8_t tac_mode = tac & 0b00000011;
-    uint8_t tac_enable = get_bit(tac, 2);
-
-    if (tac_mode == TIMER_4096_MODE) {
-        return (get_bit(timer_cycles, 9)) && tac_enable;
-    }
-    else if (tac_mode == TIMER_262144_MODE) {
-        return (get_bit(timer_cycles, 3)) && tac_enable;
-    }
-    else if (tac_mode == TIMER_65536_MODE) {
-        return (get_bit(timer_cycles, 5)) && tac_enable;
-    }
-    else {
-        return (get_bit(timer_cycles, 7)) && tac_enable;
-    }
+bool CPU::is_stopped() {
+    return stopped;
 }
 
 void CPU::tick_cpu_clock(uint32_t cycles) {
     update_timer(cycles);
     update_serial(cycles);
+    update_sound(cycles);
+    update_dma(cycles);
 }
 
-void CPU::handle_memory_flags() {
-    uint8_t tac = memory.load_byte(TAC);
-
-    if (memory.get_flag(RESET_DIV_CYCLES_FLAG)) {
-
-        if (get_timer_mux(total_cycles, tac) && !get_timer_mux(0, tac)) {
-            memory.get_byte_reference(TIMA) += 1;
-        }
-
-        div_cycles = 0;
-        timer_cycles = 0;
-        total_cycles = 0;
-        memory.set_flag(RESET_DIV_CYCLES_FLAG, false);
-    }
+void CPU::save_state(StateWriter & writer) {
+    uint16_t registers[6] = {AF, BC, DE, HL, SP, PC};
+    bool flags[3] = {halted, stopped, ime_flag};
 
-    if (memory.get_flag(WRITE_TO_TAC_FLAG)) {
-        uint8_t old_tac = memory.get_old_TAC_value();
+    writer.write(registers, sizeof(registers));
+    writer.write(flags, sizeof(flags));
+}
 
-        if (get_timer_mux(total_cycles, old_tac) && !get_timer_mux(total_cycles, tac)) {
-            memory.get_byte_reference(TIMA) += 1;
-        }
+bool CPU::load_state(StateReader & reader) {
+    uint16_t registers[6];
+    bool flags[3];
 
-        memory.set_flag(WRITE_TO_TAC_FLAG, false);
+    if (!reader.read(registers, sizeof(registers)) or !reader.read(flags, sizeof(flags))) {
+        return false;
     }
 
-    if (memory.get_flag(OAM_DMA_FLAG)) {
-        timer_cycles += 671;
-        total_cycles += 671;
-        div_cycles += 671;
-
-        uint8_t DMA_address = memory.get_DMA_Address();
+    AF = registers[0];
+    BC = registers[1];
+    DE = registers[2];
+    HL = registers[3];
+    SP = registers[4];
+    PC = registers[5];
 
-        memory.copy_sprite_memory(DMA_address);
-        memory.set_flag(OAM_DMA_FLAG, false);
-    }
-}
\ No newline at end of file
+    halted = flags[0];
+    stopped = flags[1];
+    ime_flag = flags[2];
+    return true;
+}
@@ -13,13 +13,9 @@
 
 #include "carry.h"
 #include "../memory/memory.h"
+#include "../state/state_format.h"
 #include "../util/util.h"
 
-#define TIMER_4096_MODE 0
-#define TIMER_262144_MODE 1
-#define TIMER_65536_MODE 2
-#define TIMER_16384_MODE 3
-
 /*
  * Provides methods for executing instructions, updating register values, and
  * handling interrupts.
@@ -34,27 +30,30 @@
  *      cpu.handler_interrupts();
  *  }
  *
- * The CPU also tracks the number of clock cycles that have elapsed, and
- * updates the appropriate timer registers as required.
+ * The CPU also moves the timer forward by the number of clock cycles that
+ * have elapsed, and requests a timer interrupt when TIMA overflows.
  */
 class CPU {
 
 private:
     bool halted; // CPU is halted.
+    bool stopped; // CPU is stopped until a button is pressed.
     bool ime_flag; // Master interrupt flag.
 
     uint64_t num_instructions; // The number of instructions executed.
-    uint16_t total_cycles; // The total number of cycles the CPU has been executing for.
-
-    int serial_cycles; // Number of cycles since the SB register was updated.
-    int serial_bits; // The number of serial bits transferred.
-    int div_cycles; // Number of cycles since the DIV register was last updated.
-    int timer_cycles; // Number of cycles since the TIMA register was updated.
 
     Memory & memory; // The memory that the CPU reads from and writes to.
 
+    // A copy of the IO register at (HL), for instructions that change it.
+    // The registers only see a write when it is made through store_byte, so
+    // the copy is written back once the instruction is done with it.
+    uint8_t io_byte;
+    bool io_loaded;
+
     uint8_t cc(uint8_t);
     uint8_t & r(uint8_t);
+    uint8_t & w(uint8_t);
+    void write_back(uint8_t);
     uint16_t & rp(uint8_t);
     uint16_t & rp2(uint8_t);
 
@@ -66,7 +65,8 @@ private:
 
     void update_timer(uint32_t);
     void update_serial(uint32_t);
-    uint8_t get_timer_mux(uint16_t, uint8_t);
+    void update_sound(uint32_t);
+    void update_dma(uint32_t);
 
 public:
     // CPU registers.
@@ -132,7 +132,7 @@ public:
     /*
      * Read and execute the next instruction. This method also updates the
      * internal timer. It does not handle any interrupts. If the CPU has
-     * been halted, this method does nothing.
+     * been halted or stopped, this method does nothing.
      *
      * @return: The number of cycles the CPU used to execute the instruction.
      */
@@ -158,15 +158,29 @@ public:
     long unsigned get_num_instructions();
 
     /*
-     * Handle the memory flags that were raised after executing an intstruction.
+     * @return: True if the CPU executed STOP, and is waiting for a button to
+     * be pressed.
      */
-    void handle_memory_flags();
+    bool is_stopped();
 
     /*
      * Tick the cpu clock forward by the specified number of cycles.
      * This updates the internal timer and the serial port.
      */
     void tick_cpu_clock(uint32_t cycles);
+
+    /*
+     * Add the registers, and whether the CPU is halted or stopped, to a save
+     * state. The number of instructions executed isn't saved.
+     */
+    void save_state(StateWriter & writer);
+
+    /*
+     * Restore the CPU from the open chunk of a save state.
+     *
+     * @return: False if the chunk is too short.
+     */
+    bool load_state(StateReader & reader);
 };
 
 #endif
@@ -0,0 +1,179 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include "timer.h"
+#include "../memory/memory.h"
+#include "../util/util.h"
+
+Timer::Timer() {
+    cycles = 0;
+    next_event = TIMER_NO_EVENT;
+
+    div_origin = 0;
+    div_base = 0x18;
+
+    timer_origin = 0;
+    tima = 0x00;
+    tma = 0x00;
+    tac = 0xF8;
+    new_timer_value = 0x00;
+
+    reload_a = false;
+    reload_b = false;
+}
+
+inline bool Timer::enabled() {
+    return get_bit(tac, 2);
+}
+
+inline uint32_t Timer::period() {
+    static const uint32_t periods[] = {1024, 16, 64, 256};
+    return periods[tac & 0b00000011];
+}
+
+inline bool Timer::counter_bit() {
+    static const int bits[] = {9, 3, 5, 7};
+    return enabled() and get_bit(get_total_cycles(), bits[tac & 0b00000011]);
+}
+
+void Timer::sync() {
+    if (enabled()) {
+        uint64_t increments = (cycles - timer_origin) / period();
+        tima += increments;
+        timer_origin += increments * period();
+    }
+}
+
+void Timer::schedule() {
+    if (!enabled()) {
+        // Reloads wait for the timer to be enabled again.
+        next_event = TIMER_NO_EVENT;
+    }
+    else if (reload_a or reload_b) {
+        next_event = cycles + 1;
+    }
+    else {
+        int64_t overflow = timer_origin + (0x100 - tima) * period();
+        next_event = overflow > static_cast<int64_t>(cycles) ? overflow : cycles + 1;
+    }
+}
+
+bool Timer::handle_event() {
+    if (!enabled()) {
+        next_event = TIMER_NO_EVENT;
+        return false;
+    }
+
+    int64_t timer_cycles = cycles - timer_origin;
+    bool overflow = false;
+
+    // Wait 4 cycles before reloading the timer.
+    if (timer_cycles >= 4 && reload_a) {
+        reload_a = false;
+        reload_b = true;
+        tima = new_timer_value;
+    }
+    else if (timer_cycles >= 8 && reload_b) {
+        reload_b = false;
+    }
+
+    uint64_t increments = timer_cycles / period();
+    if (increments > 0xFFu - tima) {
+        overflow = true;
+        new_timer_value = tma;
+        reload_a = true;
+    }
+
+    tima += increments;
+    timer_origin += increments * period();
+
+    schedule();
+    return overflow;
+}
+
+uint16_t Timer::get_total_cycles() {
+    return static_cast<uint16_t>(cycles - div_origin);
+}
+
+uint8_t Timer::load_byte(uint16_t address) {
+    if (address == DIV) {
+        // DIV goes up once the count passes each multiple of 256.
+        int64_t div_cycles = cycles - div_origin;
+        return div_base + (div_cycles > 0 ? (div_cycles - 1) >> 8 : 0);
+    }
+    else if (address == TIMA) {
+        sync();
+        return tima;
+    }
+    else if (address == TMA) {
+        return tma;
+    }
+    return tac;
+}
+
+void Timer::store_byte(uint16_t address, uint8_t value) {
+    if (address == DIV) {
+        if (counter_bit()) {
+            increment_tima();
+        }
+        reset_div();
+    }
+    else if (address == TIMA) {
+        write_tima(value);
+    }
+    else if (address == TMA) {
+        write_tma(value);
+    }
+    else {
+        bool was_set = counter_bit();
+        write_tac(value);
+        if (was_set and !counter_bit()) {
+            increment_tima();
+        }
+    }
+}
+
+void Timer::reset_div() {
+    sync();
+    div_origin = cycles;
+    div_base = 0;
+    timer_origin = cycles;
+    schedule();
+}
+
+void Timer::increment_tima() {
+    sync();
+    tima += 1;
+    schedule();
+}
+
+void Timer::write_tima(uint8_t value) {
+    if (reload_a) { // Overwrite new_timer_value.
+        new_timer_value = value;
+    }
+    else if (reload_b) {
+        // Ignore writes to TIMA in this state.
+    }
+    else {
+        sync();
+        tima = value;
+        schedule();
+    }
+}
+
+void Timer::write_tma(uint8_t value) {
+    if (reload_b) {
+        sync();
+        tima = value;
+    }
+    tma = value;
+    new_timer_value = value;
+    schedule();
+}
+
+void Timer::write_tac(uint8_t value) {
+    sync();
+    tac = value | 0b11111000;
+    schedule();
+}
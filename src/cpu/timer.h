@@ -0,0 +1,142 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_TIMER_H
+#define GAME_BOY_EMULATOR_TIMER_H
+
+#include <cstdint>
+
+// The deadline of a timer with no event pending.
+#define TIMER_NO_EVENT UINT64_MAX
+
+/*
+ * The DIV, TIMA, TMA and TAC registers.
+ *
+ * Rather than counting cycles after every instruction, the timer keeps a
+ * master cycle count and works out DIV and TIMA from it when they are read:
+ *
+ *  DIV = the value DIV was reset to + the cycles since it was reset / 256
+ *  TIMA = the value TIMA was written with + the cycles since then / the TAC period
+ *
+ * The only work left to do between instructions is the next TIMA overflow,
+ * which is scheduled as a single deadline and re-scheduled whenever TAC, TMA,
+ * TIMA or DIV is written. While a reload is in progress the deadline is the
+ * next instruction, since TIMA and TMA writes behave differently until the
+ * reload has finished.
+ *
+ * Registers are read as they were at the end of the last instruction, and
+ * writes take effect from then. TIMA really counts the falling edges of one
+ * bit of DIV's internal counter, so writing DIV or TAC can make that bit fall
+ * and increment TIMA. Memory passes register writes straight to the timer,
+ * which handles these increments as part of the write.
+ *
+ * Example usage:
+ *
+ *  if (timer.tick(cycles)) {
+ *      // Request a timer interrupt.
+ *  }
+ */
+class Timer {
+
+private:
+
+    uint64_t cycles; // The number of cycles since the timer was created.
+    uint64_t next_event; // The cycle count at which the next event is handled.
+
+    // DIV counts up from div_base, starting at div_origin.
+    int64_t div_origin;
+    uint8_t div_base;
+
+    // TIMA has counted every TAC period from timer_origin up to its value.
+    // The cycles since timer_origin keep adding up while the timer is disabled.
+    int64_t timer_origin;
+    uint8_t tima;
+
+    uint8_t tma;
+    uint8_t tac;
+
+    // The value TIMA is reloaded with after an overflow. TIMA writes in the
+    // cycles after the overflow change this instead of TIMA.
+    uint8_t new_timer_value;
+
+    bool reload_a; // TIMA has overflowed and is about to be reloaded.
+    bool reload_b; // TIMA has just been reloaded, and ignores writes.
+
+    bool enabled();
+    uint32_t period();
+
+    /*
+     * @return: True if the bit of the internal counter that TIMA counts the
+     * falling edges of is set, and the timer is enabled.
+     */
+    bool counter_bit();
+
+    /*
+     * Add the TAC periods that have passed since timer_origin to TIMA.
+     */
+    void sync();
+
+    /*
+     * Work out when the next event should be handled.
+     */
+    void schedule();
+
+    /*
+     * Handle TIMA overflows and reloads up to the current cycle.
+     *
+     * @return: True if TIMA overflowed.
+     */
+    bool handle_event();
+
+public:
+
+    Timer();
+
+    /*
+     * Move the master cycle count forward, handling the next event if it is due.
+     *
+     * @param elapsed: The number of cycles that have passed.
+     * @return: True if TIMA overflowed, and a timer interrupt should be requested.
+     */
+    inline bool tick(uint32_t elapsed) {
+        cycles += elapsed;
+        return cycles >= next_event and handle_event();
+    }
+
+    /*
+     * @return: The number of cycles since DIV was last reset.
+     */
+    uint16_t get_total_cycles();
+
+    /*
+     * @return: The current value of DIV, TIMA, TMA or TAC.
+     */
+    uint8_t load_byte(uint16_t address);
+
+    /*
+     * Write to DIV, TIMA, TMA or TAC, incrementing TIMA if the write makes the
+     * bit of the internal counter that it counts fall.
+     *
+     * @param address: The address of the register.
+     * @param value: The value written.
+     */
+    void store_byte(uint16_t address, uint8_t value);
+
+    /*
+     * Reset DIV and the cycles counted towards the next TIMA increment.
+     */
+    void reset_div();
+
+    /*
+     * Increment TIMA without overflowing. Used for the increments caused by
+     * DIV and TAC writes.
+     */
+    void increment_tima();
+
+    void write_tima(uint8_t value);
+    void write_tma(uint8_t value);
+    void write_tac(uint8_t value);
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "frame_blend.h"
+
+#define FRAME_BYTES (NUM_PIXELS * 4)
+
+/*
+ * The step each channel takes towards the new frame: the distance to the new
+ * frame scaled by (256 - weight) / 256, rounded up.
+ */
+static inline uint8_t blend_step(uint8_t distance, uint16_t scale) {
+    return static_cast<uint8_t>((distance * scale + 255) >> 8);
+}
+
+/*
+ * Blend the bytes of a frame into the history.
+ *
+ * @return: Non-zero if the new history is different from the frame.
+ */
+static uint8_t blend_bytes_scalar(uint8_t *frame, uint8_t *history, size_t length, uint16_t scale) {
+    uint8_t different = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = frame[i];
+        uint8_t h = history[i];
+
+        if (c > h) {
+            h += blend_step(c - h, scale);
+        }
+        else {
+            h -= blend_step(h - c, scale);
+        }
+
+        different |= h ^ c;
+        history[i] = h;
+        frame[i] = h;
+    }
+    return different;
+}
+
+#if defined(__AVX2__)
+
+static inline __m256i blend_step(__m256i distance, __m256i scale, __m256i round) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i low = _mm256_unpacklo_epi8(distance, zero);
+    __m256i high = _mm256_unpackhi_epi8(distance, zero);
+
+    low = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(low, scale), round), 8);
+    high = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(high, scale), round), 8);
+
+    // The unpacks and the pack both work within 128-bit lanes, so the bytes
+    // end up back where they started.
+    return _mm256_packus_epi16(low, high);
+}
+
+static uint8_t blend_bytes(uint8_t *frame, uint8_t *history, size_t length, uint16_t scale) {
+    __m256i scales = _mm256_set1_epi16(static_cast<short>(scale));
+    __m256i round = _mm256_set1_epi16(255);
+    __m256i different = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(frame + i));
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(history + i));
+
+        // Only one of these is non-zero for each byte, so the step can be
+        // worked out once and then clamped to the direction it goes in.
+        __m256i up = _mm256_subs_epu8(c, h);
+        __m256i down = _mm256_subs_epu8(h, c);
+        __m256i step = blend_step(_mm256_or_si256(up, down), scales, round);
+
+        up = _mm256_min_epu8(step, up);
+        down = _mm256_min_epu8(step, down);
+
+        h = _mm256_subs_epu8(_mm256_adds_epu8(h, up), down);
+        different = _mm256_or_si256(different, _mm256_xor_si256(h, c));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(history + i), h);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(frame + i), h);
+    }
+
+    bool vector_different = !_mm256_testz_si256(different, different);
+    return blend_bytes_scalar(frame + i, history + i, length - i, scale) | vector_different;
+}
+
+#elif defined(__SSE2__)
+
+static inline __m128i blend_step(__m128i distance, __m128i scale, __m128i round) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi8(distance, zero);
+    __m128i high = _mm_unpackhi_epi8(distance, zero);
+
+    low = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(low, scale), round), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(high, scale), round), 8);
+
+    return _mm_packus_epi16(low, high);
+}
+
+static uint8_t blend_bytes(uint8_t *frame, uint8_t *history, size_t length, uint16_t scale) {
+    __m128i scales = _mm_set1_epi16(static_cast<short>(scale));
+    __m128i round = _mm_set1_epi16(255);
+    __m128i different = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + i));
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(history + i));
+
+        // Only one of these is non-zero for each byte, so the step can be
+        // worked out once and then clamped to the direction it goes in.
+        __m128i up = _mm_subs_epu8(c, h);
+        __m128i down = _mm_subs_epu8(h, c);
+        __m128i step = blend_step(_mm_or_si128(up, down), scales, round);
+
+        up = _mm_min_epu8(step, up);
+        down = _mm_min_epu8(step, down);
+
+        h = _mm_subs_epu8(_mm_adds_epu8(h, up), down);
+        different = _mm_or_si128(different, _mm_xor_si128(h, c));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(history + i), h);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(frame + i), h);
+    }
+
+    bool vector_different = _mm_movemask_epi8(_mm_cmpeq_epi8(different, _mm_setzero_si128())) != 0xFFFF;
+    return blend_bytes_scalar(frame + i, history + i, length - i, scale) | vector_different;
+}
+
+#else
+
+static uint8_t blend_bytes(uint8_t *frame, uint8_t *history, size_t length, uint16_t scale) {
+    return blend_bytes_scalar(frame, history, length, scale);
+}
+
+#endif
+
+FrameBlend::FrameBlend(double persistence) {
+    if (persistence < 0) {
+        persistence = 0;
+    }
+
+    // A weight of 256 would never let the screen change.
+    int w = static_cast<int>(persistence * 256 + 0.5);
+    weight = static_cast<uint16_t>(w > 255 ? 255 : w);
+
+    history = new Pixel[NUM_PIXELS];
+    history_valid = false;
+    settled = true;
+}
+
+FrameBlend::~FrameBlend() {
+    delete[] history;
+}
+
+void FrameBlend::apply(Pixel *frame) {
+    if (!history_valid) {
+        memcpy(history, frame, FRAME_BYTES);
+        history_valid = true;
+        settled = true;
+        return;
+    }
+
+    uint8_t different = blend_bytes(reinterpret_cast<uint8_t *>(frame), reinterpret_cast<uint8_t *>(history),
+                                    FRAME_BYTES, static_cast<uint16_t>(256 - weight));
+    settled = different == 0;
+}
+
+bool FrameBlend::is_settled() {
+    return settled;
+}
+
+void FrameBlend::reset() {
+    history_valid = false;
+    settled = true;
+}
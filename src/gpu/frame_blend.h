@@ -0,0 +1,72 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_FRAME_BLEND_H
+#define GAME_BOY_EMULATOR_FRAME_BLEND_H
+
+#include <cstdint>
+
+#include "gpu.h"
+
+/*
+ * Simulates the slow response of the original Game Boy's LCD, which some
+ * games rely on to blend sprites that are only drawn every other frame.
+ *
+ * Each frame is blended with a history of the frames before it:
+ *
+ *  history = history * persistence + frame * (1 - persistence)
+ *
+ * and the history replaces the frame. Every channel always moves at least one
+ * step towards the new frame, so a still image is reached exactly rather than
+ * getting stuck a rounding error away from it. The blend is done on 16 or 32
+ * channels at a time with SSE2 or AVX2.
+ *
+ * Example usage:
+ *
+ *  FrameBlend blend(0.5);
+ *  blend.apply(frame);
+ */
+class FrameBlend {
+
+private:
+
+    // The weight of the history, out of 256.
+    uint16_t weight;
+
+    Pixel *history;
+    bool history_valid;
+
+    // True if the last frame blended was equal to the history.
+    bool settled;
+
+public:
+
+    /*
+     * @param persistence: How much of the previous frames remains visible,
+     * from 0 (no ghosting) to 1 (the screen never changes).
+     */
+    FrameBlend(double persistence);
+
+    ~FrameBlend();
+
+    /*
+     * Blend a frame into the history, and replace the frame with the result.
+     *
+     * @param frame: The NUM_PIXELS pixels of the frame.
+     */
+    void apply(Pixel *frame);
+
+    /*
+     * @return: True if the history had caught up with the last frame that
+     * was blended, so blending the same frame again would not change it.
+     */
+    bool is_settled();
+
+    /*
+     * Forget the history, so the next frame is shown as it is.
+     */
+    void reset();
+};
+
+#endif
@@ -3,9 +3,14 @@
  */
 
 #include "gpu.h"
+#include "scaler.h"
+#include "frame_blend.h"
+#include "../capture/frame_capture.h"
+#include "../input/latency.h"
 
 int GPU::window_width = SCREEN_WIDTH;
 int GPU::window_height = SCREEN_HEIGHT;
+int GPU::window_resizes = 0;
 
 Pixel::Pixel() {
     b = 255;
@@ -36,17 +41,77 @@ void Pixel::reset_to_white() {
     a = 0;
 }
 
-GPU::GPU(Memory & mem) : memory(mem) {
+GPU::GPU(Memory & mem) : GPU(mem, false) {
+
+}
+
+GPU::GPU(Memory & mem, bool headless) : memory(mem) {
+    this->headless = headless;
+    capture = nullptr;
+
+    scaler = nullptr;
+    scale = 1;
+    scaled_frame_pending = false;
+
+    blend = nullptr;
+
+    latency = nullptr;
+    num_presents = 0;
+
     cycles = 0;
-    mode = OAM_ACCESS;
+    stat_line = false;
+    stat_generation = memory.get_lcd_status_generation();
+    lcd_on = true;
+
+    // Start on the line that the memory module was initialized with.
+    ly = memory.load_byte(LY) % (SCREEN_HEIGHT + V_BLANK_LINES);
+    if (ly < SCREEN_HEIGHT) {
+        enter_mode(OAM_ACCESS, OAM_ACCESS_TIME);
+    }
+    else {
+        enter_mode(V_BLANK, LINE_TIME);
+    }
+    if (get_bit(memory.load_byte(LCDC), 7) == 0) {
+        switch_lcd(false);
+    }
+
+    frame_skip = NO_FRAME_SKIP;
+    frame_skip_n = 1;
+    frame_count = 0;
+    skipped_frames = 0;
+    consecutive_skips = 0;
+    next_frame_time = 0;
+
+    unchanged_frames = 0;
+    buffer_valid = false;
+
+    num_dirty_lines = 0;
+    line_hashes_valid = false;
+    texture = 0;
+    texture_valid = false;
+    num_uploaded_lines = 0;
+    presented_valid = false;
+    presented_resizes = window_resizes;
 
     // Initialize GLFW and create a new window.
     glfwInit();
-    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Game Boy Emulator", NULL, NULL);
-
-    glfwSwapInterval(1);
-    glfwMakeContextCurrent(window);
-    glfwSetWindowSizeCallback(window, window_resized);
+    if (headless) {
+        window = nullptr;
+    }
+    else {
+        window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Game Boy Emulator", NULL, NULL);
+
+        glfwSwapInterval(1);
+        glfwMakeContextCurrent(window);
+        glfwSetWindowSizeCallback(window, window_resized);
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TEXTURE_SIZE, TEXTURE_SIZE, 0, GL_BGRA,
+                     GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+    }
 
     // Create a new buffer of pixels.
     buffer = new Pixel[NUM_PIXELS];
@@ -61,101 +126,179 @@ void GPU::clear_window() {
 void GPU::window_resized(GLFWwindow *window, int width, int height) {
     window_width =  width;
     window_height = height;
+    window_resizes += 1;
+}
 
-    float xfactor = (float)window_width/SCREEN_WIDTH;
-    float yfactor = (float)window_height/SCREEN_HEIGHT;
+bool GPU::update_pixel_zoom() {
+    if (presented_resizes == window_resizes) {
+        return false;
+    }
+    presented_resizes = window_resizes;
+
+    float xfactor = (float)window_width/(SCREEN_WIDTH * scale);
+    float yfactor = (float)window_height/(SCREEN_HEIGHT * scale);
 
     glPixelZoom(xfactor, yfactor);
+    glViewport(0, 0, window_width, window_height);
+    return true;
 }
 
 void GPU::render_screen(uint32_t cpu_cycles) {
     cycles += cpu_cycles;
 
-    uint8_t ly = memory.load_byte(LY);
-    uint8_t lyc = memory.load_byte(LYC);
-    uint8_t stat = memory.load_byte(STAT);
-    uint8_t interrupt_flag = memory.load_byte(IF);
+    // LCDC, STAT or LYC was written, which may switch the LCD on or off, or
+    // raise the STAT interrupt line.
+    if (stat_generation != memory.get_lcd_status_generation()) {
+        stat_generation = memory.get_lcd_status_generation();
+
+        bool on = get_bit(memory.load_byte(LCDC), 7);
+        if (on != lcd_on) {
+            switch_lcd(on);
+        }
+        else if (lcd_on) {
+            update_lcd_status();
+        }
+    }
 
-    //draw_screen();
+    while (cycles >= mode_length) {
+        cycles -= mode_length;
+        next_mode();
+    }
+}
+
+void GPU::next_mode() {
+    if (!lcd_on) {
+        end_frame();
+        return;
+    }
 
     switch (mode) {
         case OAM_ACCESS:
-            if (cycles > OAM_ACCESS_TIME) {
-                mode = VRAM_ACCESS;
-                cycles -= OAM_ACCESS_TIME;
-
-                set_bit(stat, 0);
-                set_bit(stat, 1);
-            }
+            enter_mode(VRAM_ACCESS, VRAM_ACCESS_TIME);
             break;
 
         case VRAM_ACCESS:
-            if (cycles > VRAM_ACCESS_TIME) {
-                mode = H_BLANK;
-                cycles -= VRAM_ACCESS_TIME;
-
-                reset_bit(stat, 0);
-                reset_bit(stat, 1);
-            }
+            enter_mode(H_BLANK, H_BLANK_TIME);
             break;
 
         case H_BLANK:
-            if (cycles >= H_BLANK_TIME) {
-                ly += 1;
-                if (ly == SCREEN_HEIGHT) {
-                    mode = V_BLANK;
-
-                    set_bit(stat, 0);
-                    reset_bit(stat, 1);
-                    set_bit(interrupt_flag, 0);
-
-                    clear_window();
-                    draw_screen();
-                }
-                else {
-                    mode = OAM_ACCESS;
-                }
-                cycles -= H_BLANK_TIME;
+            ly += 1;
+            if (ly == SCREEN_HEIGHT) {
+                memory.request_interrupt(V_BLANK_INTERRUPT_BIT);
+                enter_mode(V_BLANK, LINE_TIME);
+                end_frame();
+            }
+            else {
+                enter_mode(OAM_ACCESS, OAM_ACCESS_TIME);
             }
             break;
 
         case V_BLANK:
-            if (cycles > H_BLANK_TIME) {
-                ly += 1;
-                if (ly == SCREEN_HEIGHT + V_BLANK_LINES) {
-                    mode = OAM_ACCESS;
-
-                    ly = 0;
-                    set_bit(stat, 1);
-                    reset_bit(stat, 0);
-                }
-                cycles -= H_BLANK_TIME;
+            ly += 1;
+            if (ly == SCREEN_HEIGHT + V_BLANK_LINES) {
+                ly = 0;
+                enter_mode(OAM_ACCESS, OAM_ACCESS_TIME);
+            }
+            else {
+                enter_mode(V_BLANK, LINE_TIME);
             }
             break;
     }
+}
 
-    if (lyc == ly) {
-        if (get_bit(stat, 6)) {
-            set_bit(interrupt_flag, 1);
+void GPU::enter_mode(Mode new_mode, uint32_t length) {
+    mode = new_mode;
+    mode_length = length;
+
+    memory.get_byte_reference(LY) = ly;
+    update_lcd_status();
+}
+
+void GPU::switch_lcd(bool on) {
+    lcd_on = on;
+    ly = 0;
+    cycles = 0;
+
+    if (on) {
+        enter_mode(OAM_ACCESS, OAM_ACCESS_TIME);
+        return;
+    }
+
+    // STAT reads as H-Blank, and nothing is requested until the LCD is
+    // switched on again. The only event left is the end of each frame.
+    mode = H_BLANK;
+    mode_length = FRAME_CYCLES;
+    stat_line = false;
+
+    memory.get_byte_reference(LY) = 0;
+    memory.get_byte_reference(STAT) &= 0xFC;
+}
+
+void GPU::update_lcd_status() {
+    uint8_t & stat = memory.get_byte_reference(STAT);
+    bool coincidence = ly == memory.load_byte(LYC);
+
+    stat = (stat & 0xF8) | (coincidence << 2) | mode;
+
+    // The STAT interrupt is requested when any of the enabled sources becomes
+    // active while none of them were active before.
+    bool line = (get_bit(stat, 6) and coincidence) or
+                (get_bit(stat, 5) and mode == OAM_ACCESS) or
+                (get_bit(stat, 4) and mode == V_BLANK) or
+                (get_bit(stat, 3) and mode == H_BLANK);
+
+    if (line and !stat_line) {
+        memory.request_interrupt(LCDC_INTERRUPT_BIT);
+    }
+    stat_line = line;
+}
+
+void GPU::end_frame() {
+    double emulated_time = latency != nullptr ? latency_clock() : 0;
+
+    // The previous frame has been scaled while this one was emulated.
+    if (scaled_frame_pending) {
+        present_scaled_frame();
+        if (latency != nullptr) {
+            latency->frame_presented(frame_count - 1, latency_clock());
         }
-        set_bit(stat, 2);
+    }
+
+    uint64_t old_presents = num_presents;
+    num_dirty_lines = 0;
+    if (!should_render_frame()) {
+        skipped_frames += 1;
     }
     else {
-        reset_bit(stat, 2);
+        // If nothing changed, the previous frame is still on the screen.
+        if (frame_changed()) {
+            clear_window();
+            draw_screen();
+        }
+
+        if (capture != nullptr) {
+            capture->capture_frame(*this);
+        }
     }
-    if (get_bit(stat, 5) and mode == OAM_ACCESS) {
-        set_bit(interrupt_flag, 1);
+
+    if (latency != nullptr) {
+        latency->frame_emulated(frame_count, num_dirty_lines > 0, emulated_time);
+
+        // Headless frames are never presented, so they count as presented
+        // once they are emulated.
+        if (num_presents != old_presents or headless) {
+            latency->frame_presented(frame_count, headless ? emulated_time : latency_clock());
+        }
     }
-    if (get_bit(stat, 4) and mode == V_BLANK) {
-        set_bit(interrupt_flag, 1);
+    frame_count += 1;
+
+    // Keep the window responsive, even if nothing was presented.
+    if (!headless) {
+        glfwPollEvents();
     }
-    if (get_bit(stat, 3) and mode == H_BLANK) {
-        set_bit(interrupt_flag, 1);
+    if (latency != nullptr) {
+        latency->buttons_polled(frame_count, latency_clock());
     }
-
-    memory.store_byte(LY, ly);
-    memory.store_byte(STAT, stat);
-    memory.store_byte(IF, interrupt_flag);
 }
 
 Pixel GPU::get_pixel(int x, int y) {
@@ -343,6 +486,7 @@ void GPU::draw_screen() {
     uint8_t lcdc = memory.load_byte(LCDC);
 
     if (get_bit(lcdc, 7) == 0) {
+        find_dirty_lines();
         return;
     }
 
@@ -357,17 +501,262 @@ void GPU::draw_screen() {
     load_window_into_buffer();
     load_sprites_into_buffer();
 
-    glDrawPixels(SCREEN_WIDTH, SCREEN_HEIGHT, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, buffer);
+    if (blend != nullptr) {
+        blend->apply(buffer);
+    }
+
+    find_dirty_lines();
+    if (scaler != nullptr) {
+        scaler->submit(buffer);
+        scaled_frame_pending = true;
+    }
+    else if (!headless) {
+        present_frame();
+    }
+}
+
+Pixel* GPU::line_pointer(int y) {
+    return buffer + (SCREEN_HEIGHT - y - 1) * SCREEN_WIDTH;
+}
+
+uint64_t GPU::hash_line(int y) {
+    return hash64(line_pointer(y), SCREEN_WIDTH * sizeof(Pixel));
+}
+
+void GPU::find_dirty_lines() {
+    num_dirty_lines = 0;
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        uint64_t hash = hash_line(y);
+
+        dirty_lines[y] = hash != line_hashes[y] or !line_hashes_valid;
+        num_dirty_lines += dirty_lines[y];
+        line_hashes[y] = hash;
+    }
+    line_hashes_valid = true;
+}
+
+void GPU::present_frame() {
+    bool resized = update_pixel_zoom();
+
+    // Upload the lines that differ from the ones the texture holds, in runs
+    // of consecutive lines.
+    bool uploaded = false;
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    int y = 0;
+    while (y < SCREEN_HEIGHT) {
+        if (texture_valid and texture_hashes[y] == line_hashes[y]) {
+            y++;
+            continue;
+        }
+
+        int start = y;
+        while (y < SCREEN_HEIGHT and (!texture_valid or texture_hashes[y] != line_hashes[y])) {
+            texture_hashes[y] = line_hashes[y];
+            y++;
+        }
+
+        // The buffer is stored bottom up, like the texture, so the run starts
+        // at the last line.
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, SCREEN_HEIGHT - y, SCREEN_WIDTH, y - start, GL_BGRA,
+                        GL_UNSIGNED_INT_8_8_8_8_REV, line_pointer(y - 1));
+        num_uploaded_lines += y - start;
+        uploaded = true;
+    }
+    texture_valid = true;
+
+    // Nothing has to be drawn if the frame is already on the screen.
+    if (!uploaded and !resized and presented_valid) {
+        return;
+    }
+
+    // The back buffer is undefined after a swap, so the texture is drawn over
+    // the whole of it.
+    float right = (float)SCREEN_WIDTH / TEXTURE_SIZE;
+    float top = (float)SCREEN_HEIGHT / TEXTURE_SIZE;
+
+    glEnable(GL_TEXTURE_2D);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(right, 0.0f);
+    glVertex2f(1.0f, -1.0f);
+    glTexCoord2f(right, top);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, top);
+    glVertex2f(-1.0f, 1.0f);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
 
     glfwSwapBuffers(window);
-    glfwPollEvents();
+    num_presents += 1;
+    presented_valid = true;
+}
+
+void GPU::present_scaled_frame() {
+    // The scaled frame is stored bottom up, like the frame buffer.
+    const Pixel *scaled = scaler->wait();
+    update_pixel_zoom();
+
+    glRasterPos2f(-1.0f, -1.0f);
+    glDrawPixels(scaler->get_width(), scaler->get_height(), GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, scaled);
+    glfwSwapBuffers(window);
+    num_presents += 1;
+
+    scaled_frame_pending = false;
+}
+
+bool GPU::should_render_frame() {
+    switch (frame_skip) {
+        case NO_FRAME_SKIP:
+            return true;
+
+        case SKIP_ONE_IN_N:
+            return frame_count % frame_skip_n != frame_skip_n - 1;
+
+        case RENDER_ONE_IN_N:
+            return frame_count % frame_skip_n == 0;
+
+        case SKIP_ALL_FRAMES:
+            return false;
+
+        case ADAPTIVE_FRAME_SKIP: {
+            double now = glfwGetTime();
+            next_frame_time += FRAME_TIME;
+
+            // Too far behind to ever catch up, so start tracking from now.
+            if (now - next_frame_time > FRAME_TIME * frame_skip_n) {
+                next_frame_time = now;
+            }
+
+            if (now > next_frame_time and consecutive_skips < frame_skip_n) {
+                consecutive_skips += 1;
+                return false;
+            }
+            consecutive_skips = 0;
+            return true;
+        }
+    }
+    return true;
+}
+
+bool GPU::frame_changed() {
+    uint64_t vram_generation = memory.get_vram_generation();
+    uint64_t oam_generation = memory.get_oam_generation();
+    uint64_t video_register_generation = memory.get_video_register_generation();
+
+    // A blended frame keeps changing until it catches up with the screen.
+    bool fading = blend != nullptr and !blend->is_settled();
+
+    if (buffer_valid and !fading and
+        vram_generation == drawn_vram_generation and
+        oam_generation == drawn_oam_generation and
+        video_register_generation == drawn_video_register_generation) {
+        unchanged_frames += 1;
+        return false;
+    }
+
+    buffer_valid = true;
+    drawn_vram_generation = vram_generation;
+    drawn_oam_generation = oam_generation;
+    drawn_video_register_generation = video_register_generation;
+    return true;
+}
+
+void GPU::wait_events() {
+    if (headless) {
+        return;
+    }
+
+    glfwWaitEvents();
+    if (latency != nullptr) {
+        latency->buttons_polled(frame_count, latency_clock());
+    }
+}
+
+void GPU::set_frame_skip(FrameSkip policy, int n) {
+    frame_skip = policy;
+    frame_skip_n = n > 0 ? n : 1;
+    consecutive_skips = 0;
+    next_frame_time = glfwGetTime();
+}
+
+uint64_t GPU::get_frame_count() {
+    return frame_count;
+}
+
+uint64_t GPU::get_skipped_frames() {
+    return skipped_frames;
+}
+
+uint64_t GPU::get_unchanged_frames() {
+    return unchanged_frames;
+}
+
+int GPU::get_num_dirty_lines() {
+    return num_dirty_lines;
+}
+
+uint64_t GPU::get_num_uploaded_lines() {
+    return num_uploaded_lines;
+}
+
+bool GPU::is_line_dirty(int y) {
+    return num_dirty_lines > 0 and dirty_lines[y];
+}
+
+const Pixel* GPU::get_line(int y) {
+    return line_pointer(y);
 }
 
 GLFWwindow* GPU::get_window() {
     return window;
 }
 
+void GPU::set_capture(FrameCapture *capture) {
+    this->capture = capture;
+}
+
+void GPU::set_latency_probe(LatencyProbe *latency) {
+    this->latency = latency;
+}
+
+void GPU::set_scale_filter(ScaleFilter filter) {
+    if (headless) {
+        return;
+    }
+
+    if (scaled_frame_pending) {
+        present_scaled_frame();
+    }
+    delete scaler;
+    scaler = filter == NO_SCALING ? nullptr : new Scaler(filter);
+    scale = scale_factor(filter);
+
+    // Whatever was presented has to be drawn again at the new scale.
+    presented_valid = false;
+    window_resizes += 1;
+
+    glfwSetWindowSize(window, SCREEN_WIDTH * scale, SCREEN_HEIGHT * scale);
+}
+
+void GPU::set_ghosting(double persistence) {
+    delete blend;
+    blend = persistence > 0 ? new FrameBlend(persistence) : nullptr;
+}
+
+void GPU::set_vsync(bool enabled) {
+    if (window != nullptr) {
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(enabled ? 1 : 0);
+    }
+}
+
 bool GPU::window_open() {
+    if (headless) {
+        return true;
+    }
     return !static_cast<bool>(glfwWindowShouldClose(window));
 }
 
@@ -380,4 +769,47 @@ uint64_t GPU::screen_hash() {
     }
 
     return hash;
-}
\ No newline at end of file
+}
+
+uint64_t GPU::frame_hash() {
+    if (line_hashes_valid) {
+        return hash64(line_hashes, sizeof(line_hashes));
+    }
+
+    // Hash the lines without touching the dirty lines of the last frame.
+    uint64_t hashes[SCREEN_HEIGHT];
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        hashes[y] = hash_line(y);
+    }
+    return hash64(hashes, sizeof(hashes));
+}
+
+uint64_t GPU::line_hash(int y) {
+    return line_hashes_valid ? line_hashes[y] : hash_line(y);
+}
+
+void GPU::save_state(StateWriter & writer) {
+    writer.write(&mode, sizeof(mode));
+    writer.write(&mode_length, sizeof(mode_length));
+    writer.write(&cycles, sizeof(cycles));
+    writer.write(&ly, sizeof(ly));
+    writer.write(&stat_line, sizeof(stat_line));
+    writer.write(&lcd_on, sizeof(lcd_on));
+    writer.write(buffer, NUM_PIXELS * sizeof(Pixel));
+}
+
+bool GPU::load_state(StateReader & reader) {
+    bool loaded = reader.read(&mode, sizeof(mode)) and
+                  reader.read(&mode_length, sizeof(mode_length)) and
+                  reader.read(&cycles, sizeof(cycles)) and
+                  reader.read(&ly, sizeof(ly)) and
+                  reader.read(&stat_line, sizeof(stat_line)) and
+                  reader.read(&lcd_on, sizeof(lcd_on)) and
+                  reader.read(buffer, NUM_PIXELS * sizeof(Pixel));
+
+    stat_generation = memory.get_lcd_status_generation();
+    buffer_valid = false;
+    line_hashes_valid = false;
+    presented_valid = false;
+    return loaded;
+}
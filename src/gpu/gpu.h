@@ -9,18 +9,31 @@
 
 #include "sprite.h"
 #include "../util/util.h"
+#include "../util/hash.h"
 #include "../memory/memory.h"
+#include "../state/state_format.h"
 
 #define OAM_ACCESS_TIME 80
 #define VRAM_ACCESS_TIME 172
 #define H_BLANK_TIME 204
+#define LINE_TIME (OAM_ACCESS_TIME + VRAM_ACCESS_TIME + H_BLANK_TIME)
 
 #define V_BLANK_LINES 10
 
+#define V_BLANK_INTERRUPT_BIT 0x01
+#define LCDC_INTERRUPT_BIT 0x02
+
+#define FRAME_CYCLES (LINE_TIME * (SCREEN_HEIGHT + V_BLANK_LINES)) // Length of a frame in cycles.
+#define FRAME_TIME (70224.0 / 4194304.0) // Length of a frame in seconds.
+
 #define SCREEN_WIDTH 160
 #define SCREEN_HEIGHT 144
 #define NUM_PIXELS SCREEN_WIDTH * SCREEN_HEIGHT
 
+// The width and height of the texture the screen is drawn from. Older versions
+// of OpenGL only allow textures whose sides are a power of two.
+#define TEXTURE_SIZE 256
+
 #define BGR_WIDTH 256
 #define BGR_HEIGHT 256
 
@@ -41,6 +54,11 @@
 #define LIGHT_GREY Pixel(192, 192, 192, 0)
 #define WHITE Pixel(255, 255, 255, 0)
 
+class FrameCapture;
+class Scaler;
+class FrameBlend;
+class LatencyProbe;
+
 /*
  * Represents a single pixel on the screen.
  */
@@ -62,13 +80,40 @@ struct Pixel {
 };
 
 /*
- * Different modes the GPU can be in.
+ * Different modes the GPU can be in. The values match the mode bits of the
+ * STAT register.
  */
 enum Mode {
-    OAM_ACCESS,
-    VRAM_ACCESS,
-    H_BLANK,
-    V_BLANK
+    OAM_ACCESS = 2,
+    VRAM_ACCESS = 3,
+    H_BLANK = 0,
+    V_BLANK = 1
+};
+
+/*
+ * Policies for skipping frames. A skipped frame is not rasterized or
+ * presented, but the GPU still steps through every mode so that LY, STAT and
+ * the LCD interrupts behave exactly as they would if the frame was drawn.
+ */
+enum FrameSkip {
+    NO_FRAME_SKIP, // Render every frame.
+    SKIP_ONE_IN_N, // Skip 1 of every N frames.
+    RENDER_ONE_IN_N, // Only render 1 of every N frames.
+    SKIP_ALL_FRAMES, // Never render a frame.
+    ADAPTIVE_FRAME_SKIP // Skip up to N frames in a row while running behind real time.
+};
+
+/*
+ * Filters that can be used to scale up the screen.
+ */
+enum ScaleFilter {
+    NO_SCALING,
+    NEAREST_2X, // Each pixel becomes a 2x2 block.
+    NEAREST_3X, // Each pixel becomes a 3x3 block.
+    NEAREST_4X, // Each pixel becomes a 4x4 block.
+    SCALE_2X, // Scale2x (AdvMAME2x), which rounds off diagonal edges.
+    SCALE_3X, // Scale3x (AdvMAME3x).
+    XBR_LITE_2X // Scale2x's edge detection with xBR style blending of the corners.
 };
 
 /*
@@ -83,6 +128,10 @@ private:
     static int window_width;
     static int window_height;
 
+    // Incremented whenever the window is resized, which invalidates whatever
+    // has already been presented.
+    static int window_resizes;
+
     const uint16_t base_addresses[2] = {0x9800, 0x9C00};
     const uint16_t tile_addresses[2] = {0x9000, 0x8000};
 
@@ -90,14 +139,50 @@ private:
 
     Pixel palette[4]; // The 4 colors that make up the palette.
 
-    // The number of cycles tracked by the GPU.
+    // The number of cycles spent in the current mode, and the number of
+    // cycles after which the GPU moves on to the next mode.
     long cycles;
+    uint32_t mode_length;
+
+    // The line that is currently being drawn (the value of LY).
+    uint8_t ly;
+
+    // True while any of the enabled STAT interrupt sources is active.
+    bool stat_line;
+
+    // False while bit 7 of LCDC is clear. LY stays at 0 and no modes are
+    // stepped through, but frames still end on time so that the host keeps
+    // polling for events and pacing itself.
+    bool lcd_on;
+
+    // The write generation of STAT and LYC that the GPU last responded to.
+    uint64_t stat_generation;
 
     // Reference to the Game Boy's memory module.
     Memory & memory;
 
-    // The GLFW window on which the screen will be rendered.
+    // The GLFW window on which the screen will be rendered. There is no window
+    // when running headless.
     GLFWwindow *window;
+    bool headless;
+
+    // Receives every frame that is presented, if set.
+    FrameCapture *capture;
+
+    // Scales frames on a worker thread before they are presented, if set.
+    // A frame is presented at the end of the frame after it was drawn.
+    Scaler *scaler;
+    int scale;
+    bool scaled_frame_pending;
+
+    // Blends each drawn frame with the frames before it, if set.
+    FrameBlend *blend;
+
+    // Told when each frame is emulated and presented, if set.
+    LatencyProbe *latency;
+
+    // The number of times a frame was swapped onto the window.
+    uint64_t num_presents;
 
     // The array of pixels that will be rendered to the screen.
     Pixel *buffer;
@@ -105,6 +190,62 @@ private:
     // The current mode that the GPU is in.
     Mode mode;
 
+    // The frame skipping policy, and the N that the policy applies to.
+    FrameSkip frame_skip;
+    uint32_t frame_skip_n;
+
+    // The number of frames emulated, and the number of frames skipped.
+    uint64_t frame_count;
+    uint64_t skipped_frames;
+
+    // Used by the adaptive policy to track how far behind real time we are.
+    uint32_t consecutive_skips;
+    double next_frame_time;
+
+    // The number of frames that were not redrawn because they would have been
+    // identical to the previous frame.
+    uint64_t unchanged_frames;
+
+    // The memory write generations that the frame buffer was last drawn from.
+    bool buffer_valid;
+    uint64_t drawn_vram_generation;
+    uint64_t drawn_oam_generation;
+    uint64_t drawn_video_register_generation;
+
+    // A hash of each line of the frame buffer, indexed by screen line (0 is the
+    // top of the screen), and the lines that changed in the last frame drawn.
+    uint64_t line_hashes[SCREEN_HEIGHT];
+    bool dirty_lines[SCREEN_HEIGHT];
+    bool line_hashes_valid;
+    int num_dirty_lines;
+
+    // A texture that keeps the last frame presented, so that only the lines
+    // that changed since have to be uploaded, and the line hashes it holds.
+    GLuint texture;
+    uint64_t texture_hashes[SCREEN_HEIGHT];
+    bool texture_valid;
+    uint64_t num_uploaded_lines;
+
+    // True while the window shows what the texture holds.
+    bool presented_valid;
+    int presented_resizes;
+
+    void next_mode();
+    void enter_mode(Mode mode, uint32_t length);
+    void update_lcd_status();
+    void switch_lcd(bool on);
+    void end_frame();
+
+    bool should_render_frame();
+    bool frame_changed();
+
+    Pixel *line_pointer(int y);
+    uint64_t hash_line(int y);
+    void find_dirty_lines();
+    void present_frame();
+    void present_scaled_frame();
+    bool update_pixel_zoom();
+
     Pixel get_pixel(int x, int y);
 
     void set_pixel(int x, int y, Pixel & pixel);
@@ -126,6 +267,15 @@ public:
      */
     GPU(Memory &);
 
+    /*
+     * Create a new GPU.
+     *
+     * @param mem: The memory from which the GPU will read from and write to.
+     * @param headless: If true, no window is created and frames are only
+     * drawn into the frame buffer.
+     */
+    GPU(Memory &, bool headless);
+
     /*
      * Reset all the pixels in the window to be white
      */
@@ -133,21 +283,119 @@ public:
 
     /*
      * @return: A pointer to the GLFW window that the Game Boy screen is being
-     * rendered to.
+     * rendered to, or nullptr if the GPU is headless.
      */
     GLFWwindow* get_window();
 
     /*
      * Updates the internal GPU state and redraws the screen if necessary.
+     * The GPU only touches LY, STAT and IF when it changes mode, which
+     * happens on the exact cycle the mode ends.
      *
      * @param cpu_cycles: The number of cpu cycles that have elapsed since the
      * screen was last rendered.
      */
     void render_screen(uint32_t cpu_cycles);
 
+    /*
+     * Sleep until the window has an event, such as a key press, and handle
+     * it. Does nothing when headless.
+     */
+    void wait_events();
+
+    /*
+     * Set the frame skipping policy.
+     *
+     * @param policy: The policy used to decide which frames are skipped.
+     * @param n: The N used by the policy. Ignored by NO_FRAME_SKIP and
+     * SKIP_ALL_FRAMES.
+     */
+    void set_frame_skip(FrameSkip policy, int n);
+
+    /*
+     * @return: The number of frames that have been emulated.
+     */
+    uint64_t get_frame_count();
+
+    /*
+     * @return: The number of frames that were not rendered.
+     */
+    uint64_t get_skipped_frames();
+
+    /*
+     * @return: The number of frames that were not redrawn because nothing
+     * that affects the screen changed since the previous frame.
+     */
+    uint64_t get_unchanged_frames();
+
+    /*
+     * @return: The number of screen lines that changed in the last frame that
+     * was drawn.
+     */
+    int get_num_dirty_lines();
+
+    /*
+     * @return: The number of lines uploaded to the screen texture so far.
+     */
+    uint64_t get_num_uploaded_lines();
+
+    /*
+     * @param y: The screen line, where 0 is the top of the screen.
+     * @return: True if the line changed in the last frame that was drawn.
+     */
+    bool is_line_dirty(int y);
+
+    /*
+     * @param y: The screen line, where 0 is the top of the screen.
+     * @return: A pointer to the SCREEN_WIDTH pixels that make up the line.
+     */
+    const Pixel* get_line(int y);
+
+    /*
+     * Send every presented frame to a frame capture. Frames that are skipped
+     * by the frame skipping policy are not captured.
+     *
+     * @param capture: The capture to send frames to, or nullptr to stop.
+     */
+    void set_capture(FrameCapture *capture);
+
+    /*
+     * Tell a latency probe when each frame is emulated and presented, and when
+     * the buttons change.
+     *
+     * @param latency: The probe, or nullptr to stop.
+     */
+    void set_latency_probe(LatencyProbe *latency);
+
+    /*
+     * Scale frames up before they are presented, and resize the window to
+     * match. Frames are scaled on a worker thread while the next frame is
+     * emulated. Has no effect when headless.
+     *
+     * @param filter: The filter used to scale frames.
+     */
+    void set_scale_filter(ScaleFilter filter);
+
+    /*
+     * Blend each frame with the frames before it, like the slow LCD of the
+     * original Game Boy. The blended frame is what is presented and captured.
+     * Frames keep being redrawn until the blend has caught up with the screen.
+     *
+     * @param persistence: How much of the previous frames remains visible,
+     * from 0 (no ghosting) to 1.
+     */
+    void set_ghosting(double persistence);
+
+    /*
+     * Wait for the display to refresh before presenting each frame. Should be
+     * turned off when something else, such as the audio, sets the speed of
+     * the emulator. Has no effect when headless.
+     */
+    void set_vsync(bool enabled);
+
     /*
      * @return: True if the window created by the GPU is still open, otherwise
-     * False.
+     * False. Always true when headless.
      */
     bool window_open();
 
@@ -157,6 +405,35 @@ public:
      * @return The 64-bit hash of the screen buffer.
      */
     uint64_t screen_hash();
+
+    /*
+     * Computes a strong hash of the screen buffer from the hashes of each
+     * line. Unlike screen_hash, this only has to hash the line hashes, which
+     * are already up to date after a frame has been drawn.
+     *
+     * @return: The 64-bit hash of the screen buffer.
+     */
+    uint64_t frame_hash();
+
+    /*
+     * @param y: The screen line, where 0 is the top of the screen.
+     * @return: The 64-bit hash of the line.
+     */
+    uint64_t line_hash(int y);
+
+    /*
+     * Add the mode, the line being drawn and the frame buffer to a save
+     * state. The number of frames emulated isn't saved.
+     */
+    void save_state(StateWriter & writer);
+
+    /*
+     * Restore the GPU from the open chunk of a save state. Memory has to be
+     * restored first, and the next frame is drawn and presented in full.
+     *
+     * @return: False if the chunk is too short.
+     */
+    bool load_state(StateReader & reader);
 };
 
 #endif
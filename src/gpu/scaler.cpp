@@ -0,0 +1,428 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "scaler.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define PADDED_WIDTH (SCREEN_WIDTH + 2)
+#define PADDED_HEIGHT (SCREEN_HEIGHT + 2)
+
+/*
+ * The vector operations that the filters are written in. A vector holds
+ * VECTOR_WIDTH pixels, and a mask has every bit of a pixel set where a
+ * comparison was true.
+ */
+#if defined(__AVX2__)
+
+#define VECTOR_WIDTH 8
+typedef __m256i Vector;
+
+static inline Vector load(const Pixel *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+static inline void store(Pixel *p, Vector v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+}
+
+static inline Vector equal(Vector a, Vector b) {
+    return _mm256_cmpeq_epi32(a, b);
+}
+
+static inline Vector either(Vector a, Vector b) {
+    return _mm256_or_si256(a, b);
+}
+
+// b where a is not set.
+static inline Vector but_not(Vector b, Vector a) {
+    return _mm256_andnot_si256(a, b);
+}
+
+static inline Vector select(Vector mask, Vector a, Vector b) {
+    return _mm256_blendv_epi8(b, a, mask);
+}
+
+static inline Vector average(Vector a, Vector b) {
+    return _mm256_avg_epu8(a, b);
+}
+
+#elif defined(__SSE2__)
+
+#define VECTOR_WIDTH 4
+typedef __m128i Vector;
+
+static inline Vector load(const Pixel *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+static inline void store(Pixel *p, Vector v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+static inline Vector equal(Vector a, Vector b) {
+    return _mm_cmpeq_epi32(a, b);
+}
+
+static inline Vector either(Vector a, Vector b) {
+    return _mm_or_si128(a, b);
+}
+
+static inline Vector but_not(Vector b, Vector a) {
+    return _mm_andnot_si128(a, b);
+}
+
+static inline Vector select(Vector mask, Vector a, Vector b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline Vector average(Vector a, Vector b) {
+    return _mm_avg_epu8(a, b);
+}
+
+#else
+
+#define VECTOR_WIDTH 1
+typedef uint32_t Vector;
+
+static inline Vector load(const Pixel *p) {
+    Vector v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store(Pixel *p, Vector v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline Vector equal(Vector a, Vector b) {
+    return a == b ? 0xFFFFFFFF : 0;
+}
+
+static inline Vector either(Vector a, Vector b) {
+    return a | b;
+}
+
+static inline Vector but_not(Vector b, Vector a) {
+    return b & ~a;
+}
+
+static inline Vector select(Vector mask, Vector a, Vector b) {
+    return (mask & a) | (~mask & b);
+}
+
+// The average of each byte, rounded up.
+static inline Vector average(Vector a, Vector b) {
+    return (a | b) - (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+#endif
+
+#if defined(__SSE2__)
+
+/*
+ * Interleave 3 vectors of 4 pixels: a0 b0 c0 a1 b1 c1 ...
+ */
+static inline void interleave3_128(__m128i a, __m128i b, __m128i c, Pixel *out) {
+    __m128 ab_low = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b)); // a0 b0 a1 b1
+    __m128 ab_high = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b)); // a2 b2 a3 b3
+    __m128 bc_low = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c)); // b0 c0 b1 c1
+    __m128 bc_high = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c)); // b2 c2 b3 c3
+    __m128 ca_low = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a)); // c0 a0 c1 a1
+    __m128 ca_high = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a)); // c2 a2 c3 a3
+
+    _mm_storeu_ps(reinterpret_cast<float *>(out), _mm_shuffle_ps(ab_low, ca_low, _MM_SHUFFLE(3, 0, 1, 0)));
+    _mm_storeu_ps(reinterpret_cast<float *>(out + 4), _mm_shuffle_ps(bc_low, ab_high, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_ps(reinterpret_cast<float *>(out + 8), _mm_shuffle_ps(ca_high, bc_high, _MM_SHUFFLE(3, 2, 3, 0)));
+}
+
+#endif
+
+/*
+ * Interleave 2 vectors: a0 b0 a1 b1 ... The first half of the result is
+ * returned in low and the second half in high.
+ */
+static inline void zip2(Vector a, Vector b, Vector & low, Vector & high) {
+#if defined(__AVX2__)
+    __m256i low_lanes = _mm256_unpacklo_epi32(a, b); // a0 b0 a1 b1 | a4 b4 a5 b5
+    __m256i high_lanes = _mm256_unpackhi_epi32(a, b); // a2 b2 a3 b3 | a6 b6 a7 b7
+    low = _mm256_permute2x128_si256(low_lanes, high_lanes, 0x20);
+    high = _mm256_permute2x128_si256(low_lanes, high_lanes, 0x31);
+#elif defined(__SSE2__)
+    low = _mm_unpacklo_epi32(a, b);
+    high = _mm_unpackhi_epi32(a, b);
+#else
+    low = a;
+    high = b;
+#endif
+}
+
+/*
+ * Write 2 vectors interleaved: a0 b0 a1 b1 ...
+ */
+static inline void interleave2(Vector a, Vector b, Pixel *out) {
+    Vector low;
+    Vector high;
+    zip2(a, b, low, high);
+    store(out, low);
+    store(out + VECTOR_WIDTH, high);
+}
+
+/*
+ * Write 3 vectors interleaved: a0 b0 c0 a1 b1 c1 ...
+ */
+static inline void interleave3(Vector a, Vector b, Vector c, Pixel *out) {
+#if defined(__AVX2__)
+    interleave3_128(_mm256_castsi256_si128(a), _mm256_castsi256_si128(b),
+                    _mm256_castsi256_si128(c), out);
+    interleave3_128(_mm256_extracti128_si256(a, 1), _mm256_extracti128_si256(b, 1),
+                    _mm256_extracti128_si256(c, 1), out + 12);
+#elif defined(__SSE2__)
+    interleave3_128(a, b, c, out);
+#else
+    store(out, a);
+    store(out + 1, b);
+    store(out + 2, c);
+#endif
+}
+
+/*
+ * Write a vector with every pixel repeated 4 times.
+ */
+static inline void repeat4(Vector e, Pixel *out) {
+    Vector low;
+    Vector high;
+    zip2(e, e, low, high);
+    interleave2(low, low, out);
+    interleave2(high, high, out + VECTOR_WIDTH * 2);
+}
+
+int scale_factor(ScaleFilter filter) {
+    switch (filter) {
+        case NO_SCALING:
+            return 1;
+
+        case NEAREST_2X:
+        case SCALE_2X:
+        case XBR_LITE_2X:
+            return 2;
+
+        case NEAREST_3X:
+        case SCALE_3X:
+            return 3;
+
+        case NEAREST_4X:
+            return 4;
+    }
+    return 1;
+}
+
+bool parse_scale_filter(const char *name, ScaleFilter & filter) {
+    const char *names[] = {"none", "nearest2x", "nearest3x", "nearest4x", "scale2x", "scale3x", "xbr"};
+    const ScaleFilter filters[] = {NO_SCALING, NEAREST_2X, NEAREST_3X, NEAREST_4X, SCALE_2X, SCALE_3X, XBR_LITE_2X};
+
+    for (int i = 0; i < 7; i++) {
+        if (!strcmp(name, names[i])) {
+            filter = filters[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+Scaler::Scaler(ScaleFilter filter) {
+    this->filter = filter;
+    factor = scale_factor(filter);
+
+    padded = new Pixel[PADDED_WIDTH * PADDED_HEIGHT];
+    output = new Pixel[NUM_PIXELS * factor * factor];
+
+    worker = nullptr;
+    pending = false;
+    stopping = false;
+}
+
+Scaler::~Scaler() {
+    if (worker != nullptr) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker->join();
+        delete worker;
+    }
+
+    delete[] padded;
+    delete[] output;
+}
+
+int Scaler::get_width() {
+    return SCREEN_WIDTH * factor;
+}
+
+int Scaler::get_height() {
+    return SCREEN_HEIGHT * factor;
+}
+
+void Scaler::pad_frame(const Pixel *frame) {
+    for (int y = 0; y < PADDED_HEIGHT; y++) {
+        // The rows above and below the frame repeat its first and last line.
+        int source_y = y == 0 ? 0 : (y == PADDED_HEIGHT - 1 ? SCREEN_HEIGHT - 1 : y - 1);
+        const Pixel *line = frame + source_y * SCREEN_WIDTH;
+        Pixel *padded_line = padded + y * PADDED_WIDTH;
+
+        memcpy(padded_line + 1, line, SCREEN_WIDTH * sizeof(Pixel));
+        padded_line[0] = line[0];
+        padded_line[PADDED_WIDTH - 1] = line[SCREEN_WIDTH - 1];
+    }
+}
+
+void Scaler::scale_padded(Pixel *out) {
+    int width = get_width();
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        // Each pixel E is filtered using its 8 neighbors:
+        //  A B C
+        //  D E F
+        //  G H I
+        const Pixel *above = padded + y * PADDED_WIDTH + 1;
+        const Pixel *line = above + PADDED_WIDTH;
+        const Pixel *below = line + PADDED_WIDTH;
+
+        Pixel *row = out + y * factor * width;
+
+        for (int x = 0; x < SCREEN_WIDTH; x += VECTOR_WIDTH) {
+            Vector e = load(line + x);
+            Pixel *o = row + x * factor;
+
+            if (filter == NEAREST_2X) {
+                interleave2(e, e, o);
+                interleave2(e, e, o + width);
+                continue;
+            }
+            if (filter == NEAREST_3X) {
+                interleave3(e, e, e, o);
+                interleave3(e, e, e, o + width);
+                interleave3(e, e, e, o + width * 2);
+                continue;
+            }
+            if (filter == NEAREST_4X) {
+                repeat4(e, o);
+                repeat4(e, o + width);
+                repeat4(e, o + width * 2);
+                repeat4(e, o + width * 3);
+                continue;
+            }
+
+            Vector b = load(above + x);
+            Vector d = load(line + x - 1);
+            Vector f = load(line + x + 1);
+            Vector h = load(below + x);
+
+            Vector b_d = equal(b, d);
+            Vector b_f = equal(b, f);
+            Vector d_h = equal(d, h);
+            Vector f_h = equal(f, h);
+
+            // The corners of E that lie on an edge between two of its
+            // neighbors.
+            Vector top_left = but_not(but_not(b_d, b_f), d_h);
+            Vector top_right = but_not(but_not(b_f, b_d), f_h);
+            Vector bottom_left = but_not(but_not(d_h, b_d), f_h);
+            Vector bottom_right = but_not(but_not(f_h, d_h), b_f);
+
+            if (filter == SCALE_2X) {
+                interleave2(select(top_left, d, e), select(top_right, f, e), o);
+                interleave2(select(bottom_left, d, e), select(bottom_right, f, e), o + width);
+            }
+            else if (filter == XBR_LITE_2X) {
+                // Rather than replacing the corner, blend it 3:1 towards the
+                // edge so that the edge is smoothed instead of stair stepped.
+                Vector d_blend = average(d, average(d, e));
+                Vector f_blend = average(f, average(f, e));
+
+                interleave2(select(top_left, d_blend, e), select(top_right, f_blend, e), o);
+                interleave2(select(bottom_left, d_blend, e), select(bottom_right, f_blend, e), o + width);
+            }
+            else if (filter == SCALE_3X) {
+                Vector e_a = equal(e, load(above + x - 1));
+                Vector e_c = equal(e, load(above + x + 1));
+                Vector e_g = equal(e, load(below + x - 1));
+                Vector e_i = equal(e, load(below + x + 1));
+
+                Vector top = either(but_not(top_left, e_c), but_not(top_right, e_a));
+                Vector left = either(but_not(top_left, e_g), but_not(bottom_left, e_a));
+                Vector right = either(but_not(top_right, e_i), but_not(bottom_right, e_c));
+                Vector bottom = either(but_not(bottom_left, e_i), but_not(bottom_right, e_g));
+
+                interleave3(select(top_left, d, e), select(top, b, e), select(top_right, f, e), o);
+                interleave3(select(left, d, e), e, select(right, f, e), o + width);
+                interleave3(select(bottom_left, d, e), select(bottom, h, e),
+                            select(bottom_right, f, e), o + width * 2);
+            }
+        }
+    }
+}
+
+void Scaler::scale(const Pixel *frame, Pixel *out) {
+    if (filter == NO_SCALING) {
+        memcpy(out, frame, NUM_PIXELS * sizeof(Pixel));
+        return;
+    }
+
+    pad_frame(frame);
+    scale_padded(out);
+}
+
+void Scaler::submit(const Pixel *frame) {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return !pending; });
+
+    if (worker == nullptr) {
+        worker = new std::thread(&Scaler::scale_frames, this);
+    }
+
+    pad_frame(frame);
+    pending = true;
+
+    guard.unlock();
+    changed.notify_all();
+}
+
+const Pixel* Scaler::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return !pending; });
+    return output;
+}
+
+void Scaler::scale_frames() {
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (true) {
+        changed.wait(guard, [this] { return stopping or pending; });
+        if (stopping) {
+            return;
+        }
+
+        guard.unlock();
+        if (filter == NO_SCALING) {
+            for (int y = 0; y < SCREEN_HEIGHT; y++) {
+                memcpy(output + y * SCREEN_WIDTH, padded + (y + 1) * PADDED_WIDTH + 1,
+                       SCREEN_WIDTH * sizeof(Pixel));
+            }
+        }
+        else {
+            scale_padded(output);
+        }
+        guard.lock();
+
+        pending = false;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_SCALER_H
+#define GAME_BOY_EMULATOR_SCALER_H
+
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "gpu.h"
+
+/*
+ * @param filter: A scale filter.
+ * @return: How many times larger the output of the filter is in each direction.
+ */
+int scale_factor(ScaleFilter filter);
+
+/*
+ * @param name: The name of a filter, such as "scale2x".
+ * @param filter: Set to the filter with that name.
+ * @return: False if there is no filter with that name.
+ */
+bool parse_scale_filter(const char *name, ScaleFilter & filter);
+
+/*
+ * Scales up frames of the Game Boy screen.
+ *
+ * The filters are written once in terms of a few vector operations, which are
+ * compiled to AVX2 or SSE2 instructions (depending on what the emulator was
+ * built for), so 8 or 4 pixels are filtered at a time. Every filter is
+ * symmetric, so frames can be stored either top or bottom line first.
+ *
+ * Frames can be scaled on the calling thread with scale, or handed to a worker
+ * thread with submit and collected later with wait, which lets the frame be
+ * scaled while the next one is emulated.
+ *
+ * Example usage:
+ *
+ *  Scaler scaler(SCALE_2X);
+ *  scaler.submit(frame);
+ *  // Emulate the next frame.
+ *  const Pixel *scaled = scaler.wait();
+ */
+class Scaler {
+
+private:
+
+    ScaleFilter filter;
+    int factor;
+
+    // The frame being scaled, with a border of 1 pixel on every side that
+    // repeats the edge of the frame.
+    Pixel *padded;
+
+    // The last frame scaled by the worker thread.
+    Pixel *output;
+
+    std::thread *worker;
+    std::mutex lock;
+    std::condition_variable changed;
+
+    // True from when a frame is submitted until the worker has scaled it.
+    bool pending;
+    bool stopping;
+
+    void pad_frame(const Pixel *frame);
+    void scale_padded(Pixel *out);
+    void scale_frames();
+
+public:
+
+    /*
+     * @param filter: The filter used to scale frames.
+     */
+    Scaler(ScaleFilter filter);
+
+    /*
+     * Stop the worker thread, if it was started.
+     */
+    ~Scaler();
+
+    /*
+     * @return: The width of a scaled frame.
+     */
+    int get_width();
+
+    /*
+     * @return: The height of a scaled frame.
+     */
+    int get_height();
+
+    /*
+     * Scale a frame on the calling thread. Must not be used while a frame
+     * submitted to the worker thread is being scaled.
+     *
+     * @param frame: The NUM_PIXELS pixels of the frame.
+     * @param out: Where to write the get_width() * get_height() scaled pixels.
+     */
+    void scale(const Pixel *frame, Pixel *out);
+
+    /*
+     * Copy a frame and scale it on the worker thread, starting the thread if
+     * needed. Waits for the previous frame to finish first.
+     *
+     * @param frame: The NUM_PIXELS pixels of the frame.
+     */
+    void submit(const Pixel *frame);
+
+    /*
+     * Wait for the last submitted frame to be scaled.
+     *
+     * @return: The scaled frame, which stays valid until the next call to
+     * submit.
+     */
+    const Pixel* wait();
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include "joypad.h"
+
+Joypad::Joypad() {
+    buttons = 0;
+    select = 0;
+    unread = 0;
+}
+
+inline uint8_t Joypad::get_lines() {
+    uint8_t lines = 0x0F;
+    if ((select & 0x10) == 0) {
+        lines &= ~buttons & 0x0F; // The direction buttons.
+    }
+    if ((select & 0x20) == 0) {
+        lines &= ~(buttons >> 4) & 0x0F; // A, B, Select and Start.
+    }
+    return lines;
+}
+
+uint8_t Joypad::load_byte() {
+    // The game has now seen the buttons on the selected lines.
+    if ((select & 0x10) == 0) {
+        unread &= 0xF0;
+    }
+    if ((select & 0x20) == 0) {
+        unread &= 0x0F;
+    }
+    return 0xC0 | select | get_lines();
+}
+
+bool Joypad::write_select(uint8_t value) {
+    uint8_t old_lines = get_lines();
+    select = value & 0x30;
+    return (old_lines & ~get_lines()) != 0;
+}
+
+bool Joypad::set_buttons(uint8_t buttons) {
+    uint8_t old_lines = get_lines();
+    unread |= this->buttons ^ buttons;
+    this->buttons = buttons;
+    return (old_lines & ~get_lines()) != 0;
+}
+
+uint8_t Joypad::get_buttons() {
+    return buttons;
+}
+
+uint8_t Joypad::get_unread() {
+    return unread;
+}
+
+bool Joypad::line_low() {
+    return get_lines() != 0x0F;
+}
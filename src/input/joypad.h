@@ -0,0 +1,89 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_JOYPAD_H
+#define GAME_BOY_EMULATOR_JOYPAD_H
+
+#include <cstdint>
+
+// The bits of each button in the button state.
+#define BUTTON_RIGHT 0
+#define BUTTON_LEFT 1
+#define BUTTON_UP 2
+#define BUTTON_DOWN 3
+#define BUTTON_A 4
+#define BUTTON_B 5
+#define BUTTON_SELECT 6
+#define BUTTON_START 7
+
+/*
+ * The buttons of the Game Boy and the P1 register they are read through.
+ *
+ * The buttons are kept as one byte, with a bit set for each button that is
+ * held down, which is only updated when the host reports a change. P1 is
+ * worked out from the buttons when it is read, using the lines the game last
+ * selected.
+ */
+class Joypad {
+
+private:
+
+    uint8_t buttons;
+
+    // Bits 4 and 5 of P1, as they were written. A line is selected when its
+    // bit is 0.
+    uint8_t select;
+
+    // The buttons that changed since the game last read their line.
+    uint8_t unread;
+
+    /*
+     * @return: The low 4 bits of P1, with a 0 for each button held down on
+     * the selected lines.
+     */
+    uint8_t get_lines();
+
+public:
+
+    Joypad();
+
+    /*
+     * @return: The value of P1.
+     */
+    uint8_t load_byte();
+
+    /*
+     * Select the lines to read the buttons from.
+     *
+     * @param value: The value written to P1.
+     * @return: True if any bit of P1 went from 1 to 0, which raises the joypad
+     * interrupt.
+     */
+    bool write_select(uint8_t value);
+
+    /*
+     * @param buttons: The new button state.
+     * @return: True if any bit of P1 went from 1 to 0.
+     */
+    bool set_buttons(uint8_t buttons);
+
+    /*
+     * @return: The button state, with a bit set for each button held down.
+     */
+    uint8_t get_buttons();
+
+    /*
+     * @return: The buttons that changed since the game last read P1 with
+     * their line selected.
+     */
+    uint8_t get_unread();
+
+    /*
+     * @return: True if a button is held down on a selected line, which wakes
+     * the CPU from STOP.
+     */
+    bool line_low();
+};
+
+#endif
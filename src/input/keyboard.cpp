@@ -5,33 +5,43 @@
 
 #include "keyboard.h"
 
+const int Keyboard::keys[NUM_BUTTONS] = {
+    GLFW_KEY_RIGHT, GLFW_KEY_LEFT, GLFW_KEY_UP, GLFW_KEY_DOWN,
+    GLFW_KEY_Z, GLFW_KEY_X, GLFW_KEY_SPACE, GLFW_KEY_ENTER
+};
+
 Keyboard::Keyboard(GPU &gpu, Memory &memory) : memory(memory) {
     window = gpu.get_window();
-}
+    if (window == nullptr) {
+        return; // Headless, there are no keys to read.
+    }
 
-void Keyboard::process_key_events() {
-    uint8_t joyp = memory.load_byte(P1);
-    uint8_t interrupt_flag = memory.load_byte(IF);
+    glfwSetWindowUserPointer(window, &memory);
+    glfwSetKeyCallback(window, key_event);
+}
 
-    for (int i = 0; i < COLUMNS; i++) {
-        if (get_bit(joyp, i + ROWS) == 0) {
+void Keyboard::key_event(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_REPEAT) {
+        return;
+    }
 
-            for (int j = 0; j < ROWS; j++) {
-                // If the key has been pressed, reset the appropriate bit.
+    Memory *memory = static_cast<Memory *>(glfwGetWindowUserPointer(window));
+    uint8_t buttons = memory->get_buttons();
 
-                if (glfwGetKey(window, keys[i][j]) == GLFW_PRESS) {
-                    reset_bit(joyp, j);
-                    set_bit(interrupt_flag, 4);
-                }
-                else {
-                    set_bit(joyp, j);
-                }
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        if (keys[i] == key) {
+            if (action == GLFW_PRESS) {
+                set_bit(buttons, i);
+            }
+            else {
+                reset_bit(buttons, i);
             }
-
         }
     }
 
-    memory.store_byte(P1, joyp);
-    memory.store_byte(IF, interrupt_flag);
+    memory->set_buttons(buttons);
 }
 
+bool Keyboard::rewind_held() {
+    return window != nullptr and glfwGetKey(window, REWIND_KEY) == GLFW_PRESS;
+}
@@ -11,43 +11,47 @@
 #include "../memory/memory.h"
 #include "../gpu/gpu.h"
 
-#define ROWS 4
-#define COLUMNS 2
+#define NUM_BUTTONS 8
+
+// The key held down to rewind the game.
+#define REWIND_KEY GLFW_KEY_BACKSPACE
 
 /*
  * Provides a method for reading input from the keyboard.
+ *
+ * Keys are read as GLFW reports them, which happens when the GPU polls for
+ * window events once a frame. Each change is passed straight on to the
+ * joypad, so nothing is done per instruction.
  */
 class Keyboard {
 
 private:
-    // Key mappings.
-    const int UP = GLFW_KEY_UP;
-    const int DOWN = GLFW_KEY_DOWN;
-    const int LEFT = GLFW_KEY_LEFT;
-    const int RIGHT = GLFW_KEY_RIGHT;
-    const int START = GLFW_KEY_ENTER;
-    const int SELECT = GLFW_KEY_SPACE;
-    const int A = GLFW_KEY_Z;
-    const int B = GLFW_KEY_X;
-
-    const int keys[COLUMNS][ROWS]= {{RIGHT, LEFT, UP, DOWN},
-                                    {A, B, SELECT, START}};
+
+    // The key mapped to each button, in the order of the button bits.
+    static const int keys[NUM_BUTTONS];
 
     Memory & memory;
 
     GLFWwindow *window;
 
+    /*
+     * Called by GLFW when a key is pressed or released.
+     */
+    static void key_event(GLFWwindow *window, int key, int scancode, int action, int mods);
+
 public:
 
+    /*
+     * Start passing key presses in the window of the GPU to memory. Does
+     * nothing when headless.
+     */
     Keyboard(GPU & gpu, Memory & memory);
 
     /*
-     * Check if any of the mapped keys are being pressed and set the
-     * appropriate bits of the P1 register to 0. Also triggers a joypad
-     * interrupt by setting the 4th bit of the interrupt flag to 1 if any of
-     * the mapped keys are being pressed.
+     * @return: True if the rewind key was held down when the window was last
+     * polled. Always false when headless.
      */
-    void process_key_events();
+    bool rewind_held();
 };
 
 #endif
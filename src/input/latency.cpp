@@ -0,0 +1,142 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "latency.h"
+
+#define HISTOGRAM_BAR_WIDTH 40
+
+double latency_clock() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(now).count();
+}
+
+/*
+ * Print the median, 95th percentile and maximum of some values, followed by a
+ * histogram of them.
+ *
+ * @param title: What the values are.
+ * @param values: The values.
+ * @param bucket: The width of each bar of the histogram.
+ * @param num_buckets: The number of bars. The last bar holds every value
+ * above the others.
+ * @param unit: The unit of the values.
+ */
+static void print_histogram(std::ostream & out, const char *title, std::vector<double> values,
+                            double bucket, int num_buckets, const char *unit) {
+    out << title;
+    if (values.empty()) {
+        out << ": no samples" << std::endl;
+        return;
+    }
+
+    std::sort(values.begin(), values.end());
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << ": median " << values[values.size() / 2] << " " << unit;
+    out << ", 95th percentile " << values[(values.size() * 95) / 100] << " " << unit;
+    out << ", max " << values.back() << " " << unit << std::endl;
+
+    std::vector<int> counts(num_buckets, 0);
+    for (double value : values) {
+        int i = static_cast<int>(value / bucket);
+        counts[std::min(std::max(i, 0), num_buckets - 1)] += 1;
+    }
+    int max_count = *std::max_element(counts.begin(), counts.end());
+
+    for (int i = 0; i < num_buckets; i++) {
+        out << std::setprecision(0) << std::setw(8) << i * bucket << (i == num_buckets - 1 ? "+ " : "  ");
+        out << std::setw(6) << counts[i] << " ";
+        out << std::string((counts[i] * HISTOGRAM_BAR_WIDTH + max_count - 1) / max_count, '#');
+        out << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+LatencyProbe::LatencyProbe(Memory & memory) : memory(memory) {
+    last_buttons = memory.get_buttons();
+    dropped = 0;
+}
+
+void LatencyProbe::buttons_polled(uint64_t frame, double time) {
+    uint8_t buttons = memory.get_buttons();
+    if (buttons == last_buttons) {
+        return;
+    }
+    last_buttons = buttons;
+
+    LatencySample sample = {};
+    sample.input_frame = frame;
+    sample.event_time = time;
+    pending.push_back(sample);
+}
+
+void LatencyProbe::frame_emulated(uint64_t frame, bool changed, double time) {
+    // The joypad can only say that every change was read, so a change is read
+    // once every change after it has been read too.
+    bool read = memory.get_joypad().get_unread() == 0;
+
+    for (LatencySample & sample : pending) {
+        if (!sample.read) {
+            if (!read) {
+                continue;
+            }
+            sample.read = true;
+            sample.read_frame = frame;
+        }
+        if (!sample.changed and changed) {
+            sample.changed = true;
+            sample.output_frame = frame;
+            sample.output_time = time;
+        }
+    }
+
+    while (!pending.empty() and !pending.front().changed and
+           frame - pending.front().input_frame >= LATENCY_TIMEOUT_FRAMES) {
+        pending.pop_front();
+        dropped += 1;
+    }
+}
+
+void LatencyProbe::frame_presented(uint64_t frame, double time) {
+    while (!pending.empty() and pending.front().changed and pending.front().output_frame <= frame) {
+        pending.front().present_time = time;
+        samples.push_back(pending.front());
+        pending.pop_front();
+    }
+}
+
+const std::vector<LatencySample> & LatencyProbe::get_samples() {
+    return samples;
+}
+
+uint64_t LatencyProbe::get_dropped() {
+    return dropped;
+}
+
+void LatencyProbe::report(std::ostream & out) {
+    std::vector<double> read_frames, response_frames;
+    std::vector<double> emulation_ms, presentation_ms, total_ms;
+
+    for (const LatencySample & sample : samples) {
+        read_frames.push_back(sample.read_frame - sample.input_frame);
+        response_frames.push_back(sample.output_frame - sample.read_frame);
+        emulation_ms.push_back((sample.output_time - sample.event_time) * 1000);
+        presentation_ms.push_back((sample.present_time - sample.output_time) * 1000);
+        total_ms.push_back((sample.present_time - sample.event_time) * 1000);
+    }
+
+    out << "Latency: " << samples.size() << " button changes, ";
+    out << dropped << " with no response" << std::endl;
+    print_histogram(out, "Game, until P1 is read", read_frames, 1, 8, "frames");
+    print_histogram(out, "Game, until the screen changes", response_frames, 1, 8, "frames");
+    print_histogram(out, "Emulation, key event to changed frame", emulation_ms, 8, 12, "ms");
+    print_histogram(out, "Presentation, changed frame to swap", presentation_ms, 2, 12, "ms");
+    print_histogram(out, "Total, key event to swap", total_ms, 8, 12, "ms");
+}
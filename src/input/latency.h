@@ -0,0 +1,136 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Measures how long it takes for a button press to show up on the screen.
+ *
+ * Each change of buttons is followed through four points:
+ *
+ *  1. The host reports the key event, which happens when the window is
+ *     polled at the end of a frame.
+ *  2. The game reads P1 with the changed button's line selected.
+ *  3. A frame that looks different from the one before it is emulated.
+ *  4. That frame is presented, once glfwSwapBuffers returns.
+ *
+ * The time between 1 and 3 is split into the frames the game took to read the
+ * buttons and to respond to them, which are up to the game, and the host time
+ * it took to emulate those frames. The time between 3 and 4 is spent
+ * presenting the frame, including waiting for vsync. When headless, frames
+ * are never presented, so a frame counts as presented when it is emulated.
+ *
+ * A change that the game hasn't responded to within LATENCY_TIMEOUT_FRAMES
+ * is dropped, as not every button press changes the screen.
+ */
+
+#ifndef GAME_BOY_EMULATOR_LATENCY_H
+#define GAME_BOY_EMULATOR_LATENCY_H
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <vector>
+
+#include "../memory/memory.h"
+
+#define LATENCY_TIMEOUT_FRAMES 120
+
+/*
+ * @return: The time of the host's steady clock in seconds.
+ */
+double latency_clock();
+
+/*
+ * The points that a change of buttons passed through.
+ */
+struct LatencySample {
+    // The first frame emulated with the new buttons.
+    uint64_t input_frame;
+
+    // The first frame in which the game read the new buttons.
+    uint64_t read_frame;
+
+    // The first frame after that which looked different.
+    uint64_t output_frame;
+
+    // The host time of the key event, the end of the output frame, and when
+    // the output frame was presented, in seconds.
+    double event_time;
+    double output_time;
+    double present_time;
+
+    bool read;
+    bool changed;
+};
+
+/*
+ * Follows changes of buttons until they are presented, and reports how long
+ * each part took. The GPU calls the probe at the end of every frame.
+ *
+ * Example usage:
+ *
+ *  LatencyProbe latency(memory);
+ *  gpu.set_latency_probe(&latency);
+ *  ... // Run the emulator.
+ *  latency.report(cout);
+ */
+class LatencyProbe {
+
+private:
+
+    Memory & memory;
+
+    uint8_t last_buttons;
+
+    // Changes that haven't been presented yet, oldest first.
+    std::deque<LatencySample> pending;
+
+    std::vector<LatencySample> samples;
+    uint64_t dropped;
+
+public:
+
+    LatencyProbe(Memory & memory);
+
+    /*
+     * Check for a change of buttons after the window was polled.
+     *
+     * @param frame: The next frame to be emulated.
+     * @param time: The host time.
+     */
+    void buttons_polled(uint64_t frame, double time);
+
+    /*
+     * Called when a frame has been emulated, and drawn unless it was skipped.
+     *
+     * @param frame: The frame.
+     * @param changed: True if the frame looks different from the one before it.
+     * @param time: The host time when the frame was emulated.
+     */
+    void frame_emulated(uint64_t frame, bool changed, double time);
+
+    /*
+     * Called when a frame has been presented.
+     *
+     * @param frame: The frame.
+     * @param time: The host time when it was presented.
+     */
+    void frame_presented(uint64_t frame, double time);
+
+    /*
+     * @return: The changes of buttons that were followed to the screen.
+     */
+    const std::vector<LatencySample> & get_samples();
+
+    /*
+     * @return: The number of changes of buttons that the game didn't respond to.
+     */
+    uint64_t get_dropped();
+
+    /*
+     * Print a histogram of each part of the latency.
+     *
+     * @param out: The stream to print to.
+     */
+    void report(std::ostream & out);
+};
+
+#endif
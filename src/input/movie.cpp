@@ -0,0 +1,186 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include "movie.h"
+
+static const char movie_magic[8] = {'G', 'B', 'M', 'O', 'V', 'I', 'E', 0};
+
+static void put_le(uint8_t *out, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        out[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+static uint64_t get_le(const uint8_t *data, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+    return value;
+}
+
+MovieWriter::MovieWriter(const char *path, uint64_t rom_hash, uint64_t start_state) {
+    num_frames = 0;
+    last_frame = 0;
+    last_buttons = 0;
+
+    file = fopen(path, "wb");
+    if (file == nullptr) {
+        return;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE] = {0};
+    for (int i = 0; i < 8; i++) {
+        header[i] = static_cast<uint8_t>(movie_magic[i]);
+    }
+    put_le(header + 8, MOVIE_VERSION, 4);
+    put_le(header + 12, rom_hash, 8);
+    put_le(header + 20, start_state, 8);
+    put_le(header + 28, 0, 8); // Filled in by finish.
+    fwrite(header, 1, MOVIE_HEADER_SIZE, file);
+}
+
+MovieWriter::~MovieWriter() {
+    finish();
+}
+
+bool MovieWriter::is_open() {
+    return file != nullptr;
+}
+
+void MovieWriter::record(uint64_t frame, uint8_t buttons) {
+    if (frame > num_frames) {
+        num_frames = frame;
+    }
+    if (file == nullptr or buttons == last_buttons) {
+        return;
+    }
+
+    uint8_t record[11];
+    int size = 0;
+    uint64_t delta = frame - last_frame;
+    do {
+        uint8_t byte = delta & 0x7F;
+        delta >>= 7;
+        record[size++] = delta != 0 ? (byte | 0x80) : byte;
+    } while (delta != 0);
+    record[size++] = buttons;
+    fwrite(record, 1, size, file);
+
+    last_frame = frame;
+    last_buttons = buttons;
+}
+
+void MovieWriter::finish() {
+    if (file == nullptr) {
+        return;
+    }
+
+    uint8_t frames[8];
+    put_le(frames, num_frames, 8);
+    fseek(file, 28, SEEK_SET);
+    fwrite(frames, 1, 8, file);
+
+    fclose(file);
+    file = nullptr;
+}
+
+uint64_t MovieWriter::get_num_frames() {
+    return num_frames;
+}
+
+MovieReader::MovieReader(const char *path) {
+    rom_hash = 0;
+    start_state = MOVIE_POWER_ON;
+    num_frames = 0;
+    position = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        valid = false;
+        return;
+    }
+    valid = read(file);
+    fclose(file);
+}
+
+bool MovieReader::read(FILE *file) {
+    uint8_t header[MOVIE_HEADER_SIZE];
+    if (fread(header, 1, MOVIE_HEADER_SIZE, file) != MOVIE_HEADER_SIZE) {
+        return false;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (header[i] != static_cast<uint8_t>(movie_magic[i])) {
+            return false;
+        }
+    }
+    if (get_le(header + 8, 4) != MOVIE_VERSION) {
+        return false;
+    }
+    rom_hash = get_le(header + 12, 8);
+    start_state = get_le(header + 20, 8);
+    num_frames = get_le(header + 28, 8);
+
+    uint64_t frame = 0;
+    while (true) {
+        uint64_t delta = 0;
+        int shift = 0;
+        int byte;
+        do {
+            byte = fgetc(file);
+            if (byte == EOF) {
+                break;
+            }
+            if (shift > 63) {
+                return false;
+            }
+            delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        int buttons = byte == EOF ? EOF : fgetc(file);
+        if (buttons == EOF) {
+            break;
+        }
+        frame += delta;
+        inputs.push_back({frame, static_cast<uint8_t>(buttons)});
+    }
+
+    // A movie that was cut short is played up to its last full record.
+    if (num_frames == 0 and !inputs.empty()) {
+        num_frames = inputs.back().frame;
+    }
+    return true;
+}
+
+bool MovieReader::is_open() {
+    return valid;
+}
+
+uint64_t MovieReader::get_rom_hash() {
+    return rom_hash;
+}
+
+uint64_t MovieReader::get_start_state() {
+    return start_state;
+}
+
+uint64_t MovieReader::get_num_frames() {
+    return num_frames;
+}
+
+size_t MovieReader::get_num_inputs() {
+    return inputs.size();
+}
+
+uint8_t MovieReader::get_buttons(uint64_t frame) {
+    // Go back to the start if the frame is before the last one looked up.
+    if (position > 0 and inputs[position - 1].frame > frame) {
+        position = 0;
+    }
+    while (position < inputs.size() and inputs[position].frame <= frame) {
+        position++;
+    }
+    return position == 0 ? 0 : inputs[position - 1].buttons;
+}
@@ -0,0 +1,184 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * A compact record of the buttons held down during each frame, which can be
+ * played back to repeat a run of a game exactly.
+ *
+ * Buttons only change between frames: the window is polled for key events
+ * once the GPU has finished a frame, and a movie sets the buttons at the same
+ * point when it is played back. As the emulator is otherwise deterministic,
+ * the same movie always produces the same frames.
+ *
+ * A movie starts with a header:
+ *
+ *  8 bytes  "GBMOVIE\0"
+ *  4 bytes  Version (MOVIE_VERSION)
+ *  8 bytes  The ROM hash, to check the movie is played on the same game.
+ *  8 bytes  The state the movie starts from: MOVIE_POWER_ON, or the hash of
+ *           the save state file it was recorded from.
+ *  8 bytes  The number of frames played, or 0 if the movie was cut short.
+ *
+ * and is followed by a record for each frame where the buttons changed:
+ *
+ *  N bytes  The number of frames since the last record, as a LEB128 varint.
+ *  1 byte   The button state, with the bits of the joypad.
+ *
+ * The buttons start with nothing held down, so a movie that never presses a
+ * button has no records at all.
+ *
+ * All numbers are little endian.
+ */
+
+#ifndef GAME_BOY_EMULATOR_MOVIE_H
+#define GAME_BOY_EMULATOR_MOVIE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 36
+
+// The start state of a movie recorded from power on. Any other value is the
+// hash64 of the save state file that the movie was recorded from.
+#define MOVIE_POWER_ON 0
+
+/*
+ * A change of buttons in a movie.
+ */
+struct MovieInput {
+    uint64_t frame;
+    uint8_t buttons;
+};
+
+/*
+ * Writes the buttons of each frame to a movie.
+ *
+ * Example usage:
+ *
+ *  MovieWriter movie("run.gbmovie", cartridge.rom_hash(), MOVIE_POWER_ON);
+ *  movie.record(gpu.get_frame_count(), memory.get_buttons()); // Every frame.
+ *  movie.finish();
+ */
+class MovieWriter {
+
+private:
+
+    FILE *file;
+
+    uint64_t num_frames;
+
+    // The frame and buttons of the last record written.
+    uint64_t last_frame;
+    uint8_t last_buttons;
+
+public:
+
+    /*
+     * Create a movie and write its header.
+     *
+     * @param path: The file to write to.
+     * @param rom_hash: The hash of the ROM being played.
+     * @param start_state: The state the emulator starts from.
+     */
+    MovieWriter(const char *path, uint64_t rom_hash, uint64_t start_state);
+
+    ~MovieWriter();
+
+    /*
+     * @return: True if the movie file was created.
+     */
+    bool is_open();
+
+    /*
+     * Record the buttons held down during a frame. Only writes to the file
+     * when the buttons change.
+     *
+     * @param frame: The frame, which can not be before the last one recorded.
+     * @param buttons: The button state from the start of the frame.
+     */
+    void record(uint64_t frame, uint8_t buttons);
+
+    /*
+     * Write the number of frames into the header and close the file.
+     */
+    void finish();
+
+    /*
+     * @return: The number of frames played so far, which is the last frame
+     * recorded.
+     */
+    uint64_t get_num_frames();
+};
+
+/*
+ * Reads a movie into memory, to look up the buttons of each frame.
+ *
+ * Example usage:
+ *
+ *  MovieReader movie("run.gbmovie");
+ *  memory.set_buttons(movie.get_buttons(gpu.get_frame_count())); // Every frame.
+ */
+class MovieReader {
+
+private:
+
+    bool valid;
+
+    uint64_t rom_hash;
+    uint64_t start_state;
+    uint64_t num_frames;
+
+    std::vector<MovieInput> inputs;
+
+    // The input returned by the last call to get_buttons.
+    size_t position;
+
+    bool read(FILE *file);
+
+public:
+
+    /*
+     * Read a movie.
+     *
+     * @param path: The movie to read.
+     */
+    MovieReader(const char *path);
+
+    /*
+     * @return: True if the movie was read and its header is valid.
+     */
+    bool is_open();
+
+    /*
+     * @return: The hash of the ROM the movie was recorded on.
+     */
+    uint64_t get_rom_hash();
+
+    /*
+     * @return: The state the movie starts from.
+     */
+    uint64_t get_start_state();
+
+    /*
+     * @return: The number of frames played while recording the movie. If the
+     * movie was cut short, this is the frame of the last change of buttons.
+     */
+    uint64_t get_num_frames();
+
+    /*
+     * @return: The number of times the buttons change.
+     */
+    size_t get_num_inputs();
+
+    /*
+     * Look up the buttons held down during a frame. This is fastest when the
+     * frames are looked up in order.
+     *
+     * @param frame: The frame.
+     * @return: The button state from the start of the frame.
+     */
+    uint8_t get_buttons(uint64_t frame);
+};
+
+#endif
@@ -1,37 +1,536 @@
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
 #include <GLFW/glfw3.h>
 
 #include "../cpu/cpu.h"
 #include "../gpu/gpu.h"
+#include "../gpu/scaler.h"
 #include "../input/keyboard.h"
+#include "../capture/frame_capture.h"
+#include "../apu/audio_output.h"
+#include "../capture/wav_writer.h"
+#include "../input/movie.h"
+#include "../input/latency.h"
+#include "../state/save_state.h"
+#include "../state/rewind.h"
+#include "../util/hash.h"
 
 using namespace std;
 
+/*
+ * Settings that can be changed from the command line.
+ */
+struct Options {
+    const char *rom_path = nullptr;
+
+    FrameSkip frame_skip = NO_FRAME_SKIP;
+    int frame_skip_n = 1;
+
+    bool headless = false;
+    uint64_t max_frames = 0;
+
+    ScaleFilter scale_filter = NO_SCALING;
+    double ghosting = 0;
+
+    const char *capture_path = nullptr;
+    CaptureFormat capture_format = RAW_RGBA_CAPTURE;
+    int capture_interval = 1;
+
+    const char *link_rom_path = nullptr;
+
+    const char *audio_path = nullptr;
+    const char *wav_path = nullptr;
+    bool wav_stems = false;
+
+    const char *record_movie_path = nullptr;
+    const char *play_movie_path = nullptr;
+
+    bool latency = false;
+
+    const char *load_state_path = nullptr;
+    const char *save_state_path = nullptr;
+
+    int rewind_seconds = 0;
+    int rewind_interval = 1;
+
+    const char *convert_path = nullptr;
+    const char *convert_output = nullptr;
+    uint64_t convert_frame = 0;
+};
+
+void print_usage(const char *program) {
+    cerr << "Usage: " << program << " [options] <rom>" << endl;
+    cerr << "  --skip-frames N     Skip 1 of every N frames." << endl;
+    cerr << "  --render-every N    Only render 1 of every N frames." << endl;
+    cerr << "  --adaptive-skip N   Skip up to N frames in a row when running slow." << endl;
+    cerr << "  --no-render         Never render a frame." << endl;
+    cerr << "  --headless          Run without a window." << endl;
+    cerr << "  --frames N          Stop after N frames." << endl;
+    cerr << "  --scale FILTER      Scale the screen with nearest2x, nearest3x, nearest4x," << endl;
+    cerr << "                      scale2x, scale3x or xbr. Also scales captured frames." << endl;
+    cerr << "  --ghosting P        Blend frames like the original LCD, keeping P (0 to 1)" << endl;
+    cerr << "                      of the previous frames. Also applies to captured frames." << endl;
+    cerr << "  --capture FILE      Write frames to FILE (.y4m, .gbrec, or raw RGBA otherwise)." << endl;
+    cerr << "                      Use |COMMAND to pipe frames to a command." << endl;
+    cerr << "  --capture-every N   Only capture 1 of every N frames." << endl;
+    cerr << "  --link ROM          Connect a second emulator running ROM with a link cable." << endl;
+    cerr << "                      The second emulator runs headless on its own thread." << endl;
+    cerr << "  --audio FILE        Play audio in real time, as raw 16 bit stereo samples at" << endl;
+    cerr << "                      48 kHz, to FILE or to |COMMAND." << endl;
+    cerr << "  --wav FILE          Write the audio to a WAV file, as fast as it is made." << endl;
+    cerr << "  --wav-stems         Also write each sound channel to a WAV file of its own." << endl;
+    cerr << "  --record-movie FILE Record the buttons pressed in each frame to FILE." << endl;
+    cerr << "  --play-movie FILE   Play back a movie, headless and as fast as possible. Prints" << endl;
+    cerr << "                      a hash of the sequence of screen hashes when it ends." << endl;
+    cerr << "  --latency           Measure how long button presses take to reach the screen," << endl;
+    cerr << "                      and print histograms of the latency at the end." << endl;
+    cerr << "  --load-state FILE   Start from a state saved with --save-state. Movies are" << endl;
+    cerr << "                      recorded from, and can only be played from, this state." << endl;
+    cerr << "  --save-state FILE   Save the state of the emulator to FILE when it exits." << endl;
+    cerr << "  --rewind N          Keep the last N seconds, and play them backwards while" << endl;
+    cerr << "                      Backspace is held down." << endl;
+    cerr << "  --rewind-every K    With --rewind, only keep 1 of every K frames." << endl;
+    cerr << "Usage: " << program << " --convert <recording> <output> [--convert-frame N]" << endl;
+    cerr << "  Convert a .gbrec recording to a .y4m video, or to PNG images. Use a" << endl;
+    cerr << "  pattern such as frame_%05d.png to write every frame, or a plain .png" << endl;
+    cerr << "  name to write only frame N (0 by default)." << endl;
+}
+
+bool ends_with(const char *s, const char *suffix) {
+    size_t length = strlen(s);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length and !strcmp(s + length - suffix_length, suffix);
+}
+
+/*
+ * Parse the command line arguments.
+ *
+ * @return: False if the arguments are invalid.
+ */
+bool parse_options(int argc, char **argv, Options & options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (!strcmp(arg, "--skip-frames") and has_value) {
+            options.frame_skip = SKIP_ONE_IN_N;
+            options.frame_skip_n = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--render-every") and has_value) {
+            options.frame_skip = RENDER_ONE_IN_N;
+            options.frame_skip_n = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--adaptive-skip") and has_value) {
+            options.frame_skip = ADAPTIVE_FRAME_SKIP;
+            options.frame_skip_n = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--no-render")) {
+            options.frame_skip = SKIP_ALL_FRAMES;
+        }
+        else if (!strcmp(arg, "--headless")) {
+            options.headless = true;
+        }
+        else if (!strcmp(arg, "--frames") and has_value) {
+            options.max_frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(arg, "--scale") and has_value) {
+            if (!parse_scale_filter(argv[++i], options.scale_filter)) {
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--ghosting") and has_value) {
+            options.ghosting = atof(argv[++i]);
+        }
+        else if (!strcmp(arg, "--capture") and has_value) {
+            options.capture_path = argv[++i];
+            if (ends_with(options.capture_path, ".y4m")) {
+                options.capture_format = Y4M_CAPTURE;
+            }
+            else if (ends_with(options.capture_path, ".gbrec")) {
+                options.capture_format = RECORDING_CAPTURE;
+            }
+            else {
+                options.capture_format = RAW_RGBA_CAPTURE;
+            }
+        }
+        else if (!strcmp(arg, "--capture-every") and has_value) {
+            options.capture_interval = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--link") and has_value) {
+            options.link_rom_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--audio") and has_value) {
+            options.audio_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--wav") and has_value) {
+            options.wav_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--wav-stems")) {
+            options.wav_stems = true;
+        }
+        else if (!strcmp(arg, "--record-movie") and has_value) {
+            options.record_movie_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--play-movie") and has_value) {
+            options.play_movie_path = argv[++i];
+            options.headless = true;
+        }
+        else if (!strcmp(arg, "--latency")) {
+            options.latency = true;
+        }
+        else if (!strcmp(arg, "--load-state") and has_value) {
+            options.load_state_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--save-state") and has_value) {
+            options.save_state_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--rewind") and has_value) {
+            options.rewind_seconds = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--rewind-every") and has_value) {
+            options.rewind_interval = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--convert") and i + 2 < argc) {
+            options.convert_path = argv[++i];
+            options.convert_output = argv[++i];
+        }
+        else if (!strcmp(arg, "--convert-frame") and has_value) {
+            options.convert_frame = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg[0] == '-' or options.rom_path != nullptr) {
+            return false;
+        }
+        else {
+            options.rom_path = arg;
+        }
+    }
+    if (options.audio_path != nullptr and options.wav_path != nullptr) {
+        return false; // The audio can only go to one place.
+    }
+    bool movie = options.record_movie_path != nullptr or options.play_movie_path != nullptr;
+    if (movie and options.link_rom_path != nullptr) {
+        return false; // The linked emulator runs on its own thread, so can't be replayed.
+    }
+    bool state = options.load_state_path != nullptr or options.save_state_path != nullptr;
+    if ((state or options.rewind_seconds > 0) and options.link_rom_path != nullptr) {
+        return false; // Nor can its half of a transfer be saved.
+    }
+    if (movie and options.rewind_seconds > 0) {
+        return false; // Rewinding would leave frames out of the movie.
+    }
+    return options.rom_path != nullptr or options.convert_path != nullptr;
+}
+
+/*
+ * A second emulator, plugged into the first with a link cable, that runs
+ * headless on its own thread.
+ */
+struct LinkedEmulator {
+    Cartridge cartridge;
+    Memory memory;
+    CPU cpu;
+    GPU gpu;
+
+    LinkCable cable;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    LinkedEmulator(uint8_t *rom) : cartridge(rom), memory(cartridge), cpu(memory), gpu(memory, true) {
+        stopping = false;
+    }
+
+    /*
+     * Connect the cable to both emulators and start running this one.
+     */
+    void start(Memory & other) {
+        other.get_serial().connect(cable.get_endpoint(0));
+        memory.get_serial().connect(cable.get_endpoint(1));
+
+        thread = std::thread([this]() {
+            while (!stopping) {
+                uint32_t cycles = cpu.execute_next_instr();
+                cpu.handle_interrupts();
+                gpu.render_screen(cycles);
+            }
+            memory.get_serial().disconnect();
+        });
+    }
+
+    /*
+     * Unplug the cable from the other emulator and wait for this one to stop.
+     */
+    void stop(Memory & other) {
+        stopping = true;
+        other.get_serial().disconnect();
+        thread.join();
+    }
+};
+
 int main(int argc, char **argv) {
     // Parse arguments
-    ifstream rom_file = ifstream(argv[1]);
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (options.convert_path != nullptr) {
+        if (!convert_recording(options.convert_path, options.convert_output, options.convert_frame)) {
+            cerr << "Could not convert " << options.convert_path << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    ifstream rom_file = ifstream(options.rom_path);
 
     Cartridge cartridge = Cartridge(read_file(rom_file));
     Memory memory = Memory(cartridge);
     CPU cpu = CPU(memory);
-    GPU gpu = GPU(memory);
+    GPU gpu = GPU(memory, options.headless);
     Keyboard keyboard = Keyboard(gpu, memory);
 
+    // The hash of the state the emulator started from, which movies record.
+    uint64_t start_state = MOVIE_POWER_ON;
+    if (options.load_state_path != nullptr) {
+        vector<uint8_t> data;
+        if (!read_state_file(options.load_state_path, data)) {
+            cerr << "Could not read " << options.load_state_path << endl;
+            return 1;
+        }
+        StateReader reader(data.data(), data.size());
+        LoadResult result = load_state(reader, cpu, gpu, memory);
+        if (result != STATE_LOADED) {
+            cerr << load_result_message(result) << endl;
+            return 1;
+        }
+        start_state = hash64(data.data(), data.size());
+    }
+
+    gpu.set_frame_skip(options.frame_skip, options.frame_skip_n);
+    gpu.set_scale_filter(options.scale_filter);
+    gpu.set_ghosting(options.ghosting);
+
+    FrameCapture *capture = nullptr;
+    if (options.capture_path != nullptr) {
+        capture = new FrameCapture(options.capture_path, options.capture_format,
+                                   options.capture_interval, options.scale_filter);
+        if (!capture->is_open()) {
+            cerr << "Could not open " << options.capture_path << endl;
+            return 1;
+        }
+        gpu.set_capture(capture);
+    }
+
+    LinkedEmulator *linked = nullptr;
+    if (options.link_rom_path != nullptr) {
+        ifstream link_rom_file = ifstream(options.link_rom_path);
+        linked = new LinkedEmulator(read_file(link_rom_file));
+        linked->start(memory);
+    }
+
+    AudioOutput *audio = nullptr;
+    if (options.audio_path != nullptr) {
+        audio = new AudioOutput(options.audio_path);
+        if (!audio->is_open()) {
+            cerr << "Could not open " << options.audio_path << endl;
+            return 1;
+        }
+
+        // The emulator keeps pace with the audio instead of the display.
+        memory.get_apu().set_sink(audio);
+        gpu.set_vsync(false);
+    }
+
+    WavWriter *wav = nullptr;
+    if (options.wav_path != nullptr) {
+        wav = new WavWriter(options.wav_path, options.wav_stems);
+        if (!wav->is_open()) {
+            cerr << "Could not open " << options.wav_path << endl;
+            return 1;
+        }
+        memory.get_apu().set_sink(wav);
+    }
+
+    LatencyProbe *latency = nullptr;
+    if (options.latency) {
+        latency = new LatencyProbe(memory);
+        gpu.set_latency_probe(latency);
+    }
+
+    RewindBuffer *rewind = nullptr;
+    if (options.rewind_seconds > 0) {
+        rewind = new RewindBuffer(cpu, gpu, memory, options.rewind_seconds, options.rewind_interval);
+    }
+
+    bool movie = options.record_movie_path != nullptr or options.play_movie_path != nullptr;
+
+    MovieReader *movie_reader = nullptr;
+    if (options.play_movie_path != nullptr) {
+        movie_reader = new MovieReader(options.play_movie_path);
+        if (!movie_reader->is_open()) {
+            cerr << "Could not read " << options.play_movie_path << endl;
+            return 1;
+        }
+        if (movie_reader->get_rom_hash() != cartridge.rom_hash()) {
+            cerr << "The movie was recorded on a different ROM" << endl;
+            return 1;
+        }
+        if (movie_reader->get_start_state() != start_state) {
+            cerr << "The movie starts from a different state, see --load-state" << endl;
+            return 1;
+        }
+        if (options.max_frames == 0) {
+            options.max_frames = movie_reader->get_num_frames();
+        }
+        memory.set_buttons(movie_reader->get_buttons(0));
+    }
+
+    MovieWriter *movie_writer = nullptr;
+    if (options.record_movie_path != nullptr) {
+        movie_writer = new MovieWriter(options.record_movie_path, cartridge.rom_hash(), start_state);
+        if (!movie_writer->is_open()) {
+            cerr << "Could not open " << options.record_movie_path << endl;
+            return 1;
+        }
+        movie_writer->record(0, memory.get_buttons());
+    }
+
     // The number of cycles executed by the CPU.
     uint32_t cycles = 0;
 
+    // The frame that the buttons were last recorded or played for, and the
+    // hash of the screen in every frame up to it.
+    uint64_t movie_frame = 0;
+    uint64_t movie_hash = 0;
+
+    // The frame that the emulator last slept at while the CPU was stopped.
+    uint64_t stopped_frame = 0;
+
+    // The frame that a snapshot was last taken or restored at.
+    uint64_t rewind_frame = 0;
+
     // Emulator continues to run until the window is closed
     while (gpu.window_open()) {
+        if (options.max_frames > 0 and gpu.get_frame_count() >= options.max_frames) {
+            break;
+        }
+
         cycles = cpu.execute_next_instr();
         cpu.handle_interrupts();
         gpu.render_screen(cycles);
 
-        keyboard.process_key_events();
+        // A stopped CPU only wakes up for a button, and buttons only change at
+        // the end of a frame, so sleep there until the window has an event.
+        if (cpu.is_stopped() and gpu.get_frame_count() != stopped_frame) {
+            stopped_frame = gpu.get_frame_count();
+            gpu.wait_events();
+        }
+
+        // Rewind one snapshot for every frame that the rewind key is held.
+        if (rewind != nullptr and gpu.get_frame_count() != rewind_frame) {
+            rewind_frame = gpu.get_frame_count();
+            if (keyboard.rewind_held()) {
+                rewind->step_back();
+            }
+            else {
+                rewind->frame_ended();
+            }
+        }
+
+        // Keys are only read at the end of a frame, so the buttons are
+        // recorded and played back there too.
+        if (movie and gpu.get_frame_count() != movie_frame) {
+            movie_frame = gpu.get_frame_count();
+
+            uint64_t hashes[2] = {movie_hash, gpu.frame_hash()};
+            movie_hash = hash64(hashes, sizeof(hashes));
+
+            if (movie_reader != nullptr) {
+                memory.set_buttons(movie_reader->get_buttons(movie_frame));
+                if (latency != nullptr) {
+                    latency->buttons_polled(movie_frame, latency_clock());
+                }
+            }
+            if (movie_writer != nullptr) {
+                movie_writer->record(movie_frame, memory.get_buttons());
+            }
+        }
+    }
+
+    if (linked != nullptr) {
+        linked->stop(memory);
+    }
+
+    if (rewind != nullptr) {
+        delete rewind;
+    }
+
+    if (options.save_state_path != nullptr) {
+        StateWriter writer;
+        save_state(writer, cpu, gpu, memory);
+        if (!write_state_file(options.save_state_path, writer)) {
+            cerr << "Could not write " << options.save_state_path << endl;
+        }
     }
 
     cout << cpu.get_num_instructions() << endl;
     cout << hex << gpu.screen_hash() << endl;
+    cout << dec << gpu.get_frame_count() << " frames, ";
+    cout << gpu.get_skipped_frames() << " skipped, ";
+    cout << gpu.get_unchanged_frames() << " unchanged" << endl;
+
+    if (linked != nullptr) {
+        cout << "Linked: " << dec << linked->cpu.get_num_instructions() << " instructions, ";
+        cout << hex << linked->gpu.screen_hash() << dec << endl;
+        delete linked;
+    }
+
+    if (audio != nullptr) {
+        memory.get_apu().set_sink(nullptr);
+        audio->close();
+        cout << "Audio: " << audio->get_underruns() << " underruns, ";
+        cout << audio->get_max_latency() << " ms latency" << endl;
+        delete audio;
+    }
+
+    if (wav != nullptr) {
+        memory.get_apu().set_sink(nullptr);
+        wav->close();
+        cout << wav->get_frames_written() << " audio frames written, hash ";
+        cout << hex << wav->get_audio_hash() << dec << endl;
+        delete wav;
+    }
+
+    if (latency != nullptr) {
+        gpu.set_latency_probe(nullptr);
+        latency->report(cout);
+        delete latency;
+    }
+
+    if (movie) {
+        cout << "Movie: " << movie_frame << " frames, screen hash " << hex << movie_hash << dec << endl;
+    }
+
+    if (movie_reader != nullptr) {
+        delete movie_reader;
+    }
+
+    if (movie_writer != nullptr) {
+        movie_writer->finish();
+        delete movie_writer;
+    }
+
+    if (capture != nullptr) {
+        capture->close();
+        cout << capture->get_frames_written() << " frames captured, ";
+        cout << capture->get_frames_dropped() << " dropped" << endl;
+        delete capture;
+    }
 
     glfwTerminate();
     return 0;
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
  */
 
 #include "cartridge.h"
+#include "../util/hash.h"
 
 Cartridge::Cartridge() : Cartridge(ROM_ONLY, nullptr, 0, 0) {
 
@@ -50,12 +51,17 @@ Cartridge::Cartridge(uint8_t* data) {
 
     }
 
+    // The ROM is 32 KB shifted left by the size code in the header.
+    int size_code = data[ROM_SIZE_ADDR];
+    rom_size = 2 * ROM_BANK_SIZE << (size_code <= 8 ? size_code : 0);
+
     // Allocate maximum possible amount of RAM.
     ram_size = RAM_BANK_SIZE * 16;
     ram_data = new uint8_t[ram_size];
 
     rom_bank = 1;
     ram_bank = 0;
+    hash_valid = false;
 }
 
 Cartridge::Cartridge(MBCType type, uint8_t* data, int rom_size, int ram_size) {
@@ -72,6 +78,7 @@ Cartridge::Cartridge(MBCType type, uint8_t* data, int rom_size, int ram_size) {
     else {
         this->ram_data = nullptr;
     }
+    this->hash_valid = false;
 }
 
 uint8_t Cartridge::load_byte_rom(uint16_t address) {
@@ -192,6 +199,14 @@ uint8_t Cartridge::access_ram_data(int address) {
     return ram_data[address];
 }
 
+uint64_t Cartridge::rom_hash() {
+    if (!hash_valid) {
+        hash = hash64(rom_data, rom_size);
+        hash_valid = true;
+    }
+    return hash;
+}
+
 int Cartridge::get_rom_bank() {
     return rom_bank;
 }
@@ -203,3 +218,15 @@ int Cartridge::get_ram_bank() {
 
 
 
+
+void Cartridge::save_state(StateWriter & writer) {
+    writer.write(&rom_bank, sizeof(rom_bank));
+    writer.write(&ram_bank, sizeof(ram_bank));
+    writer.write(ram_data, ram_size);
+}
+
+bool Cartridge::load_state(StateReader & reader) {
+    return reader.read(&rom_bank, sizeof(rom_bank)) and
+           reader.read(&ram_bank, sizeof(ram_bank)) and
+           reader.read(ram_data, ram_size);
+}
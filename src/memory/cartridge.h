@@ -9,9 +9,12 @@
 
 #include <cstdint>
 
+#include "../state/state_format.h"
+
 #define address_between(x, y) (x <= address and address <= y)
 
 #define ROM_TYPE_ADDR 0x0147
+#define ROM_SIZE_ADDR 0x0148
 #define RAM_SIZE_ADDR 0x0149
 
 #define ROM_BANK_SIZE 0x4000
@@ -50,6 +53,10 @@ private:
     // The type of cartridge. This determines the memory ban controller.
     MBCType type;
 
+    // The hash of the ROM, worked out the first time it is needed.
+    uint64_t hash;
+    bool hash_valid;
+
 
 public:
 
@@ -160,6 +167,12 @@ public:
      */
     uint8_t access_ram_data(int address);
 
+    /*
+     * @return: The hash of the whole ROM, which identifies the game.
+     * Only hashed once, since the ROM never changes.
+     */
+    uint64_t rom_hash();
+
     /*
      * @return: The index of the active ROM bank.
      */
@@ -169,6 +182,20 @@ public:
      * @return: The index of the active cartridge RAM bank.
      */
     int get_ram_bank();
+
+    /*
+     * Add the selected banks and the cartridge RAM to a save state. The ROM
+     * isn't saved, the state only records its hash.
+     */
+    void save_state(StateWriter & writer);
+
+    /*
+     * Restore the selected banks and the cartridge RAM from the open chunk of
+     * a save state.
+     *
+     * @return: False if the chunk is too short.
+     */
+    bool load_state(StateReader & reader);
 };
 
 
@@ -13,32 +13,18 @@ Memory::Memory(Cartridge& cart) : cartridge(cart) {
 
 inline void Memory::initialize_registers() {
     memset(ram, 0xFF, 0xFFFF);
-    memset(&flags, false, sizeof(flags));
 
-    ram[SB] = 0x00;
-    ram[SC] = 0x7E;
-    ram[TIMA] = 0x00;
-    ram[TMA] = 0x00;
-    ram[TAC] = 0xF8;
+    vram_generation = 0;
+    oam_generation = 0;
+    video_register_generation = 0;
+    lcd_status_generation = 0;
+
+    timer = Timer();
+    serial = Serial();
+    apu = APU();
+    joypad = Joypad();
+    oam_dma = OamDma();
     ram[IF] = 0xE1;
-    ram[NR_10] = 0x80;
-    ram[NR_11] = 0xBF;
-    ram[NR_12] = 0xF3;
-    ram[NR_14] = 0xBF;
-    ram[NR_21] = 0x3F;
-    ram[NR_22] = 0x00;
-    ram[NR_24] = 0xBF;
-    ram[NR_30] = 0x7F;
-    ram[NR_31] = 0xFF;
-    ram[NR_32] = 0x9F;
-    ram[NR_34] = 0xBF;
-    ram[NR_41] = 0xFF;
-    ram[NR_42] = 0x00;
-    ram[NR_43] = 0x00;
-    ram[NR_44] = 0xBF;
-    ram[NR_50] = 0x77;
-    ram[NR_51] = 0xF3;
-    ram[NR_52] = 0xF1;
     ram[LCDC] = 0x91;
     ram[STAT] = 0x83;
     ram[SCY] = 0x00;
@@ -51,23 +37,70 @@ inline void Memory::initialize_registers() {
     ram[WY] = 0x00;
     ram[WX] = 0x00;
     ram[IE] = 0x00;
+    update_pending_interrupts();
+}
+
+inline void Memory::mark_video_write(uint16_t address) {
+    if (address_between(0x8000, 0x9FFF)) {
+        vram_generation += 1;
+    }
+    else if (address_between(0xFE00, 0xFE9F)) {
+        oam_generation += 1;
+    }
+    else if (address == LCDC || address_between(SCY, SCX) ||
+             address_between(BGP, WX)) {
+        video_register_generation += 1;
+    }
+}
+
+inline bool Memory::dma_conflict(uint16_t address) {
+    if (address >= 0xFF00) {
+        return false;
+    }
+    if (address >= 0xFE00) {
+        return true;
+    }
 
-    // Initialize registers on boot
-    ram[P1] = 0xCF;
-    ram[DIV] = 0x18;
+    // VRAM has a bus of its own, and the cartridge and work RAM share the other.
+    bool vram_source = between(0x80, oam_dma.get_source(), 0x9F);
+    return vram_source == address_between(0x8000, 0x9FFF);
+}
+
+inline bool Memory::io_word(uint16_t address) {
+    return address + 1 >= 0xFF00 and address <= 0xFF7F;
 }
 
 uint8_t Memory::load_byte(uint16_t address) {
+    if (oam_dma.is_active() and dma_conflict(address)) {
+        return 0xFF;
+    }
+
     if (address_between(0x0000, 0x7FFF)) {
         return cartridge.load_byte_rom(address);
     }
     else if (address_between(0xA000, 0xBFFF)) {
         return cartridge.load_byte_ram(address);
     }
+    else if (address == P1) {
+        return joypad.load_byte();
+    }
+    else if (address_between(SB, SC)) {
+        return serial.load_byte(address);
+    }
+    else if (address_between(DIV, TAC)) {
+        return timer.load_byte(address);
+    }
+    else if (address_between(NR_10, 0xFF3F)) {
+        return apu.load_byte(address);
+    }
     return ram[address];
 }
 
 void Memory::store_byte(uint16_t address, uint8_t val) {
+    if (oam_dma.is_active() and dma_conflict(address)) {
+        return;
+    }
+
     if (address_between(0x0000, 0x7FFF)) {
         cartridge.store_byte_rom(address, val);
     }
@@ -75,10 +108,15 @@ void Memory::store_byte(uint16_t address, uint8_t val) {
         cartridge.store_byte_ram(address, val);
     }
     else if (address == P1) {
-        ram[P1] = val | 0b11000000;
+        if (joypad.write_select(val)) {
+            request_interrupt(JOYPAD_INTERRUPT_BIT);
+        }
+    }
+    else if (address == SB) {
+        serial.write_sb(val);
     }
     else if (address == SC) {
-        ram[SC] = val | 0b01111110;
+        serial.write_sc(val);
     }
     else if (address == 0xFF08  || address == 0xFF09 ||
              between(0xFF0A, address, 0xFF0E) || address == 0xFF15 ||
@@ -87,65 +125,57 @@ void Memory::store_byte(uint16_t address, uint8_t val) {
         // Ignore Writes.
         cout << hex << address << " " << hex << (uint16_t)ram[address] << endl;
     }
-    else if (address == DIV) {
-        ram[DIV] = 0;
-        flags.reset_div_cycles = true;
-    }
-    else if (address == TIMA) {
-        if (flags.reload_timer_a) { // Overwrite new_timer_value.
-            new_timer_value = val;
-        }
-        else if (flags.reload_timer_b) {
-            // Ignore writes to TIMA in this state.
-        }
-        else {
-            ram[TIMA] = val; // Normal behavior.
-        }
-    }
-    else if (address == TAC) {
-        old_TAC_value = ram[TAC];
-
-        ram[TAC] = val | 0b11111000;
-        flags.write_to_TAC = true;
-    }
-    else if (address == TMA) {
-        if (flags.reload_timer_b) {
-            ram[TIMA] = val;
-        }
-        ram[TMA] = val;
-        new_timer_value = load_byte(TMA);
+    else if (address_between(DIV, TAC)) {
+        timer.store_byte(address, val);
     }
     else if (address == IF) {
         ram[IF] = 0xE0 | (val & 0x1F);
+        update_pending_interrupts();
     }
-    else if (address == STAT || address == NR_10) {
-        ram[address] = val | 0b10000000;
+    else if (address == IE) {
+        ram[IE] = val;
+        update_pending_interrupts();
     }
-    else if (address == NR_30) {
-        ram[NR_30] = val | 0b01111111;
+    else if (address == STAT) {
+        // The mode and coincidence bits are read only.
+        ram[STAT] = 0b10000000 | (val & 0b01111000) | (ram[STAT] & 0b00000111);
+        lcd_status_generation += 1;
     }
-    else if (address == NR_32) {
-        ram[NR_32] = val | 0b10011111;
+    else if (address == LYC) {
+        ram[LYC] = val;
+        lcd_status_generation += 1;
     }
-    else if (address == NR_41) {
-        ram[NR_41] = val | 0b11000000;
+    else if (address == LCDC) {
+        // The GPU switches the LCD on and off when it sees the write.
+        if (ram[LCDC] != val) {
+            mark_video_write(LCDC);
+        }
+        ram[LCDC] = val;
+        lcd_status_generation += 1;
     }
-    else if (address == NR_44) {
-        ram[NR_44] = val | 0b00111111;
+    else if (address == LY) {
+        // LY is read only.
     }
-    else if (address == NR_52) {
-        ram[NR_52] = val | 0b01110000;
+    else if (address_between(NR_10, 0xFF3F)) {
+        apu.store_byte(address, val);
     }
     else if (address == DMA) {
-        DMA_address = val;
-        flags.oam_dma = true;
+        ram[DMA] = val;
+        oam_dma.start(val);
     }
     else {
+        if (ram[address] != val) {
+            mark_video_write(address);
+        }
         ram[address] = val;
     }
 }
 
 uint16_t Memory::load_word(uint16_t address) {
+    if ((oam_dma.is_active() and (dma_conflict(address) or dma_conflict(address + 1))) or io_word(address)) {
+        return (load_byte(address + 1) << 8) | load_byte(address);
+    }
+
     if (address_between(0x0000, 0x7FFF)) {
         return cartridge.load_word_rom(address);
     }
@@ -156,6 +186,12 @@ uint16_t Memory::load_word(uint16_t address) {
 }
 
 void Memory::store_word(uint16_t address, uint16_t value) {
+    if ((oam_dma.is_active() and (dma_conflict(address) or dma_conflict(address + 1))) or io_word(address)) {
+        store_byte(address, value & 0xFF);
+        store_byte(address + 1, value >> 8);
+        return;
+    }
+
     if (address_between(0x0000, 0x7FFF)) {
         cartridge.store_word_rom(address, value);
     }
@@ -163,18 +199,51 @@ void Memory::store_word(uint16_t address, uint16_t value) {
         cartridge.store_word_ram(address, value);
     }
     else {
+        mark_video_write(address);
+        mark_video_write(address + 1);
         *reinterpret_cast<uint16_t *>(ram + address) = value;
+
+        if (address + 1 == IE) {
+            update_pending_interrupts();
+        }
     }
 }
 
 uint8_t & Memory::get_byte_reference(uint16_t address) {
+    if (oam_dma.is_active() and dma_conflict(address)) {
+        // Writes through the reference are lost, like any other write.
+        dma_blocked_byte = 0xFF;
+        return dma_blocked_byte;
+    }
+
     if (address_between(0x0000, 0x7FFF)) {
         return cartridge.get_byte_reference_rom(address);
     }
     else if (address_between(0xA000, 0xBFFF)) {
         return cartridge.get_byte_reference_ram(address);
     }
+    else if (address == P1) {
+        ram[P1] = joypad.load_byte();
+    }
+    else if (address_between(SB, SC)) {
+        ram[address] = serial.load_byte(address);
+    }
+    else if (address_between(DIV, TAC)) {
+        // The timer registers are only worked out when they are read.
+        ram[address] = timer.load_byte(address);
+    }
+    else if (address_between(NR_10, 0xFF3F)) {
+        ram[address] = apu.load_byte(address);
+    }
+    else if (address == IF or address == IE) {
+        pending_interrupts = INTERRUPTS_UNKNOWN;
+    }
+    else if (address == LCDC) {
+        lcd_status_generation += 1;
+    }
 
+    // The reference may be written to, so assume that it will be.
+    mark_video_write(address);
     return ram[address];
 }
 
@@ -182,33 +251,111 @@ void Memory::copy(void *dest, uint16_t addr, int size) {
     memcpy(dest, ram + addr, size);
 }
 
-void Memory::copy_sprite_memory(uint8_t value) {
-    uint16_t cart_addr = value << 8;
-    for (int i = 0; i < 0x9F; i++) {
-        ram[0xFE00 + i] = load_byte(cart_addr + i);
+void Memory::transfer_oam_dma() {
+    int from, to;
+    oam_dma.handle_event(from, to);
+    if (from == to) {
+        return;
+    }
+
+    // Sources from 0xE000 up read the work RAM underneath.
+    uint16_t source = oam_dma.get_source() << 8;
+    if (source >= 0xE000) {
+        source -= 0x2000;
+    }
+
+    if (source >= 0x8000 and (source < 0xA000 or source >= 0xC000)) {
+        // VRAM and work RAM can be copied straight out of the page.
+        memcpy(ram + 0xFE00 + from, ram + source + from, to - from);
+    }
+    else {
+        for (int i = from; i < to; i++) {
+            uint16_t address = source + i;
+            ram[0xFE00 + i] = address < 0x8000 ? cartridge.load_byte_rom(address)
+                                               : cartridge.load_byte_ram(address);
+        }
+    }
+    oam_generation += 1;
+}
+
+Timer & Memory::get_timer() {
+    return timer;
+}
+
+Serial & Memory::get_serial() {
+    return serial;
+}
+
+void Memory::request_interrupt(uint8_t bit) {
+    ram[IF] |= bit;
+    update_pending_interrupts();
+}
+
+uint8_t Memory::refresh_pending_interrupts() {
+    update_pending_interrupts();
+    return pending_interrupts;
+}
+
+APU & Memory::get_apu() {
+    return apu;
+}
+
+Joypad & Memory::get_joypad() {
+    return joypad;
+}
+
+void Memory::set_buttons(uint8_t buttons) {
+    if (joypad.set_buttons(buttons)) {
+        request_interrupt(JOYPAD_INTERRUPT_BIT);
     }
 }
 
-bool Memory::get_flag(int f) {
-    return ((bool *)&flags)[f];
+uint8_t Memory::get_buttons() {
+    return joypad.get_buttons();
 }
 
-void Memory::set_flag(int f, bool value) {
-    ((bool *)&flags)[f] = value;
+
+uint64_t Memory::get_vram_generation() {
+    return vram_generation;
 }
 
-void Memory::set_new_timer_value() {
-    new_timer_value = load_byte(TMA);
+uint64_t Memory::get_oam_generation() {
+    return oam_generation;
 }
 
-uint8_t Memory::get_new_timer_value() {
-    return new_timer_value;
+uint64_t Memory::get_video_register_generation() {
+    return video_register_generation;
 }
 
-uint8_t Memory::get_old_TAC_value() {
-    return old_TAC_value;
+uint64_t Memory::get_lcd_status_generation() {
+    return lcd_status_generation;
 }
 
-uint8_t Memory::get_DMA_Address() {
-    return DMA_address;
-}
\ No newline at end of file
+void Memory::save_state(StateWriter & writer) {
+    writer.write(ram, sizeof(ram));
+    writer.write(&timer, sizeof(timer));
+    serial.save_state(writer);
+    apu.save_state(writer);
+    writer.write(&joypad, sizeof(joypad));
+    writer.write(&oam_dma, sizeof(oam_dma));
+}
+
+bool Memory::load_state(StateReader & reader) {
+    uint8_t buttons = joypad.get_buttons();
+    bool loaded = reader.read(ram, sizeof(ram)) and
+                  reader.read(&timer, sizeof(timer)) and
+                  serial.load_state(reader) and
+                  apu.load_state(reader) and
+                  reader.read(&joypad, sizeof(joypad)) and
+                  reader.read(&oam_dma, sizeof(oam_dma));
+
+    // Otherwise the buttons held when the state was saved would stay held.
+    set_buttons(buttons);
+
+    vram_generation += 1;
+    oam_generation += 1;
+    video_register_generation += 1;
+    lcd_status_generation += 1;
+    update_pending_interrupts();
+    return loaded;
+}
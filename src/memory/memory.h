@@ -49,12 +49,11 @@
 #define WX 0xFF4B
 #define IE 0xFFFF
 
-// Memory flags.
-#define RESET_DIV_CYCLES_FLAG 0
-#define RELOAD_TIMER_A_FLAG 1
-#define RELOAD_TIMER_B_FLAG 2
-#define WRITE_TO_TAC_FLAG 3
-#define OAM_DMA_FLAG 4
+// The bit of IF that memory raises the joypad interrupt with.
+#define JOYPAD_INTERRUPT_BIT 0x10
+
+// A pending interrupt mask that has to be worked out again.
+#define INTERRUPTS_UNKNOWN 0x80
 
 #define address_between(x, y) (x <= address and address <= y)
 
@@ -62,6 +61,12 @@
 #include <iostream>
 
 #include "cartridge.h"
+#include "oam_dma.h"
+#include "../cpu/timer.h"
+#include "../serial/serial.h"
+#include "../apu/apu.h"
+#include "../input/joypad.h"
+#include "../state/state_format.h"
 
 using namespace std;
 
@@ -77,18 +82,60 @@ private:
     // Internal RAM. Includes VRAM and OAM memory.
     uint8_t ram[0xFFFF + 1];
 
-    // Internal Flags. Used to communicate with the CPU.
-    struct flags {
-        bool reset_div_cycles;
-        bool reload_timer_a;
-        bool reload_timer_b;
-        bool write_to_TAC;
-        bool oam_dma;
-    } flags;
+    // The DIV, TIMA, TMA and TAC registers.
+    Timer timer;
+
+    // The SB and SC registers.
+    Serial serial;
+
+    // The sound registers and wave RAM.
+    APU apu;
+
+    // The P1 register.
+    Joypad joypad;
+
+    // The transfer started by writing to DMA.
+    OamDma oam_dma;
+
+    // Returned by get_byte_reference for a byte the CPU can't reach during
+    // an OAM DMA transfer.
+    uint8_t dma_blocked_byte;
+
+    // IE & IF, the interrupts that are both requested and enabled. Set to
+    // INTERRUPTS_UNKNOWN when IE or IF may be written through a reference.
+    uint8_t pending_interrupts;
 
-    uint8_t new_timer_value;
-    uint8_t old_TAC_value;
-    uint8_t DMA_address;
+    // Write generations for the memory that the screen is drawn from. Each
+    // generation is incremented whenever the corresponding memory is written.
+    uint64_t vram_generation;
+    uint64_t oam_generation;
+    uint64_t video_register_generation;
+    uint64_t lcd_status_generation;
+
+    void mark_video_write(uint16_t address);
+
+    inline void update_pending_interrupts() {
+        pending_interrupts = ram[IE] & ram[IF] & 0x1F;
+    }
+
+    /*
+     * @return: True if the CPU can't use an address because an OAM DMA
+     * transfer is using its bus. VRAM and the rest of memory are on separate
+     * buses, HRAM and the IO registers are always free, and OAM can't be used
+     * at all.
+     */
+    bool dma_conflict(uint16_t address);
+
+    /*
+     * @return: True if either byte of the word at an address is an IO
+     * register, so that the word has to be read or written a byte at a time.
+     */
+    bool io_word(uint16_t address);
+
+    /*
+     * Copy the bytes of the OAM DMA transfer that have become due.
+     */
+    void transfer_oam_dma();
 
 
 public:
@@ -133,7 +180,8 @@ public:
     virtual void store_word(uint16_t address, uint16_t value);
 
     /*
-     * @return: A reference to the byte stored in memory.
+     * @return: A reference to the byte stored in memory. Writes through the
+     * reference aren't seen by the IO registers, use store_byte for those.
      */
     virtual uint8_t & get_byte_reference(uint16_t address);
 
@@ -148,43 +196,108 @@ public:
     virtual void copy(void* destination, uint16_t address, int size);
 
     /*
-     * Copies sprite memory from the cartridge to the GPU.
+     * @return: The timer, which the CPU moves forward after every instruction.
+     */
+    Timer & get_timer();
+
+    /*
+     * @return: The serial port, which the CPU moves forward after every
+     * instruction.
+     */
+    Serial & get_serial();
+
+    /*
+     * @return: The APU, which the CPU moves forward after every instruction.
+     */
+    APU & get_apu();
+
+    /*
+     * @return: The joypad, which P1 is read through.
      */
-    virtual void copy_sprite_memory(uint8_t value);
+    Joypad & get_joypad();
 
     /*
-     * Read and return the value of a memory flag.
+     * Set a bit of IF.
+     *
+     * @param bit: The bit of the interrupt to request.
      */
-    bool get_flag(int f);
+    void request_interrupt(uint8_t bit);
 
     /*
-     * Set the value of a memory flag.
+     * @return: Non-zero if an interrupt may be requested and enabled. This is
+     * kept up to date as IE and IF change, so it is cheap enough to check
+     * after every instruction.
      */
-    void set_flag(int f, bool value);
+    inline uint8_t get_pending_interrupts() {
+        return pending_interrupts;
+    }
 
     /*
-     * @return: The value that the timer should be set to after the timer overflow.
-     * This is usually the value in the TMA register, but
+     * Work out IE & IF again, in case either was written through a reference.
+     *
+     * @return: The interrupts that are requested and enabled.
      */
-    uint8_t get_new_timer_value();
+    uint8_t refresh_pending_interrupts();
 
     /*
-     * Sets the new timer value to be the value in the TMA register. The CPU should
-     * call this function immediately after a timer overflow.
+     * Move an OAM DMA transfer forward, copying the bytes that are due.
+     *
+     * @param elapsed: The number of cycles that have passed.
      */
-    void set_new_timer_value();
+    inline void tick_oam_dma(uint32_t elapsed) {
+        if (oam_dma.tick(elapsed)) {
+            transfer_oam_dma();
+        }
+    }
 
     /*
-     * Returns the new value of the TAC register. The CPU should call this function
-     * if the WRITE_TO_TAC_FLAG is raised by the memory unit, to determine what the
-     * new value of the TAC register should be.
+     * Change which buttons are held down, raising the joypad interrupt if a
+     * button that the game can see was pressed.
+     *
+     * @param buttons: A bit set for each button held down, see joypad.h.
      */
-    uint8_t get_old_TAC_value();
+    void set_buttons(uint8_t buttons);
 
     /*
-     * @return: The address to start the DMA transfer from.
+     * @return: The buttons held down.
+     */
+    uint8_t get_buttons();
+
+    /*
+     * @return: The number of writes to VRAM (0x8000 - 0x9FFF).
+     */
+    uint64_t get_vram_generation();
+
+    /*
+     * @return: The number of writes to OAM (0xFE00 - 0xFE9F).
+     */
+    uint64_t get_oam_generation();
+
+    /*
+     * @return: The number of writes to the LCDC, scroll, window and palette
+     * registers.
+     */
+    uint64_t get_video_register_generation();
+
+    /*
+     * @return: The number of writes to the LCDC, STAT and LYC registers.
+     */
+    uint64_t get_lcd_status_generation();
+
+    /*
+     * Add the RAM and the state of the timer, serial port, APU, joypad and
+     * OAM DMA to a save state. The cartridge is saved on its own.
+     */
+    void save_state(StateWriter & writer);
+
+    /*
+     * Restore memory from the open chunk of a save state. Every write
+     * generation moves on, so the screen is drawn again from scratch. The
+     * buttons held down on the host are kept, not the ones in the state.
+     *
+     * @return: False if the chunk is too short.
      */
-    uint8_t get_DMA_Address();
+    bool load_state(StateReader & reader);
 };
 
 
@@ -0,0 +1,49 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include "oam_dma.h"
+
+OamDma::OamDma() {
+    cycles = 0;
+    next_event = OAM_DMA_NO_EVENT;
+    start_cycle = 0;
+    source = 0;
+    copied = 0;
+    starting = false;
+    active = false;
+}
+
+void OamDma::start(uint8_t source) {
+    this->source = source;
+    copied = 0;
+    starting = true;
+    active = true;
+
+    // The transfer is counted from the next tick, which ends the instruction.
+    next_event = 0;
+}
+
+void OamDma::handle_event(int & from, int & to) {
+    if (starting) {
+        start_cycle = cycles;
+        starting = false;
+    }
+
+    uint64_t due = (cycles - start_cycle) / OAM_DMA_BYTE_CYCLES;
+    from = copied;
+    to = due < OAM_DMA_LENGTH ? static_cast<int>(due) : OAM_DMA_LENGTH;
+    copied = to;
+
+    if (copied == OAM_DMA_LENGTH) {
+        active = false;
+        next_event = OAM_DMA_NO_EVENT;
+    }
+    else {
+        next_event = start_cycle + (copied + 1) * OAM_DMA_BYTE_CYCLES;
+    }
+}
+
+uint8_t OamDma::get_source() {
+    return source;
+}
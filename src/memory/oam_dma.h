@@ -0,0 +1,98 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_OAM_DMA_H
+#define GAME_BOY_EMULATOR_OAM_DMA_H
+
+#include <cstdint>
+
+#define OAM_DMA_LENGTH 160 // The number of bytes copied to OAM.
+#define OAM_DMA_BYTE_CYCLES 4 // One byte is copied every M-cycle.
+
+// The deadline of a DMA unit with nothing to do.
+#define OAM_DMA_NO_EVENT UINT64_MAX
+
+/*
+ * The timing of an OAM DMA transfer, which copies 160 bytes from
+ * (DMA << 8) to OAM, one byte every M-cycle.
+ *
+ * DMA is written in the last M-cycle of an instruction, and the transfer
+ * starts one M-cycle after the write. The CPU's reads and writes also happen
+ * in the last M-cycle of an instruction, so counting the transfer from the
+ * end of the instruction that wrote DMA gives the right result for both: a
+ * transfer started by one instruction is running for the instructions that
+ * start in the next 160 M-cycles.
+ *
+ * The unit only works out how many bytes are due. Memory does the copying,
+ * and keeps the CPU off the buses the transfer is using while it runs.
+ *
+ * Example usage:
+ *
+ *  if (dma.tick(cycles)) {
+ *      int from, to;
+ *      dma.handle_event(from, to);
+ *      // Copy bytes [from, to) of the source page to OAM.
+ *  }
+ */
+class OamDma {
+
+private:
+
+    uint64_t cycles; // The number of cycles since the unit was created.
+    uint64_t next_event; // The cycle count at which the next byte is due.
+
+    // The cycle count at which the transfer started.
+    uint64_t start_cycle;
+
+    uint8_t source;
+    int copied;
+
+    bool starting; // DMA was written during the last instruction.
+    bool active;
+
+public:
+
+    OamDma();
+
+    /*
+     * Move the cycle count forward.
+     *
+     * @param elapsed: The number of cycles that have passed.
+     * @return: True if bytes are due to be copied.
+     */
+    inline bool tick(uint32_t elapsed) {
+        cycles += elapsed;
+        return cycles >= next_event;
+    }
+
+    /*
+     * Start a transfer at the end of the current instruction, replacing any
+     * transfer in progress.
+     *
+     * @param source: The high byte of the address to copy from.
+     */
+    void start(uint8_t source);
+
+    /*
+     * Work out which bytes have become due, and schedule the next one.
+     *
+     * @param from: Set to the index of the first byte to copy.
+     * @param to: Set to one past the index of the last byte to copy.
+     */
+    void handle_event(int & from, int & to);
+
+    /*
+     * @return: True while a transfer is running.
+     */
+    inline bool is_active() {
+        return active;
+    }
+
+    /*
+     * @return: The high byte of the address being copied from.
+     */
+    uint8_t get_source();
+};
+
+#endif
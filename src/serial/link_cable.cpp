@@ -0,0 +1,68 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <thread>
+
+#include "link_cable.h"
+
+LinkChannel::LinkChannel() : pushed(0), popped(0) {
+}
+
+bool LinkChannel::push(const LinkMessage & message) {
+    uint64_t n = pushed.load(std::memory_order_relaxed);
+    if (n - popped.load(std::memory_order_acquire) == LINK_CHANNEL_SIZE) {
+        return false;
+    }
+
+    messages[n % LINK_CHANNEL_SIZE] = message;
+    pushed.store(n + 1, std::memory_order_release);
+    return true;
+}
+
+bool LinkChannel::pop(LinkMessage & message) {
+    uint64_t n = popped.load(std::memory_order_relaxed);
+    if (n == pushed.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    message = messages[n % LINK_CHANNEL_SIZE];
+    popped.store(n + 1, std::memory_order_release);
+    return true;
+}
+
+LinkEndpoint::LinkEndpoint(LinkCable *cable, int side) {
+    this->cable = cable;
+    this->side = side;
+}
+
+void LinkEndpoint::publish(uint64_t cycles) {
+    cable->cycles[side].store(cycles, std::memory_order_release);
+}
+
+uint64_t LinkEndpoint::get_peer_cycles() {
+    return cable->cycles[1 - side].load(std::memory_order_acquire);
+}
+
+void LinkEndpoint::send(const LinkMessage & message) {
+    while (!cable->channels[1 - side].push(message)) {
+        std::this_thread::yield();
+    }
+}
+
+bool LinkEndpoint::receive(LinkMessage & message) {
+    return cable->channels[side].pop(message);
+}
+
+void LinkEndpoint::disconnect() {
+    publish(UINT64_MAX);
+}
+
+LinkCable::LinkCable() : endpoints{LinkEndpoint(this, 0), LinkEndpoint(this, 1)} {
+    cycles[0].store(0);
+    cycles[1].store(0);
+}
+
+LinkEndpoint* LinkCable::get_endpoint(int side) {
+    return &endpoints[side];
+}
@@ -0,0 +1,156 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_LINK_CABLE_H
+#define GAME_BOY_EMULATOR_LINK_CABLE_H
+
+#include <atomic>
+#include <cstdint>
+
+// How many cycles an emulator may run ahead of the one it is linked to. Must
+// be less than a transfer, so that a transfer is always seen by the other
+// emulator before it reaches the end of the transfer.
+#define LINK_MAX_SKEW 2048
+
+// How often an emulator tells the other one how far it has run.
+#define LINK_SYNC_INTERVAL 512
+
+// The number of messages that can be waiting in each direction.
+#define LINK_CHANNEL_SIZE 64
+
+// Message types.
+#define LINK_TRANSFER 0 // The sender has started a transfer with its clock.
+#define LINK_REPLY 1 // The byte shifted out in answer to a transfer.
+
+/*
+ * A message sent down the cable, stamped with the cycle count of the sender
+ * that it takes effect at.
+ */
+struct LinkMessage {
+    uint64_t cycle;
+    uint8_t type;
+    uint8_t data;
+};
+
+/*
+ * A queue of messages from one thread to another, which never locks.
+ */
+class LinkChannel {
+
+private:
+
+    LinkMessage messages[LINK_CHANNEL_SIZE];
+
+    // The number of messages pushed and popped. Each is only written by one
+    // thread.
+    std::atomic<uint64_t> pushed;
+    std::atomic<uint64_t> popped;
+
+public:
+
+    LinkChannel();
+
+    /*
+     * Called by the sending thread.
+     *
+     * @return: False if the channel is full.
+     */
+    bool push(const LinkMessage & message);
+
+    /*
+     * Called by the receiving thread.
+     *
+     * @return: False if there are no messages waiting.
+     */
+    bool pop(LinkMessage & message);
+};
+
+class LinkCable;
+
+/*
+ * One end of a link cable, used by the serial port of one emulator.
+ */
+class LinkEndpoint {
+
+private:
+
+    LinkCable *cable;
+    int side;
+
+public:
+
+    LinkEndpoint(LinkCable *cable, int side);
+
+    /*
+     * Let the other end know how far this emulator has run.
+     *
+     * @param cycles: The cycle count of this emulator.
+     */
+    void publish(uint64_t cycles);
+
+    /*
+     * @return: How far the other emulator has run, or UINT64_MAX once it has
+     * been disconnected.
+     */
+    uint64_t get_peer_cycles();
+
+    /*
+     * Send a message to the other end, waiting for room if the channel is full.
+     */
+    void send(const LinkMessage & message);
+
+    /*
+     * @return: False if there are no messages waiting.
+     */
+    bool receive(LinkMessage & message);
+
+    /*
+     * Unplug this end of the cable, so the other emulator stops waiting for
+     * this one.
+     */
+    void disconnect();
+};
+
+/*
+ * Connects the serial ports of two emulators running on separate threads of
+ * the same process.
+ *
+ * Each emulator runs freely until it gets LINK_MAX_SKEW cycles ahead of the
+ * other, so neither waits for the other unless it has to. Messages are
+ * stamped with the cycle they take effect at, which keeps the transfers
+ * exactly where they would be if both emulators ran on the same clock.
+ *
+ * Example usage:
+ *
+ *  LinkCable cable;
+ *  first_memory.get_serial().connect(cable.get_endpoint(0));
+ *  second_memory.get_serial().connect(cable.get_endpoint(1));
+ *  // Run each emulator on its own thread.
+ */
+class LinkCable {
+
+private:
+
+    friend class LinkEndpoint;
+
+    LinkEndpoint endpoints[2];
+
+    // channels[i] carries messages to endpoint i.
+    LinkChannel channels[2];
+
+    // How far each emulator has run.
+    std::atomic<uint64_t> cycles[2];
+
+public:
+
+    LinkCable();
+
+    /*
+     * @param side: 0 or 1.
+     * @return: That end of the cable.
+     */
+    LinkEndpoint* get_endpoint(int side);
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <thread>
+
+#include "serial.h"
+#include "../memory/memory.h"
+
+Serial::Serial() {
+    cycles = 0;
+    next_event = SERIAL_NO_EVENT;
+
+    sb = 0x00;
+    sc = 0x7E;
+    transfer_end = SERIAL_NO_EVENT;
+
+    link = nullptr;
+    next_sync = SERIAL_NO_EVENT;
+
+    request_pending = false;
+    request_cycle = 0;
+    request_data = 0;
+
+    reply_pending = false;
+    reply_data = 0;
+}
+
+void Serial::schedule() {
+    next_event = transfer_end;
+
+    if (request_pending and request_cycle < next_event) {
+        next_event = request_cycle;
+    }
+    if (link != nullptr and next_sync < next_event) {
+        next_event = next_sync;
+    }
+}
+
+bool Serial::handle_event() {
+    bool interrupt = false;
+
+    if (link != nullptr and cycles >= next_sync) {
+        sync_link();
+    }
+
+    if (request_pending and cycles >= request_cycle) {
+        interrupt = answer_request();
+    }
+
+    if (cycles >= transfer_end) {
+        finish_transfer();
+        interrupt = true;
+    }
+
+    schedule();
+    return interrupt;
+}
+
+void Serial::sync_link() {
+    link->publish(cycles);
+
+    while (cycles > LINK_MAX_SKEW and cycles - LINK_MAX_SKEW > link->get_peer_cycles()) {
+        std::this_thread::yield();
+    }
+
+    // Anything sent before the other emulator got this far has arrived now.
+    receive_messages();
+    next_sync = cycles + LINK_SYNC_INTERVAL;
+}
+
+void Serial::receive_messages() {
+    LinkMessage message;
+
+    while (link->receive(message)) {
+        if (message.type == LINK_TRANSFER) {
+            request_pending = true;
+            request_cycle = message.cycle;
+            request_data = message.data;
+        }
+        else {
+            reply_pending = true;
+            reply_data = message.data;
+        }
+    }
+}
+
+bool Serial::answer_request() {
+    uint8_t reply = 0xFF;
+    bool interrupt = false;
+
+    // Only a transfer waiting for the external clock takes part.
+    if ((sc & 0b10000001) == 0b10000000) {
+        reply = sb;
+        sb = request_data;
+        sc &= 0b01111111;
+        interrupt = true;
+    }
+
+    request_pending = false;
+    link->send({request_cycle, LINK_REPLY, reply});
+    return interrupt;
+}
+
+void Serial::finish_transfer() {
+    uint8_t data = 0xFF;
+
+    if (link != nullptr) {
+        // Let the other emulator catch up to the end of the transfer.
+        link->publish(cycles);
+
+        while (!reply_pending) {
+            bool disconnected = link->get_peer_cycles() == SERIAL_NO_EVENT;
+            receive_messages();
+
+            if (request_pending and request_cycle <= cycles) {
+                // This emulator is driving the clock, so the other one gets
+                // nothing back.
+                answer_request();
+            }
+
+            if (disconnected) {
+                break;
+            }
+            if (!reply_pending) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (reply_pending) {
+            data = reply_data;
+            reply_pending = false;
+        }
+    }
+
+    sb = data;
+    sc &= 0b01111111;
+    transfer_end = SERIAL_NO_EVENT;
+}
+
+void Serial::connect(LinkEndpoint *endpoint) {
+    link = endpoint;
+    next_sync = cycles;
+    schedule();
+}
+
+void Serial::disconnect() {
+    if (link != nullptr) {
+        link->disconnect();
+    }
+
+    link = nullptr;
+    request_pending = false;
+    reply_pending = false;
+    schedule();
+}
+
+uint8_t Serial::load_byte(uint16_t address) {
+    return address == SB ? sb : sc;
+}
+
+void Serial::write_sb(uint8_t value) {
+    sb = value;
+}
+
+void Serial::write_sc(uint8_t value) {
+    sc = value | 0b01111110;
+
+    if ((sc & 0b10000001) == 0b10000001 and transfer_end == SERIAL_NO_EVENT) {
+        transfer_end = cycles + SERIAL_TRANSFER_CYCLES;
+
+        if (link != nullptr) {
+            link->send({transfer_end, LINK_TRANSFER, sb});
+        }
+        schedule();
+    }
+}
+
+void Serial::save_state(StateWriter & writer) {
+    Serial state = *this;
+    state.link = nullptr;
+    writer.write(&state, sizeof(state));
+}
+
+bool Serial::load_state(StateReader & reader) {
+    Serial state;
+    if (!reader.read(&state, sizeof(state))) {
+        return false;
+    }
+    state.link = link;
+    *this = state;
+    return true;
+}
@@ -0,0 +1,139 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#ifndef GAME_BOY_EMULATOR_SERIAL_H
+#define GAME_BOY_EMULATOR_SERIAL_H
+
+#include <cstdint>
+
+#include "link_cable.h"
+#include "../state/state_format.h"
+
+// The serial clock runs at 8192 Hz, so a byte takes 8 bits of 512 cycles.
+#define SERIAL_BIT_CYCLES 512
+#define SERIAL_TRANSFER_CYCLES (8 * SERIAL_BIT_CYCLES)
+
+// The deadline of a serial port with nothing to do.
+#define SERIAL_NO_EVENT UINT64_MAX
+
+/*
+ * The SB and SC registers.
+ *
+ * A transfer started with the internal clock is scheduled to finish
+ * SERIAL_TRANSFER_CYCLES later, when SB is swapped with the byte from the
+ * other end of the link cable and a serial interrupt is requested. With no
+ * cable connected the other end shifts in 1 bits, so SB becomes 0xFF. A
+ * transfer waiting for an external clock only finishes when the emulator at
+ * the other end of the cable starts one.
+ *
+ * Like the timer, the serial port only needs attention when its next event
+ * is due. With a cable connected the events also include keeping in step
+ * with the other emulator every LINK_SYNC_INTERVAL cycles.
+ *
+ * Example usage:
+ *
+ *  if (serial.tick(cycles)) {
+ *      // Request a serial interrupt.
+ *  }
+ */
+class Serial {
+
+private:
+
+    uint64_t cycles; // The number of cycles since the serial port was created.
+    uint64_t next_event; // The cycle count at which the next event is handled.
+
+    uint8_t sb;
+    uint8_t sc;
+
+    // The cycle count at which a transfer with the internal clock finishes.
+    uint64_t transfer_end;
+
+    LinkEndpoint *link;
+    uint64_t next_sync;
+
+    // A transfer started by the other emulator, which finishes at request_cycle.
+    bool request_pending;
+    uint64_t request_cycle;
+    uint8_t request_data;
+
+    // The answer to the last transfer this emulator started.
+    bool reply_pending;
+    uint8_t reply_data;
+
+    void schedule();
+    bool handle_event();
+
+    /*
+     * Publish the cycle count, wait if this emulator is too far ahead of the
+     * other one, and collect any messages it has sent.
+     */
+    void sync_link();
+    void receive_messages();
+
+    /*
+     * Finish a transfer started by the other emulator.
+     *
+     * @return: True if a serial interrupt should be requested.
+     */
+    bool answer_request();
+
+    /*
+     * Finish a transfer started by this emulator.
+     */
+    void finish_transfer();
+
+public:
+
+    Serial();
+
+    /*
+     * Move the cycle count forward, handling the next event if it is due.
+     *
+     * @param elapsed: The number of cycles that have passed.
+     * @return: True if a transfer finished, and a serial interrupt should be
+     * requested.
+     */
+    inline bool tick(uint32_t elapsed) {
+        cycles += elapsed;
+        return cycles >= next_event and handle_event();
+    }
+
+    /*
+     * Plug in one end of a link cable. Must be called before the emulator
+     * starts running.
+     *
+     * @param endpoint: The end of the cable.
+     */
+    void connect(LinkEndpoint *endpoint);
+
+    /*
+     * Unplug the link cable, if one is connected.
+     */
+    void disconnect();
+
+    /*
+     * @return: The current value of SB or SC.
+     */
+    uint8_t load_byte(uint16_t address);
+
+    void write_sb(uint8_t value);
+    void write_sc(uint8_t value);
+
+    /*
+     * Add the state of the serial port to a save state. The link cable isn't
+     * saved.
+     */
+    void save_state(StateWriter & writer);
+
+    /*
+     * Restore the state of the serial port from the open chunk of a save
+     * state. The port stays connected to the same link cable, if any.
+     *
+     * @return: False if the chunk is too short.
+     */
+    bool load_state(StateReader & reader);
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "rewind.h"
+
+/*
+ * Add a LEB128 varint to a delta.
+ */
+static void put_varint(vector<uint8_t> & out, size_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out.push_back(value != 0 ? (byte | 0x80) : byte);
+    } while (value != 0);
+}
+
+/*
+ * Read a LEB128 varint from a delta.
+ *
+ * @return: False if the delta ends in the middle of the varint.
+ */
+static bool get_varint(const vector<uint8_t> & in, size_t & position, size_t & value) {
+    value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        if (position >= in.size() or shift > 63) {
+            return false;
+        }
+        byte = in[position++];
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return true;
+}
+
+void xor_delta_encode(const uint8_t *from, const uint8_t *to, size_t length, vector<uint8_t> & out) {
+    out.clear();
+
+    size_t i = 0;
+    while (i < length) {
+        // Skip the unchanged bytes, 8 at a time while possible.
+        size_t gap_start = i;
+        while (i + 8 <= length) {
+            uint64_t a, b;
+            memcpy(&a, from + i, 8);
+            memcpy(&b, to + i, 8);
+            if (a != b) {
+                break;
+            }
+            i += 8;
+        }
+        while (i < length and from[i] == to[i]) {
+            i++;
+        }
+        if (i == length) {
+            break;
+        }
+
+        // The run goes on until REWIND_MIN_GAP unchanged bytes in a row.
+        size_t run_start = i;
+        size_t unchanged = 0;
+        while (i < length and unchanged < REWIND_MIN_GAP) {
+            unchanged = from[i] == to[i] ? unchanged + 1 : 0;
+            i++;
+        }
+        i -= unchanged;
+
+        put_varint(out, run_start - gap_start);
+        put_varint(out, i - run_start);
+        for (size_t j = run_start; j < i; j++) {
+            out.push_back(from[j] ^ to[j]);
+        }
+    }
+}
+
+bool xor_delta_apply(const vector<uint8_t> & delta, uint8_t *data, size_t length) {
+    size_t position = 0;
+    size_t offset = 0;
+
+    while (position < delta.size()) {
+        size_t gap, run;
+        if (!get_varint(delta, position, gap) or !get_varint(delta, position, run)) {
+            return false;
+        }
+        if (gap > length - offset or run > length - offset - gap or run > delta.size() - position) {
+            return false;
+        }
+
+        offset += gap;
+        for (size_t j = 0; j < run; j++) {
+            data[offset + j] ^= delta[position + j];
+        }
+        offset += run;
+        position += run;
+    }
+    return true;
+}
+
+RewindBuffer::RewindBuffer(CPU & cpu, GPU & gpu, Memory & memory, int seconds, int interval)
+    : cpu(cpu), gpu(gpu), memory(memory) {
+    this->interval = interval > 0 ? interval : 1;
+    frames = 0;
+
+    size = snapshot_size(cpu, gpu, memory);
+    newest = new uint8_t[size];
+    incoming = new uint8_t[size];
+    has_newest = false;
+
+    deltas.resize(max(1, seconds * REWIND_FRAME_RATE / this->interval));
+    first_delta = 0;
+    num_deltas = 0;
+
+    worker = nullptr;
+    pending = false;
+    stopping = false;
+}
+
+RewindBuffer::~RewindBuffer() {
+    if (worker != nullptr) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker->join();
+        delete worker;
+    }
+
+    delete[] newest;
+    delete[] incoming;
+}
+
+void RewindBuffer::frame_ended() {
+    frames += 1;
+    if (frames < interval) {
+        return;
+    }
+    frames = 0;
+
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return !pending; });
+
+    if (worker == nullptr) {
+        worker = new std::thread(&RewindBuffer::encode_snapshots, this);
+    }
+
+    snapshot_into(incoming, cpu, gpu, memory);
+    pending = true;
+
+    guard.unlock();
+    changed.notify_all();
+}
+
+bool RewindBuffer::step_back() {
+    wait();
+    frames = 0;
+
+    if (!has_newest) {
+        return false;
+    }
+    restore_from(newest, cpu, gpu, memory);
+
+    if (num_deltas > 0) {
+        num_deltas -= 1;
+        xor_delta_apply(deltas[(first_delta + num_deltas) % deltas.size()], newest, size);
+    }
+    else {
+        has_newest = false;
+    }
+    return true;
+}
+
+void RewindBuffer::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return !pending; });
+}
+
+size_t RewindBuffer::get_num_snapshots() {
+    wait();
+    return has_newest ? num_deltas + 1 : 0;
+}
+
+size_t RewindBuffer::get_delta_bytes() {
+    wait();
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < num_deltas; i++) {
+        bytes += deltas[(first_delta + i) % deltas.size()].size();
+    }
+    return bytes;
+}
+
+void RewindBuffer::add_snapshot() {
+    if (has_newest) {
+        // Make room by forgetting the oldest snapshot.
+        if (num_deltas == deltas.size()) {
+            first_delta = (first_delta + 1) % deltas.size();
+            num_deltas -= 1;
+        }
+        xor_delta_encode(newest, incoming, size, deltas[(first_delta + num_deltas) % deltas.size()]);
+        num_deltas += 1;
+    }
+
+    std::swap(newest, incoming);
+    has_newest = true;
+}
+
+void RewindBuffer::encode_snapshots() {
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (true) {
+        changed.wait(guard, [this] { return stopping or pending; });
+        if (stopping) {
+            return;
+        }
+
+        guard.unlock();
+        add_snapshot();
+        guard.lock();
+
+        pending = false;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,163 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Keeps the last few seconds of snapshots, so that the game can be played
+ * backwards.
+ *
+ * A snapshot is taken every few frames. Only the newest snapshot is kept in
+ * full. Every older snapshot is kept as a delta: the XOR of the snapshot and
+ * the one after it, with the unchanged bytes (which XOR to zero) run length
+ * encoded away. Most of the machine doesn't change from one frame to the
+ * next, so a delta usually takes a few hundred bytes.
+ *
+ * A delta is encoded as a list of runs:
+ *
+ *  N bytes  The number of unchanged bytes before the run, as a LEB128 varint.
+ *  N bytes  The number of bytes in the run, as a LEB128 varint.
+ *  N bytes  The XOR of each byte of the run.
+ *
+ * Stepping back restores the newest snapshot, then XORs the last delta into
+ * it, which only touches the bytes that changed, to get the snapshot before.
+ * Encoding the deltas is done on a worker thread.
+ */
+
+#ifndef GAME_BOY_EMULATOR_REWIND_H
+#define GAME_BOY_EMULATOR_REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "save_state.h"
+
+// The number of frames in a second, used to size the buffer.
+#define REWIND_FRAME_RATE 60
+
+// The number of unchanged bytes in a row that end a run of a delta. Shorter
+// gaps are cheaper to store in the run than to start a new one.
+#define REWIND_MIN_GAP 8
+
+using namespace std;
+
+/*
+ * Encode the bytes that differ between two blocks of memory.
+ *
+ * @param from: The first block.
+ * @param to: The second block.
+ * @param length: The size of each block in bytes.
+ * @param out: Set to the delta, reusing its memory.
+ */
+void xor_delta_encode(const uint8_t *from, const uint8_t *to, size_t length, vector<uint8_t> & out);
+
+/*
+ * XOR a delta into a block of memory, turning one of the blocks it was
+ * encoded from into the other.
+ *
+ * @param delta: The delta, encoded by xor_delta_encode.
+ * @param data: The block to change.
+ * @param length: The size of the block in bytes.
+ * @return: False if the delta is corrupt or runs past the end of the block.
+ */
+bool xor_delta_apply(const vector<uint8_t> & delta, uint8_t *data, size_t length);
+
+/*
+ * A ring of snapshots of a machine, for rewinding it.
+ *
+ * Example usage:
+ *
+ *  RewindBuffer rewind(cpu, gpu, memory, 10, 1);
+ *  // At the end of each frame:
+ *  if (rewinding) {
+ *      rewind.step_back();
+ *  }
+ *  else {
+ *      rewind.frame_ended();
+ *  }
+ */
+class RewindBuffer {
+
+private:
+
+    CPU & cpu;
+    GPU & gpu;
+    Memory & memory;
+
+    // The number of frames between snapshots, and the frames since the last.
+    int interval;
+    int frames;
+
+    size_t size; // The size of a snapshot in bytes.
+
+    // The last snapshot taken, in full, if has_newest is set.
+    uint8_t *newest;
+    bool has_newest;
+
+    // A snapshot handed to the worker thread to encode.
+    uint8_t *incoming;
+
+    // A ring of deltas, oldest first. The delta at each position turns the
+    // snapshot after it into the snapshot it was taken after. The memory of
+    // each delta is reused once the ring is full.
+    vector<vector<uint8_t>> deltas;
+    size_t first_delta;
+    size_t num_deltas;
+
+    std::thread *worker;
+    std::mutex lock;
+    std::condition_variable changed;
+
+    // True from when a snapshot is handed over until the worker has encoded it.
+    bool pending;
+    bool stopping;
+
+    void add_snapshot();
+    void encode_snapshots();
+
+public:
+
+    /*
+     * @param seconds: How far back the game can be rewound.
+     * @param interval: The number of frames between snapshots.
+     */
+    RewindBuffer(CPU & cpu, GPU & gpu, Memory & memory, int seconds, int interval);
+
+    /*
+     * Stop the worker thread, if it was started.
+     */
+    ~RewindBuffer();
+
+    /*
+     * Take a snapshot if it is due, and hand it to the worker thread to be
+     * encoded. Waits for the last snapshot to be encoded first. Should be
+     * called at the end of every frame that isn't spent stepping back.
+     */
+    void frame_ended();
+
+    /*
+     * Restore the machine to the newest snapshot, and drop that snapshot so
+     * that the next step goes further back.
+     *
+     * @return: False if there are no snapshots left.
+     */
+    bool step_back();
+
+    /*
+     * Wait for the worker thread to encode the last snapshot.
+     */
+    void wait();
+
+    /*
+     * @return: The number of snapshots that can be stepped back to.
+     */
+    size_t get_num_snapshots();
+
+    /*
+     * @return: The number of bytes taken by the encoded deltas.
+     */
+    size_t get_delta_bytes();
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <cstdio>
+
+#include "save_state.h"
+
+void save_state(StateWriter & writer, CPU & cpu, GPU & gpu, Memory & memory) {
+    // Snapshots are read back in this order, so it has to match load_state.
+    writer.begin(memory.cartridge.rom_hash());
+
+    writer.begin_chunk("CPU ");
+    cpu.save_state(writer);
+    writer.end_chunk();
+
+    writer.begin_chunk("MEM ");
+    memory.save_state(writer);
+    writer.end_chunk();
+
+    writer.begin_chunk("CART");
+    memory.cartridge.save_state(writer);
+    writer.end_chunk();
+
+    writer.begin_chunk("GPU ");
+    gpu.save_state(writer);
+    writer.end_chunk();
+}
+
+/*
+ * Open a chunk, and check that it is the size the component saves.
+ *
+ * @return: False if the state has no such chunk, or it is the wrong size.
+ */
+template <typename T>
+static bool check_chunk(StateReader & reader, const char *id, T & component) {
+    StateWriter counter(nullptr);
+    component.save_state(counter);
+    return reader.open_chunk(id) and reader.chunk_has_size(counter.get_size());
+}
+
+LoadResult load_state(StateReader & reader, CPU & cpu, GPU & gpu, Memory & memory) {
+    if (!reader.is_valid()) {
+        return STATE_INVALID;
+    }
+    if (reader.get_version() != STATE_VERSION) {
+        return STATE_WRONG_VERSION;
+    }
+    if (reader.get_rom_hash() != memory.cartridge.rom_hash()) {
+        return STATE_WRONG_ROM;
+    }
+
+    // Every part of the machine saves a fixed number of bytes, so a chunk of
+    // the right size can't run out part way through loading it.
+    if (!check_chunk(reader, "CPU ", cpu) or !check_chunk(reader, "MEM ", memory) or
+        !check_chunk(reader, "CART", memory.cartridge) or !check_chunk(reader, "GPU ", gpu)) {
+        return STATE_INVALID;
+    }
+
+    // The GPU picks up the write generations of the restored memory, so
+    // memory has to come first.
+    bool loaded = reader.open_chunk("CPU ") and cpu.load_state(reader) and reader.chunk_finished() and
+                  reader.open_chunk("MEM ") and memory.load_state(reader) and reader.chunk_finished() and
+                  reader.open_chunk("CART") and memory.cartridge.load_state(reader) and reader.chunk_finished() and
+                  reader.open_chunk("GPU ") and gpu.load_state(reader) and reader.chunk_finished();
+    return loaded ? STATE_LOADED : STATE_INVALID;
+}
+
+size_t snapshot_size(CPU & cpu, GPU & gpu, Memory & memory) {
+    StateWriter writer(nullptr);
+    save_state(writer, cpu, gpu, memory);
+    return writer.get_size();
+}
+
+void snapshot_into(void *arena, CPU & cpu, GPU & gpu, Memory & memory) {
+    StateWriter writer(arena);
+    save_state(writer, cpu, gpu, memory);
+}
+
+bool restore_from(const void *arena, CPU & cpu, GPU & gpu, Memory & memory) {
+    StateReader reader(arena);
+    return load_state(reader, cpu, gpu, memory) == STATE_LOADED;
+}
+
+const char *load_result_message(LoadResult result) {
+    switch (result) {
+        case STATE_LOADED:
+            return "The state was loaded";
+        case STATE_INVALID:
+            return "The state is damaged";
+        case STATE_WRONG_VERSION:
+            return "The state was saved by a different version of the emulator";
+        case STATE_WRONG_ROM:
+            return "The state was saved from a different ROM";
+    }
+    return "";
+}
+
+bool write_state_file(const char *path, StateWriter & writer) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(writer.get_data(), 1, writer.get_size(), file) == writer.get_size();
+    return fclose(file) == 0 and written;
+}
+
+bool read_state_file(const char *path, vector<uint8_t> & data) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    data.clear();
+    uint8_t block[4096];
+    size_t length;
+    while ((length = fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + length);
+    }
+    bool read = !ferror(file);
+    fclose(file);
+    return read;
+}
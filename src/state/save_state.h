@@ -0,0 +1,104 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Saves and loads the state of the whole machine. See state_format.h for the
+ * layout of a save state.
+ */
+
+#ifndef GAME_BOY_EMULATOR_SAVE_STATE_H
+#define GAME_BOY_EMULATOR_SAVE_STATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "state_format.h"
+#include "../cpu/cpu.h"
+#include "../gpu/gpu.h"
+#include "../memory/memory.h"
+
+using namespace std;
+
+/*
+ * The result of loading a save state.
+ */
+enum LoadResult {
+    STATE_LOADED,
+    STATE_INVALID, // The state is cut short, or a checksum doesn't match.
+    STATE_WRONG_VERSION, // The state was saved by a different version.
+    STATE_WRONG_ROM, // The state was saved while running a different ROM.
+};
+
+/*
+ * Save the state of the machine. Only the banks and RAM of the cartridge are
+ * saved, not the ROM.
+ *
+ * Example usage:
+ *
+ *  StateWriter writer;
+ *  save_state(writer, cpu, gpu, memory);
+ *  write_state_file("game.gbstate", writer);
+ *
+ * @param writer: Receives the state, replacing the state it held before.
+ */
+void save_state(StateWriter & writer, CPU & cpu, GPU & gpu, Memory & memory);
+
+/*
+ * Load the state of the machine. The machine has to be running the ROM the
+ * state was saved from. Nothing is changed unless the state is valid.
+ *
+ * @param reader: The state to load.
+ * @return: STATE_LOADED, or the reason the state couldn't be loaded.
+ */
+LoadResult load_state(StateReader & reader, CPU & cpu, GPU & gpu, Memory & memory);
+
+/*
+ * @return: The size of a snapshot of the machine in bytes. This doesn't
+ * change while the same ROM is running.
+ */
+size_t snapshot_size(CPU & cpu, GPU & gpu, Memory & memory);
+
+/*
+ * Copy the state of the machine into a buffer, without allocating. The ROM
+ * isn't copied, the snapshot only records its hash.
+ *
+ * Example usage:
+ *
+ *  vector<uint8_t> arena(snapshot_size(cpu, gpu, memory));
+ *  snapshot_into(arena.data(), cpu, gpu, memory);
+ *  // Run the machine.
+ *  restore_from(arena.data(), cpu, gpu, memory);
+ *
+ * @param arena: Receives the snapshot. Has to hold snapshot_size bytes.
+ */
+void snapshot_into(void *arena, CPU & cpu, GPU & gpu, Memory & memory);
+
+/*
+ * Restore the machine from a snapshot, without allocating.
+ *
+ * @param arena: A snapshot taken by snapshot_into.
+ * @return: False, without changing the machine, if the snapshot was taken
+ * while running a different ROM.
+ */
+bool restore_from(const void *arena, CPU & cpu, GPU & gpu, Memory & memory);
+
+/*
+ * @return: A description of the result of loading a save state.
+ */
+const char *load_result_message(LoadResult result);
+
+/*
+ * Write a save state to a file.
+ *
+ * @return: False if the file couldn't be written.
+ */
+bool write_state_file(const char *path, StateWriter & writer);
+
+/*
+ * Read a save state from a file.
+ *
+ * @param data: Set to the contents of the file.
+ * @return: False if the file couldn't be read.
+ */
+bool read_state_file(const char *path, vector<uint8_t> & data);
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#include "state_format.h"
+#include "../util/hash.h"
+
+StateWriter::StateWriter() {
+    chunk_start = 0;
+    num_chunks = 0;
+    snapshot = false;
+    arena = nullptr;
+    position = 0;
+}
+
+StateWriter::StateWriter(void *arena) {
+    chunk_start = 0;
+    num_chunks = 0;
+    snapshot = true;
+    this->arena = static_cast<uint8_t *>(arena);
+    position = 0;
+}
+
+void StateWriter::begin(uint64_t rom_hash) {
+    if (snapshot) {
+        position = 0;
+        write(&rom_hash, sizeof(rom_hash));
+        return;
+    }
+
+    uint32_t version = STATE_VERSION;
+
+    data.resize(STATE_HEADER_SIZE);
+    memcpy(data.data(), STATE_MAGIC, 8);
+    memcpy(data.data() + 8, &version, 4);
+    memcpy(data.data() + 16, &rom_hash, 8);
+
+    num_chunks = 0;
+    memcpy(data.data() + 12, &num_chunks, 4);
+}
+
+void StateWriter::begin_chunk(const char *id) {
+    if (snapshot) {
+        return;
+    }
+    chunk_start = data.size();
+    data.resize(chunk_start + STATE_CHUNK_HEADER_SIZE);
+    memcpy(data.data() + chunk_start, id, STATE_CHUNK_ID_SIZE);
+}
+
+void StateWriter::write(const void *data, size_t length) {
+    if (snapshot) {
+        if (arena != nullptr) {
+            memcpy(arena + position, data, length);
+        }
+        position += length;
+        return;
+    }
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    this->data.insert(this->data.end(), bytes, bytes + length);
+}
+
+void StateWriter::end_chunk() {
+    if (snapshot) {
+        return;
+    }
+
+    uint8_t *header = data.data() + chunk_start;
+    uint32_t size = data.size() - chunk_start - STATE_CHUNK_HEADER_SIZE;
+    uint64_t checksum = hash64(header + STATE_CHUNK_HEADER_SIZE, size);
+
+    memcpy(header + 4, &size, 4);
+    memcpy(header + 8, &checksum, 8);
+
+    num_chunks += 1;
+    memcpy(data.data() + 12, &num_chunks, 4);
+}
+
+const uint8_t *StateWriter::get_data() {
+    return snapshot ? arena : data.data();
+}
+
+size_t StateWriter::get_size() {
+    return snapshot ? position : data.size();
+}
+
+StateReader::StateReader(const uint8_t *data, size_t size) {
+    this->data = data;
+    this->size = size;
+    valid = false;
+    version = 0;
+    rom_hash = 0;
+    chunk = nullptr;
+    chunk_size = 0;
+    position = 0;
+    snapshot = false;
+
+    if (size < STATE_HEADER_SIZE or memcmp(data, STATE_MAGIC, 8) != 0) {
+        return;
+    }
+
+    uint32_t num_chunks;
+    memcpy(&version, data + 8, 4);
+    memcpy(&num_chunks, data + 12, 4);
+    memcpy(&rom_hash, data + 16, 8);
+
+    size_t offset = STATE_HEADER_SIZE;
+    for (uint32_t i = 0; i < num_chunks; i++) {
+        uint32_t length;
+        uint64_t checksum;
+        if (size - offset < STATE_CHUNK_HEADER_SIZE) {
+            return;
+        }
+        memcpy(&length, data + offset + 4, 4);
+        memcpy(&checksum, data + offset + 8, 8);
+
+        offset += STATE_CHUNK_HEADER_SIZE;
+        if (size - offset < length or hash64(data + offset, length) != checksum) {
+            return;
+        }
+        offset += length;
+    }
+    valid = offset == size;
+}
+
+StateReader::StateReader(const void *arena) {
+    data = static_cast<const uint8_t *>(arena);
+    size = SIZE_MAX;
+    valid = true;
+    version = STATE_VERSION;
+    memcpy(&rom_hash, data, sizeof(rom_hash));
+
+    // The whole snapshot is read as one chunk.
+    chunk = data + sizeof(rom_hash);
+    chunk_size = SIZE_MAX;
+    position = 0;
+    snapshot = true;
+}
+
+bool StateReader::is_valid() {
+    return valid;
+}
+
+uint32_t StateReader::get_version() {
+    return version;
+}
+
+uint64_t StateReader::get_rom_hash() {
+    return rom_hash;
+}
+
+bool StateReader::open_chunk(const char *id) {
+    if (snapshot) {
+        return true;
+    }
+    if (!valid) {
+        return false;
+    }
+
+    size_t offset = STATE_HEADER_SIZE;
+    while (offset < size) {
+        uint32_t length;
+        memcpy(&length, data + offset + 4, 4);
+
+        if (memcmp(data + offset, id, STATE_CHUNK_ID_SIZE) == 0) {
+            chunk = data + offset + STATE_CHUNK_HEADER_SIZE;
+            chunk_size = length;
+            position = 0;
+            return true;
+        }
+        offset += STATE_CHUNK_HEADER_SIZE + length;
+    }
+    return false;
+}
+
+bool StateReader::read(void *out, size_t length) {
+    if (chunk == nullptr or chunk_size - position < length) {
+        return false;
+    }
+    memcpy(out, chunk + position, length);
+    position += length;
+    return true;
+}
+
+bool StateReader::chunk_has_size(size_t size) {
+    return snapshot or (chunk != nullptr and chunk_size == size);
+}
+
+bool StateReader::chunk_finished() {
+    return snapshot or (chunk != nullptr and position == chunk_size);
+}
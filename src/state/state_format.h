@@ -0,0 +1,215 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * The binary format of save states.
+ *
+ * A save state starts with a header:
+ *
+ *  8 bytes  "GBSTATE\0"
+ *  4 bytes  The version of the format (STATE_VERSION).
+ *  4 bytes  The number of chunks.
+ *  8 bytes  The hash of the ROM the state was saved from.
+ *
+ * followed by a chunk for each part of the machine:
+ *
+ *  4 bytes  The ID of the chunk, such as "CPU ".
+ *  4 bytes  The size of the data.
+ *  8 bytes  The checksum of the data.
+ *  N bytes  The data.
+ *
+ * Numbers are stored in the host's byte order. The data of each chunk is a
+ * few blocks of plain data, such as the RAM or the timer, copied as they are
+ * laid out in memory, so that saving and loading are a handful of memcpy
+ * calls. The version has to change whenever one of those layouts does.
+ *
+ * The checksum is hash64 rather than a CRC, since it runs at close to memory
+ * bandwidth, and so costs about as much as copying the data.
+ *
+ * A snapshot is a save state written into a buffer provided by the caller,
+ * for restoring the machine many times a second. It is just the hash of the
+ * ROM followed by the data of each chunk, with no headers or checksums, and
+ * is only meant to be restored by the same build of the emulator.
+ */
+
+#ifndef GAME_BOY_EMULATOR_STATE_FORMAT_H
+#define GAME_BOY_EMULATOR_STATE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define STATE_MAGIC "GBSTATE"
+#define STATE_VERSION 1
+
+#define STATE_HEADER_SIZE 24
+#define STATE_CHUNK_HEADER_SIZE 16
+#define STATE_CHUNK_ID_SIZE 4
+
+using namespace std;
+
+/*
+ * Builds a save state in memory, one chunk at a time. The memory is kept from
+ * one state to the next, so saving over and over doesn't allocate. Can also
+ * write a snapshot into a buffer instead, which never allocates.
+ *
+ * Example usage:
+ *
+ *  StateWriter writer;
+ *  writer.begin(cartridge.rom_hash());
+ *  writer.begin_chunk("CPU ");
+ *  writer.write(&registers, sizeof(registers));
+ *  writer.end_chunk();
+ */
+class StateWriter {
+
+private:
+
+    vector<uint8_t> data;
+
+    // The offset of the header of the chunk being written.
+    size_t chunk_start;
+    uint32_t num_chunks;
+
+    // Where a snapshot is written, and how much of it has been written.
+    bool snapshot;
+    uint8_t *arena;
+    size_t position;
+
+public:
+
+    StateWriter();
+
+    /*
+     * Create a writer that writes a snapshot into a buffer.
+     *
+     * @param arena: Where to write the snapshot. It has to be large enough to
+     * hold the snapshot. If nullptr, the size of the snapshot is counted but
+     * nothing is written.
+     */
+    StateWriter(void *arena);
+
+    /*
+     * Start a new state, dropping the last one.
+     *
+     * @param rom_hash: The hash of the ROM the state is saved from.
+     */
+    void begin(uint64_t rom_hash);
+
+    /*
+     * Start a chunk.
+     *
+     * @param id: The 4 character ID of the chunk.
+     */
+    void begin_chunk(const char *id);
+
+    /*
+     * Add data to the current chunk. A snapshot is written straight into the
+     * arena.
+     */
+    void write(const void *data, size_t length);
+
+    /*
+     * Finish the current chunk, filling in its size and checksum.
+     */
+    void end_chunk();
+
+    /*
+     * @return: The state, which is complete once every chunk has ended, or
+     * the arena and the size of the snapshot written to it.
+     */
+    const uint8_t *get_data();
+    size_t get_size();
+};
+
+/*
+ * Reads a save state built by a StateWriter. The state is checked when the
+ * reader is created, and the data is read in place.
+ *
+ * Example usage:
+ *
+ *  StateReader reader(data, size);
+ *  if (reader.is_valid() and reader.open_chunk("CPU ")) {
+ *      reader.read(&registers, sizeof(registers));
+ *  }
+ */
+class StateReader {
+
+private:
+
+    const uint8_t *data;
+    size_t size;
+
+    bool valid;
+    uint32_t version;
+    uint64_t rom_hash;
+
+    // The data of the open chunk, and how much of it has been read.
+    const uint8_t *chunk;
+    size_t chunk_size;
+    size_t position;
+
+    bool snapshot;
+
+public:
+
+    /*
+     * @param data: The state. It isn't copied, so has to outlive the reader.
+     * @param size: The size of the state in bytes.
+     */
+    StateReader(const uint8_t *data, size_t size);
+
+    /*
+     * Create a reader for a snapshot. Nothing is checked, and the chunks have
+     * to be opened and read in the order they were written.
+     *
+     * @param arena: The snapshot, written by a StateWriter with an arena.
+     */
+    StateReader(const void *arena);
+
+    /*
+     * @return: True if the state has the right header, and every chunk is
+     * whole and matches its checksum.
+     */
+    bool is_valid();
+
+    /*
+     * @return: The version of the format the state was saved with.
+     */
+    uint32_t get_version();
+
+    /*
+     * @return: The hash of the ROM the state was saved from.
+     */
+    uint64_t get_rom_hash();
+
+    /*
+     * Start reading a chunk.
+     *
+     * @param id: The 4 character ID of the chunk.
+     * @return: False if the state has no such chunk.
+     */
+    bool open_chunk(const char *id);
+
+    /*
+     * Read the next part of the open chunk.
+     *
+     * @param out: Where to copy the data to.
+     * @param length: The number of bytes to copy.
+     * @return: False, without copying anything, if the chunk is too short.
+     */
+    bool read(void *out, size_t length);
+
+    /*
+     * @return: True if the open chunk is a number of bytes long. Always true
+     * for a snapshot, which doesn't record its size.
+     */
+    bool chunk_has_size(size_t size);
+
+    /*
+     * @return: True if all of the open chunk has been read. Always true for a
+     * snapshot.
+     */
+    bool chunk_finished();
+};
+
+#endif
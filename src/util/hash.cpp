@@ -0,0 +1,266 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash.h"
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define NUM_LANES 8
+
+// Pseudo random key material that the input is mixed with.
+static const uint64_t secret_words[HASH_SECRET_SIZE / 8] = {
+    0x2CB0F69F4ABEA221ULL, 0x9417034723148989ULL, 0xDD555950609DFE03ULL,
+    0xDBAFB150DEB12800ULL, 0x7E789B2E6C442CB6ULL, 0xF41E5636C7E4F8C4ULL,
+    0x0959D150F8FBA7E4ULL, 0xA97316F13CDB9EEAULL, 0x74CD8258F9520068ULL,
+    0x55C74A62E116868BULL, 0xD2F4C799A2023CBDULL, 0xDF98CB79A37B51B9ULL,
+    0x396F5885524F3905ULL, 0xAF1D56386CA3B276ULL, 0xA9FFBE6B5104E85AULL,
+    0x6BD0C51B9FD533B3ULL, 0x980CE91C50AB4B56ULL, 0x28AC395780FE62C5ULL,
+    0x768912E3A6BCEDC7ULL, 0x50B3E8C9332C7C88ULL, 0xCE3BBFE520BD47DAULL,
+    0xCBA6C8E8E0BB7C4FULL, 0xBF194DB8434A346DULL, 0x7D8F2A7B60416D7FULL,
+};
+
+static const uint8_t *secret = reinterpret_cast<const uint8_t *>(secret_words);
+
+/*
+ * Mix num_stripes consecutive stripes into the accumulators. The key for
+ * each stripe starts 8 bytes after the key for the previous stripe.
+ */
+typedef void (*AccumulateFunction)(uint64_t *acc, const uint8_t *data,
+                                   size_t num_stripes, const uint8_t *key);
+
+/*
+ * Scramble the accumulators so that the bits of each lane are spread out
+ * before the next block is accumulated.
+ */
+typedef void (*ScrambleFunction)(uint64_t *acc, const uint8_t *key);
+
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t multiply_fold64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static void accumulate_scalar(uint64_t *acc, const uint8_t *data,
+                              size_t num_stripes, const uint8_t *key) {
+    for (size_t s = 0; s < num_stripes; s++) {
+        const uint8_t *stripe = data + s * HASH_STRIPE_SIZE;
+        const uint8_t *stripe_key = key + s * 8;
+
+        for (int i = 0; i < NUM_LANES; i++) {
+            uint64_t value = read64(stripe + i * 8);
+            uint64_t data_key = value ^ read64(stripe_key + i * 8);
+
+            acc[i ^ 1] += value;
+            acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+        }
+    }
+}
+
+static void scramble_scalar(uint64_t *acc, const uint8_t *key) {
+    for (int i = 0; i < NUM_LANES; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(key + i * 8);
+        a *= PRIME32_1;
+        acc[i] = a;
+    }
+}
+
+#if defined(__AVX2__)
+
+static void accumulate_vector(uint64_t *acc, const uint8_t *data,
+                              size_t num_stripes, const uint8_t *key) {
+    __m256i *lanes = reinterpret_cast<__m256i *>(acc);
+    __m256i acc_0 = _mm256_loadu_si256(lanes);
+    __m256i acc_1 = _mm256_loadu_si256(lanes + 1);
+
+    for (size_t s = 0; s < num_stripes; s++) {
+        const __m256i *stripe = reinterpret_cast<const __m256i *>(data + s * HASH_STRIPE_SIZE);
+        const __m256i *stripe_key = reinterpret_cast<const __m256i *>(key + s * 8);
+
+        __m256i value_0 = _mm256_loadu_si256(stripe);
+        __m256i value_1 = _mm256_loadu_si256(stripe + 1);
+        __m256i data_key_0 = _mm256_xor_si256(value_0, _mm256_loadu_si256(stripe_key));
+        __m256i data_key_1 = _mm256_xor_si256(value_1, _mm256_loadu_si256(stripe_key + 1));
+
+        // Multiply the low and high 32 bits of each lane.
+        __m256i product_0 = _mm256_mul_epu32(data_key_0, _mm256_srli_epi64(data_key_0, 32));
+        __m256i product_1 = _mm256_mul_epu32(data_key_1, _mm256_srli_epi64(data_key_1, 32));
+
+        // Add each value to the neighbouring lane.
+        acc_0 = _mm256_add_epi64(acc_0, _mm256_shuffle_epi32(value_0, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc_1 = _mm256_add_epi64(acc_1, _mm256_shuffle_epi32(value_1, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc_0 = _mm256_add_epi64(acc_0, product_0);
+        acc_1 = _mm256_add_epi64(acc_1, product_1);
+    }
+
+    _mm256_storeu_si256(lanes, acc_0);
+    _mm256_storeu_si256(lanes + 1, acc_1);
+}
+
+static void scramble_vector(uint64_t *acc, const uint8_t *key) {
+    __m256i *lanes = reinterpret_cast<__m256i *>(acc);
+    const __m256i *keys = reinterpret_cast<const __m256i *>(key);
+    const __m256i prime = _mm256_set1_epi32(PRIME32_1);
+
+    for (int i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256(lanes + i);
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256(keys + i));
+
+        // 64 x 32 bit multiply, built from two 32 x 32 -> 64 bit multiplies.
+        __m256i product_lo = _mm256_mul_epu32(a, prime);
+        __m256i product_hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        a = _mm256_add_epi64(product_lo, _mm256_slli_epi64(product_hi, 32));
+        _mm256_storeu_si256(lanes + i, a);
+    }
+}
+
+#elif defined(__SSE2__)
+
+static inline __m128i accumulate_lanes(__m128i acc, const __m128i *stripe, const __m128i *key) {
+    __m128i value = _mm_loadu_si128(stripe);
+    __m128i data_key = _mm_xor_si128(value, _mm_loadu_si128(key));
+
+    // Multiply the low and high 32 bits of each lane.
+    __m128i product = _mm_mul_epu32(data_key, _mm_srli_epi64(data_key, 32));
+
+    // Add each value to the neighbouring lane.
+    acc = _mm_add_epi64(acc, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_add_epi64(acc, product);
+}
+
+static void accumulate_vector(uint64_t *acc, const uint8_t *data,
+                              size_t num_stripes, const uint8_t *key) {
+    __m128i *lanes = reinterpret_cast<__m128i *>(acc);
+    __m128i acc_0 = _mm_loadu_si128(lanes);
+    __m128i acc_1 = _mm_loadu_si128(lanes + 1);
+    __m128i acc_2 = _mm_loadu_si128(lanes + 2);
+    __m128i acc_3 = _mm_loadu_si128(lanes + 3);
+
+    for (size_t s = 0; s < num_stripes; s++) {
+        const __m128i *stripe = reinterpret_cast<const __m128i *>(data + s * HASH_STRIPE_SIZE);
+        const __m128i *stripe_key = reinterpret_cast<const __m128i *>(key + s * 8);
+
+        acc_0 = accumulate_lanes(acc_0, stripe, stripe_key);
+        acc_1 = accumulate_lanes(acc_1, stripe + 1, stripe_key + 1);
+        acc_2 = accumulate_lanes(acc_2, stripe + 2, stripe_key + 2);
+        acc_3 = accumulate_lanes(acc_3, stripe + 3, stripe_key + 3);
+    }
+
+    _mm_storeu_si128(lanes, acc_0);
+    _mm_storeu_si128(lanes + 1, acc_1);
+    _mm_storeu_si128(lanes + 2, acc_2);
+    _mm_storeu_si128(lanes + 3, acc_3);
+}
+
+static void scramble_vector(uint64_t *acc, const uint8_t *key) {
+    __m128i *lanes = reinterpret_cast<__m128i *>(acc);
+    const __m128i *keys = reinterpret_cast<const __m128i *>(key);
+    const __m128i prime = _mm_set1_epi32(PRIME32_1);
+
+    for (int i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128(lanes + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128(keys + i));
+
+        // 64 x 32 bit multiply, built from two 32 x 32 -> 64 bit multiplies.
+        __m128i product_lo = _mm_mul_epu32(a, prime);
+        __m128i product_hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        a = _mm_add_epi64(product_lo, _mm_slli_epi64(product_hi, 32));
+        _mm_storeu_si128(lanes + i, a);
+    }
+}
+
+#else
+
+#define accumulate_vector accumulate_scalar
+#define scramble_vector scramble_scalar
+
+#endif
+
+static uint64_t hash(const uint8_t *data, size_t length,
+                     AccumulateFunction accumulate, ScrambleFunction scramble) {
+    uint64_t acc[NUM_LANES] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                               PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+    const uint8_t *scramble_key = secret + HASH_SECRET_SIZE - HASH_STRIPE_SIZE;
+
+    if (length <= HASH_STRIPE_SIZE) {
+        // Short inputs are zero padded. The length is mixed in below, so
+        // inputs that only differ by trailing zeros still hash differently.
+        uint8_t stripe[HASH_STRIPE_SIZE] = {0};
+        if (length > 0) {
+            memcpy(stripe, data, length);
+        }
+        accumulate(acc, stripe, 1, secret);
+    }
+    else {
+        size_t num_blocks = (length - 1) / HASH_BLOCK_SIZE;
+        for (size_t b = 0; b < num_blocks; b++) {
+            accumulate(acc, data + b * HASH_BLOCK_SIZE, HASH_STRIPES_PER_BLOCK, secret);
+            scramble(acc, scramble_key);
+        }
+
+        // Accumulate the remaining full stripes, then the last 64 bytes of the
+        // input. The last stripe may overlap with the stripe before it.
+        size_t offset = num_blocks * HASH_BLOCK_SIZE;
+        size_t num_stripes = (length - 1 - offset) / HASH_STRIPE_SIZE;
+        accumulate(acc, data + offset, num_stripes, secret);
+        accumulate(acc, data + length - HASH_STRIPE_SIZE, 1, scramble_key - 7);
+    }
+
+    uint64_t result = length * PRIME64_1;
+    for (int i = 0; i < NUM_LANES / 2; i++) {
+        const uint8_t *key = secret + 11 + i * 16;
+        result += multiply_fold64(acc[2 * i] ^ read64(key), acc[2 * i + 1] ^ read64(key + 8));
+    }
+    return avalanche(result);
+}
+
+uint64_t hash64(const void *data, size_t length) {
+    return hash(static_cast<const uint8_t *>(data), length, accumulate_vector, scramble_vector);
+}
+
+uint64_t hash64_scalar(const void *data, size_t length) {
+    return hash(static_cast<const uint8_t *>(data), length, accumulate_scalar, scramble_scalar);
+}
@@ -0,0 +1,41 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * A fast 64-bit hash function, used to compare frames, screen lines and
+ * machine state.
+ *
+ * The hash follows the design of XXH3: the input is split into 64 byte
+ * stripes, and each stripe is mixed into 8 independent 64-bit accumulators
+ * using a 32 x 32 -> 64 bit multiply. There is no dependency between the
+ * lanes of a stripe, so the loop maps directly on to SSE2 or AVX2 registers
+ * and runs at close to memory bandwidth. The accumulators are scrambled once
+ * every block of stripes and merged with a 128-bit multiply at the end.
+ */
+
+#ifndef GAME_BOY_EMULATOR_HASH_H
+#define GAME_BOY_EMULATOR_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define HASH_STRIPE_SIZE 64
+#define HASH_SECRET_SIZE 192
+#define HASH_STRIPES_PER_BLOCK ((HASH_SECRET_SIZE - HASH_STRIPE_SIZE) / 8)
+#define HASH_BLOCK_SIZE (HASH_STRIPE_SIZE * HASH_STRIPES_PER_BLOCK)
+
+/*
+ * Compute the 64-bit hash of a block of memory. Uses the widest vector
+ * instructions that the emulator was compiled with.
+ *
+ * @param data: The memory to hash.
+ * @param length: The number of bytes to hash.
+ * @return: The 64-bit hash of the data.
+ */
+uint64_t hash64(const void *data, size_t length);
+
+/*
+ * Compute the same hash as hash64 without using vector instructions.
+ */
+uint64_t hash64_scalar(const void *data, size_t length);
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the APU registers, and the audio it sends to a sink.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/memory/memory.h"
+#include "../../src/apu/mixer.h"
+
+using namespace testing;
+
+/*
+ * Keeps every frame the APU sends it.
+ */
+class CaptureSink : public AudioSink {
+
+public:
+
+    vector<int16_t> frames;
+
+    void write_frames(const int16_t *data, int count) {
+        frames.insert(frames.end(), data, data + count * 2);
+    }
+};
+
+/*
+ * Run the APU for a number of cycles, one instruction at a time.
+ */
+static void run_apu(APU & apu, int cycles) {
+    for (int i = 0; i < cycles; i += 4) {
+        apu.tick(4);
+    }
+}
+
+/*
+ * Test that the write only bits of the registers read as 1.
+ */
+TEST(APU_Test, Register_Read_Masks) {
+    APU apu;
+    EXPECT_EQ(0xF1, apu.load_byte(NR_52));
+
+    apu.store_byte(NR_11, 0x00);
+    apu.store_byte(NR_13, 0x12);
+    apu.store_byte(NR_30, 0x00);
+    apu.store_byte(NR_50, 0x35);
+
+    EXPECT_EQ(0x3F, apu.load_byte(NR_11));
+    EXPECT_EQ(0xFF, apu.load_byte(NR_13));
+    EXPECT_EQ(0x7F, apu.load_byte(NR_30));
+    EXPECT_EQ(0x35, apu.load_byte(NR_50));
+    EXPECT_EQ(0xFF, apu.load_byte(0xFF2A));
+
+    apu.store_byte(0xFF30, 0x5A);
+    EXPECT_EQ(0x5A, apu.load_byte(0xFF30));
+
+    // Turning the APU off clears the registers and ignores writes to them.
+    apu.store_byte(NR_52, 0x00);
+    apu.store_byte(NR_50, 0x77);
+    EXPECT_EQ(0x70, apu.load_byte(NR_52));
+    EXPECT_EQ(0x00, apu.load_byte(NR_50));
+    EXPECT_EQ(0x5A, apu.load_byte(0xFF30));
+}
+
+/*
+ * Test that a channel turns itself off when its length counter runs out, with
+ * no sink connected.
+ */
+TEST(APU_Test, Length_Counter_Disables_Channel) {
+    APU apu;
+    apu.store_byte(NR_22, 0xF0);
+    apu.store_byte(NR_21, 0x3E);
+    apu.store_byte(NR_24, 0xC0);
+    EXPECT_EQ(0xF3, apu.load_byte(NR_52));
+
+    // The length counter is clocked every other frame sequencer step.
+    run_apu(apu, FRAME_SEQUENCER_PERIOD * 2);
+    EXPECT_EQ(0xF3, apu.load_byte(NR_52));
+
+    run_apu(apu, FRAME_SEQUENCER_PERIOD * 2);
+    EXPECT_EQ(0xF1, apu.load_byte(NR_52));
+}
+
+/*
+ * Test that a square wave comes out at the right pitch and level.
+ */
+TEST(APU_Test, Square_Wave_Output) {
+    APU apu;
+    CaptureSink sink;
+    apu.set_sink(&sink);
+
+    // A 50% duty square wave on channel 2 at about 1 kHz, in both speakers.
+    uint16_t frequency = 2048 - 131;
+    apu.store_byte(NR_51, 0x22);
+    apu.store_byte(NR_22, 0xF0);
+    apu.store_byte(NR_21, 0x80);
+    apu.store_byte(NR_23, frequency & 0xFF);
+    apu.store_byte(NR_24, 0x80 | (frequency >> 8));
+
+    run_apu(apu, APU_CLOCK_RATE);
+    apu.set_sink(nullptr);
+
+    int num_frames = sink.frames.size() / 2;
+    EXPECT_NEAR(AUDIO_SAMPLE_RATE, num_frames, AUDIO_BLOCK_FRAMES);
+
+    // Skip the first half second, while the level settles around 0.
+    int crossings = 0;
+    int peak = 0;
+    for (int i = num_frames / 2; i < num_frames; i++) {
+        int16_t left = sink.frames[2 * i];
+        int16_t right = sink.frames[2 * i + 1];
+        ASSERT_EQ(left, right);
+
+        if ((left >= 0) != (sink.frames[2 * i - 2] >= 0)) {
+            crossings += 1;
+        }
+        peak = max(peak, abs(left));
+    }
+
+    // Two zero crossings for each period of the wave.
+    double pitch = APU_CLOCK_RATE / (131.0 * 32);
+    EXPECT_NEAR(pitch * num_frames / AUDIO_SAMPLE_RATE, crossings, 4);
+
+    // Half the swing of a full volume channel, at the full master volume.
+    EXPECT_GT(peak, 3000);
+    EXPECT_LE(peak, INT16_MAX);
+}
+
+/*
+ * Test that a step is spread over several samples rather than jumping from
+ * one sample to the next, and that it ends up at the right level.
+ */
+TEST(APU_Test, Steps_Are_Band_Limited) {
+    for (uint32_t time = 1000; time < 1100; time += 7) {
+        StepBuffer buffer(AUDIO_BLOCK_FRAMES);
+        buffer.set_rates(APU_CLOCK_RATE, AUDIO_SAMPLE_RATE);
+        buffer.add_delta(time, 1000);
+        buffer.end_frame(4096);
+
+        int count = buffer.samples_avail();
+        vector<int32_t> samples(count);
+        buffer.read_samples(samples.data(), count);
+
+        // The step starts to ring a few samples before it happens, and no
+        // earlier than the width of the kernel.
+        int step = time * AUDIO_SAMPLE_RATE / APU_CLOCK_RATE;
+        int ringing = 0;
+        for (int i = 0; i < step + STEP_KERNEL_WIDTH / 2; i++) {
+            if (i <= step) {
+                ASSERT_EQ(0, samples[i]);
+            }
+            else if (samples[i] != 0) {
+                ringing += 1;
+            }
+        }
+        EXPECT_GE(ringing, 4);
+
+        // The level slowly returns to 0, so only check it is close.
+        EXPECT_NEAR(1000, samples[step + STEP_KERNEL_WIDTH + 1], 50);
+    }
+}
+
+/*
+ * Test that the channels are panned and scaled by NR50 and NR51, and that the
+ * 16 bit and float frames agree.
+ */
+TEST(APU_Test, Mixer_Pans_Channels) {
+    int count = 13;
+    vector<int32_t> samples(NUM_SOUND_CHANNELS * count);
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        for (int i = 0; i < count; i++) {
+            samples[channel * count + i] = (i + 1) * (channel + 1) * (channel % 2 ? -1 : 1) * 10;
+        }
+    }
+    // Loud enough to be clipped.
+    samples[count - 1] = 30000;
+
+    uint8_t nr50 = 0x72; // Left at 8, right at 3.
+    uint8_t nr51 = 0x96; // Channels 1 and 4 on the left, 2 and 3 on the right.
+    vector<int16_t> frames(count * 2);
+    vector<float> float_frames(count * 2);
+    mix_frames(samples.data(), count, count, nr50, nr51, frames.data());
+    mix_frames(samples.data(), count, count, nr50, nr51, float_frames.data());
+
+    for (int i = 0; i < count; i++) {
+        int32_t left = (samples[i] + samples[3 * count + i]) * 8;
+        int32_t right = (samples[count + i] + samples[2 * count + i]) * 3;
+
+        EXPECT_EQ(max(-32767, min(32767, left)), frames[2 * i]);
+        EXPECT_EQ(max(-32767, min(32767, right)), frames[2 * i + 1]);
+        EXPECT_FLOAT_EQ(frames[2 * i] / 32768.0f, float_frames[2 * i]);
+        EXPECT_FLOAT_EQ(frames[2 * i + 1] / 32768.0f, float_frames[2 * i + 1]);
+    }
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
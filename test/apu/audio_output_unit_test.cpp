@@ -0,0 +1,147 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the ring that carries audio to the audio thread, and the real time
+ * audio output.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/apu/apu.h"
+#include "../../src/apu/audio_output.h"
+
+using namespace testing;
+
+/*
+ * Test that frames come out of the ring in order when it wraps around, and
+ * that it never takes more than it has room for.
+ */
+TEST(Audio_Ring_Test, Wraps_Around) {
+    AudioRing ring;
+    vector<int16_t> in(AUDIO_RING_FRAMES * 2);
+    vector<int16_t> out(AUDIO_RING_FRAMES * 2);
+
+    // Start part of the way into the ring.
+    ring.write(in.data(), 100);
+    ring.read(out.data(), 100);
+
+    for (int n = 0; n < 10; n++) {
+        for (int i = 0; i < AUDIO_RING_FRAMES * 2; i++) {
+            in[i] = static_cast<int16_t>(n * 1000 + i);
+        }
+
+        int count = AUDIO_RING_FRAMES * 3 / 4;
+        ASSERT_EQ(count, ring.write(in.data(), count));
+        ASSERT_EQ(count, ring.get_fill());
+
+        // Only the rest of the ring fits.
+        ASSERT_EQ(AUDIO_RING_FRAMES - count, ring.write(&in[count * 2], AUDIO_RING_FRAMES));
+        ASSERT_EQ(AUDIO_RING_FRAMES, ring.get_fill());
+
+        ASSERT_EQ(AUDIO_RING_FRAMES, ring.read(out.data(), AUDIO_RING_FRAMES * 2));
+        ASSERT_EQ(in, out);
+        ASSERT_EQ(0, ring.read(out.data(), 1));
+    }
+}
+
+/*
+ * Test that a stream of frames arrives intact when written and read on two
+ * threads at once.
+ */
+TEST(Audio_Ring_Test, Two_Threads) {
+    AudioRing ring;
+    int total = AUDIO_RING_FRAMES * 200;
+
+    thread writer([&ring, total]() {
+        int16_t frames[2 * 100];
+        int sent = 0;
+        while (sent < total) {
+            int count = total - sent < 100 ? total - sent : 100;
+            for (int i = 0; i < count; i++) {
+                frames[2 * i] = static_cast<int16_t>(sent + i);
+                frames[2 * i + 1] = static_cast<int16_t>(~(sent + i));
+            }
+
+            int written = 0;
+            while (written < count) {
+                written += ring.write(frames + written * 2, count - written);
+                this_thread::yield();
+            }
+            sent += count;
+        }
+    });
+
+    int16_t frames[2 * 77];
+    int received = 0;
+    while (received < total) {
+        int count = ring.read(frames, 77);
+        for (int i = 0; i < count; i++) {
+            ASSERT_EQ(static_cast<int16_t>(received + i), frames[2 * i]);
+            ASSERT_EQ(static_cast<int16_t>(~(received + i)), frames[2 * i + 1]);
+        }
+        received += count;
+        this_thread::yield();
+    }
+    writer.join();
+}
+
+/*
+ * Test that the output plays the frames in order at the rate of the audio,
+ * holding the emulator back when it gets ahead, without running dry.
+ */
+TEST(Audio_Output_Test, Paces_Writer) {
+    char path[] = "/tmp/audio_output_test_XXXXXX";
+    close(mkstemp(path));
+
+    AudioOutput output(path);
+    ASSERT_TRUE(output.is_open());
+
+    // A quarter of a second, written as fast as the output will take it.
+    int blocks = AUDIO_SAMPLE_RATE / 4 / AUDIO_BLOCK_FRAMES;
+    vector<int16_t> block(AUDIO_BLOCK_FRAMES * 2);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (int n = 0; n < blocks; n++) {
+        for (int i = 0; i < AUDIO_BLOCK_FRAMES * 2; i++) {
+            block[i] = static_cast<int16_t>(n * AUDIO_BLOCK_FRAMES * 2 + i);
+        }
+        output.write_frames(block.data(), AUDIO_BLOCK_FRAMES);
+
+        EXPECT_GE(output.get_rate_ratio(), 1 - AUDIO_MAX_RATE_DELTA);
+        EXPECT_LE(output.get_rate_ratio(), 1 + AUDIO_MAX_RATE_DELTA);
+    }
+
+    // Everything but the frames still waiting has been played.
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double played = static_cast<double>(blocks * AUDIO_BLOCK_FRAMES - AUDIO_LATENCY_FRAMES) / AUDIO_SAMPLE_RATE;
+    EXPECT_GT(elapsed, played * 0.9);
+
+    output.close();
+    EXPECT_EQ(0, output.get_underruns());
+    EXPECT_LT(output.get_max_latency(), 40);
+
+    vector<int16_t> samples(blocks * AUDIO_BLOCK_FRAMES * 2);
+    FILE *file = fopen(path, "rb");
+    size_t count = fread(samples.data(), sizeof(int16_t), samples.size(), file);
+    fclose(file);
+    remove(path);
+
+    ASSERT_GT(count, 0);
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(static_cast<int16_t>(i), samples[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,141 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that recordings can be written, read back exactly and seeked.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/capture/recording.h"
+
+using namespace testing;
+
+/*
+ * Fill a frame with a pattern that moves a little every frame, like a
+ * sprite moving over a static background.
+ */
+void fill_frame(uint8_t *frame, int n) {
+    for (int i = 0; i < RECORDING_FRAME_SIZE; i++) {
+        frame[i] = static_cast<uint8_t>((i / RECORDING_LINE_SIZE) & 0x0F);
+    }
+    for (int y = 0; y < 8; y++) {
+        frame[(y + n % 100) * RECORDING_LINE_SIZE + n % RECORDING_LINE_SIZE] = 0xFF;
+    }
+}
+
+/*
+ * Test that data decodes to exactly what was encoded, including runs and
+ * literal blocks that are longer than a single control byte can describe.
+ */
+TEST(Recording_Test, RLE_Round_Trip) {
+    uint32_t size = 4096;
+    uint8_t *data = random_byte_array(size);
+    uint8_t *encoded = new uint8_t[size + size / 128 + 1];
+    uint8_t *decoded = new uint8_t[size];
+
+    // Mix random bytes with runs of every length.
+    for (uint32_t i = 0, run = 1; i + run < size; i += run * 2, run = run % 300 + 1) {
+        memset(data + i, data[i], run);
+    }
+
+    size_t length = rle_encode(data, size, encoded);
+    ASSERT_LE(length, size + size / 128 + 1);
+    ASSERT_TRUE(rle_decode(encoded, length, decoded, size));
+    ASSERT_EQ(0, memcmp(data, decoded, size));
+
+    // Truncated input can't decode to the full size.
+    ASSERT_FALSE(rle_decode(encoded, length - 1, decoded, size));
+
+    memset(data, 0, size);
+    ASSERT_EQ(64, rle_encode(data, size, encoded));
+
+    delete[] data;
+    delete[] encoded;
+    delete[] decoded;
+}
+
+/*
+ * Test that every frame of a recording reads back exactly, that frames can be
+ * read in any order, and that unchanged frames take up almost no space.
+ */
+TEST(Recording_Test, Write_Read_Seek) {
+    const char *path = "recording_unit_test.gbrec";
+    const int num_frames = 250;
+    uint8_t frame[RECORDING_FRAME_SIZE];
+
+    FILE *file = fopen(path, "wb");
+    RecordingWriter writer(file, FRAME_CYCLES, 60);
+    for (int n = 0; n < num_frames; n++) {
+        fill_frame(frame, n / 2); // Every other frame is repeated.
+        writer.write_frame(frame);
+    }
+    writer.finish();
+    fclose(file);
+
+    // Far smaller than the 2 bit frames themselves.
+    ASSERT_LT(writer.get_bytes_written(), num_frames * RECORDING_FRAME_SIZE / 20);
+
+    RecordingReader reader(path);
+    ASSERT_TRUE(reader.is_open());
+    ASSERT_EQ(num_frames, reader.get_num_frames());
+    ASSERT_EQ(FRAME_CYCLES, reader.get_frame_duration());
+
+    for (int n = 0; n < num_frames; n++) {
+        ASSERT_TRUE(reader.read_frame());
+        fill_frame(frame, n / 2);
+        ASSERT_EQ(0, memcmp(frame, reader.get_frame(), RECORDING_FRAME_SIZE));
+    }
+    ASSERT_FALSE(reader.read_frame());
+
+    for (int i = 0; i < 50; i++) {
+        int n = rand() % num_frames;
+        ASSERT_TRUE(reader.seek(n));
+        ASSERT_TRUE(reader.read_frame());
+        fill_frame(frame, n / 2);
+        ASSERT_EQ(0, memcmp(frame, reader.get_frame(), RECORDING_FRAME_SIZE));
+    }
+    ASSERT_FALSE(reader.seek(num_frames));
+
+    remove(path);
+}
+
+/*
+ * Test that a recording that was cut short can still be read up to the last
+ * complete frame.
+ */
+TEST(Recording_Test, Read_Without_Index) {
+    const char *path = "recording_unit_test_cut.gbrec";
+    uint8_t frame[RECORDING_FRAME_SIZE];
+
+    FILE *file = fopen(path, "wb");
+    RecordingWriter writer(file, FRAME_CYCLES, 10);
+    for (int n = 0; n < 35; n++) {
+        fill_frame(frame, n);
+        writer.write_frame(frame);
+    }
+    fclose(file);
+
+    RecordingReader reader(path);
+    ASSERT_TRUE(reader.is_open());
+    ASSERT_EQ(35, reader.get_num_frames());
+
+    ASSERT_TRUE(reader.seek(27));
+    ASSERT_TRUE(reader.read_frame());
+    fill_frame(frame, 27);
+    ASSERT_EQ(0, memcmp(frame, reader.get_frame(), RECORDING_FRAME_SIZE));
+
+    remove(path);
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
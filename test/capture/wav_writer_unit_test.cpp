@@ -0,0 +1,132 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the WAV writer, and the audio hash it keeps.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/memory/memory.h"
+#include "../../src/capture/wav_writer.h"
+
+using namespace testing;
+
+/*
+ * Play a square wave on channel 2 into a sink for a tenth of a second.
+ */
+void play_square_wave(AudioSink *sink) {
+    APU apu;
+    apu.set_sink(sink);
+
+    apu.store_byte(NR_51, 0x22);
+    apu.store_byte(NR_22, 0xF0);
+    apu.store_byte(NR_23, 0x00);
+    apu.store_byte(NR_24, 0x87);
+
+    for (int i = 0; i < APU_CLOCK_RATE / 10; i += 4) {
+        apu.tick(4);
+    }
+    apu.set_sink(nullptr);
+}
+
+/*
+ * @return: The contents of a file.
+ */
+vector<uint8_t> read_whole_file(const string & path) {
+    vector<uint8_t> data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file != nullptr) {
+        uint8_t buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            data.insert(data.end(), buffer, buffer + n);
+        }
+        fclose(file);
+    }
+    return data;
+}
+
+uint32_t get_le32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+}
+
+/*
+ * Test that the main file and the stems are valid WAV files holding every
+ * frame, and that only the channel that is playing has a stem with sound in it.
+ */
+TEST(Wav_Writer_Test, Writes_Mix_And_Stems) {
+    string path = "/tmp/wav_writer_test.wav";
+    WavWriter wav(path.c_str(), true);
+    ASSERT_TRUE(wav.is_open());
+
+    play_square_wave(&wav);
+    wav.close();
+
+    uint64_t frames = wav.get_frames_written();
+    EXPECT_NEAR(AUDIO_SAMPLE_RATE / 10, frames, 1);
+
+    vector<uint8_t> mix = read_whole_file(path);
+    ASSERT_EQ(WAV_HEADER_SIZE + frames * 4, mix.size());
+    EXPECT_EQ(0, memcmp(mix.data(), "RIFF", 4));
+    EXPECT_EQ(mix.size() - 8, get_le32(&mix[4]));
+    EXPECT_EQ(0, memcmp(&mix[8], "WAVEfmt ", 8));
+    EXPECT_EQ(2, mix[22]);
+    EXPECT_EQ(AUDIO_SAMPLE_RATE, get_le32(&mix[24]));
+    EXPECT_EQ(frames * 4, get_le32(&mix[40]));
+    remove(path.c_str());
+
+    const char *names[] = {"_square1", "_square2", "_wave", "_noise"};
+    for (int channel = 0; channel < NUM_SOUND_CHANNELS; channel++) {
+        string stem_path = string("/tmp/wav_writer_test") + names[channel] + ".wav";
+        vector<uint8_t> stem = read_whole_file(stem_path);
+        remove(stem_path.c_str());
+
+        ASSERT_EQ(WAV_HEADER_SIZE + frames * 2, stem.size());
+        EXPECT_EQ(1, stem[22]);
+
+        bool silent = true;
+        for (size_t i = WAV_HEADER_SIZE; i < stem.size(); i++) {
+            silent = silent and stem[i] == 0;
+        }
+        EXPECT_EQ(channel != SQUARE_2, silent);
+    }
+}
+
+/*
+ * Test that the audio hash is the same with and without a file, and changes
+ * with the audio.
+ */
+TEST(Wav_Writer_Test, Audio_Hash) {
+    string path = "/tmp/wav_writer_hash_test.wav";
+    WavWriter wav(path.c_str(), false);
+    play_square_wave(&wav);
+    wav.close();
+    remove(path.c_str());
+
+    WavWriter hash_only(nullptr, false);
+    EXPECT_FALSE(hash_only.is_open());
+    play_square_wave(&hash_only);
+    EXPECT_EQ(wav.get_audio_hash(), hash_only.get_audio_hash());
+    EXPECT_EQ(0, hash_only.get_frames_written());
+
+    WavWriter silence(nullptr, false);
+    APU apu;
+    apu.set_sink(&silence);
+    for (int i = 0; i < APU_CLOCK_RATE / 10; i += 4) {
+        apu.tick(4);
+    }
+    apu.set_sink(nullptr);
+    EXPECT_NE(wav.get_audio_hash(), silence.get_audio_hash());
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -53,6 +53,32 @@ TEST(CPU_Test, Test_NOP) {
     EXPECT_EQ(0x101, cpu.PC);
 }
 
+/*
+ * Test that STOP does nothing until a button is held down on a selected line.
+ */
+TEST(CPU_Test, Test_STOP) {
+    StrictMock<MockMemory> memory;
+    CPU cpu = CPU(memory);
+
+    EXPECT_CALL(memory, load_byte(0x0100)).Times(1).WillOnce(Return(0x10));
+
+    cpu.execute_next_instr();
+    EXPECT_EQ(0x102, cpu.PC);
+    EXPECT_TRUE(cpu.is_stopped());
+
+    // Nothing is read while stopped.
+    EXPECT_EQ(4, cpu.execute_next_instr());
+    EXPECT_TRUE(cpu.is_stopped());
+
+    memory.set_buttons(1 << BUTTON_START);
+    cpu.execute_next_instr();
+    EXPECT_FALSE(cpu.is_stopped());
+
+    EXPECT_CALL(memory, load_byte(0x0102)).Times(1).WillOnce(Return(0x00));
+    cpu.execute_next_instr();
+    EXPECT_EQ(0x103, cpu.PC);
+}
+
 /*
  * Test that LD (nn), SP instruction works correctly.
  */
@@ -927,6 +953,148 @@ TEST(CPU_Test, RR_r) {
     EXPECT_EQ(0x0100 + 2, cpu.PC);
 }
 
+/*
+ * Test that instructions that change (HL) write IO registers with store_byte,
+ * and that LD (HL) doesn't read them first.
+ */
+TEST(CPU_Test, HL_addr_IO_Register) {
+    StrictMock<MockMemory> memory;
+    CPU cpu = CPU(memory);
+
+    // LD (HL), A
+    EXPECT_CALL(memory, load_byte(0x0100)).Times(1).WillOnce(Return(0x77));
+    EXPECT_CALL(memory, store_byte(DIV, 0x12)).Times(1);
+
+    cpu.PC = 0x0100;
+    cpu.HL = DIV;
+    cpu.A = 0x12;
+    cpu.fetch_execute_instruction();
+    EXPECT_EQ(0x0100 + 1, cpu.PC);
+
+    // SET 7, (HL)
+    EXPECT_CALL(memory, load_byte(0x0100)).Times(1).WillOnce(Return(0xCB));
+    EXPECT_CALL(memory, load_byte(0x0100 + 1)).Times(1).WillOnce(Return(0xFE));
+    EXPECT_CALL(memory, load_byte(TAC)).Times(1).WillOnce(Return(0x05));
+    EXPECT_CALL(memory, store_byte(TAC, 0x85)).Times(1);
+
+    cpu.PC = 0x0100;
+    cpu.HL = TAC;
+    cpu.fetch_execute_instruction();
+    EXPECT_EQ(0x0100 + 2, cpu.PC);
+
+    // INC (HL)
+    EXPECT_CALL(memory, load_byte(0x0100)).Times(1).WillOnce(Return(0x34));
+    EXPECT_CALL(memory, load_byte(TIMA)).Times(1).WillOnce(Return(0xFF));
+    EXPECT_CALL(memory, store_byte(TIMA, 0x00)).Times(1);
+
+    cpu.PC = 0x0100;
+    cpu.HL = TIMA;
+    cpu.fetch_execute_instruction();
+    EXPECT_EQ(1, cpu.Z_);
+    EXPECT_EQ(0x0100 + 1, cpu.PC);
+
+    // LD A, (HL) only reads.
+    EXPECT_CALL(memory, load_byte(0x0100)).Times(1).WillOnce(Return(0x7E));
+    EXPECT_CALL(memory, load_byte(TMA)).Times(1).WillOnce(Return(0x34));
+
+    cpu.PC = 0x0100;
+    cpu.HL = TMA;
+    cpu.fetch_execute_instruction();
+    EXPECT_EQ(0x34, cpu.A);
+}
+
+/*
+ * Test that LD (HL) reaches the sound registers.
+ */
+TEST(CPU_Test, HL_addr_Sound_Register) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    rom[0x100] = 0x77; // LD (HL), A
+    rom[0x101] = 0x77; // LD (HL), A
+    rom[0x102] = 0x36; // LD (HL), n
+    rom[0x103] = 0x35;
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+
+    // Turn the APU off, then back on.
+    cpu.HL = NR_52;
+    cpu.A = 0x00;
+    cpu.execute_next_instr();
+    EXPECT_EQ(0x70, memory.load_byte(NR_52));
+
+    cpu.A = 0x80;
+    cpu.execute_next_instr();
+    EXPECT_EQ(0xF0, memory.load_byte(NR_52));
+
+    cpu.HL = NR_50;
+    cpu.execute_next_instr();
+    EXPECT_EQ(0x35, memory.get_apu().load_byte(NR_50));
+    delete[] rom;
+}
+
+/*
+ * Test that selecting a line with LD (HL) that has a button held down on it
+ * requests the joypad interrupt.
+ */
+TEST(CPU_Test, HL_addr_P1) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    rom[0x100] = 0x77; // LD (HL), A
+    rom[0x101] = 0x36; // LD (HL), n
+    rom[0x102] = 0x10;
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+
+    // Select neither line, then hold down Start.
+    cpu.HL = P1;
+    cpu.A = 0x30;
+    cpu.execute_next_instr();
+    memory.set_buttons(1 << BUTTON_START);
+    memory.store_byte(IF, 0x00);
+
+    // Select A, B, Select and Start.
+    cpu.execute_next_instr();
+    EXPECT_EQ(0xD7, memory.load_byte(P1));
+    EXPECT_EQ(JOYPAD_INTERRUPT_BIT, memory.load_byte(IF) & JOYPAD_INTERRUPT_BIT);
+    delete[] rom;
+}
+
+/*
+ * Test that a transfer started by writing SB and SC through (HL) finishes and
+ * requests the serial interrupt.
+ */
+TEST(CPU_Test, HL_addr_Serial) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    rom[0x100] = 0x36; // LD (HL), n
+    rom[0x101] = 0x42;
+    rom[0x102] = 0x2C; // INC L
+    rom[0x103] = 0x36; // LD (HL), n
+    rom[0x104] = 0x81;
+    rom[0x105] = 0x18; // JR -2
+    rom[0x106] = 0xFE;
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+
+    cpu.HL = SB;
+    memory.store_byte(IF, 0x00);
+    cpu.execute_next_instr();
+    EXPECT_EQ(0x42, memory.load_byte(SB));
+
+    cpu.execute_next_instr();
+    cpu.execute_next_instr();
+    EXPECT_EQ(0xFF, memory.load_byte(SC));
+
+    // With nothing plugged in, the transfer shifts in 0xFF.
+    for (int i = 0; i < 1000 and (memory.load_byte(IF) & 0x08) == 0; i++) {
+        cpu.execute_next_instr();
+    }
+    EXPECT_EQ(0x08, memory.load_byte(IF) & 0x08);
+    EXPECT_EQ(0xFF, memory.load_byte(SB));
+    EXPECT_EQ(0x7F, memory.load_byte(SC));
+    delete[] rom;
+}
+
 int main(int argc, char **argv) {
     srand(time(NULL));
     InitGoogleTest(&argc, argv);
@@ -0,0 +1,197 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that the timer registers worked out on read match a timer that is
+ * updated after every instruction.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/memory/memory.h"
+
+using namespace testing;
+
+/*
+ * A timer that counts the cycles of every instruction, in the way the CPU
+ * used to.
+ */
+struct ReferenceTimer {
+    int div_cycles = 0;
+    int timer_cycles = 0;
+
+    uint8_t div = 0x18;
+    uint8_t tima = 0x00;
+    uint8_t tma = 0x00;
+    uint8_t tac = 0xF8;
+    uint8_t new_timer_value = 0x00;
+
+    bool reload_a = false;
+    bool reload_b = false;
+
+    bool tick(uint32_t cycles) {
+        div_cycles += cycles;
+        timer_cycles += cycles;
+
+        if (div_cycles > 256) {
+            div_cycles -= 256;
+            div += 1;
+        }
+
+        const uint32_t periods[] = {1024, 16, 64, 256};
+        uint32_t period = periods[tac & 0b00000011];
+        bool overflow = false;
+
+        if (!(tac & 0b00000100)) {
+            return false;
+        }
+
+        if (timer_cycles >= 4 && reload_a) {
+            reload_a = false;
+            reload_b = true;
+            tima = new_timer_value;
+        }
+        else if (timer_cycles >= 8 && reload_b) {
+            reload_b = false;
+        }
+
+        while (timer_cycles >= (int) period) {
+            if (tima == 0xFF) {
+                tima = 0x00;
+                overflow = true;
+                new_timer_value = tma;
+                reload_a = true;
+            }
+            else {
+                tima += 1;
+            }
+            timer_cycles -= period;
+        }
+        return overflow;
+    }
+
+    void write(uint16_t address, uint8_t value) {
+        if (address == DIV) {
+            div = 0;
+            div_cycles = 0;
+            timer_cycles = 0;
+        }
+        else if (address == TIMA) {
+            if (reload_a) {
+                new_timer_value = value;
+            }
+            else if (!reload_b) {
+                tima = value;
+            }
+        }
+        else if (address == TMA) {
+            if (reload_b) {
+                tima = value;
+            }
+            tma = value;
+            new_timer_value = value;
+        }
+        else {
+            tac = value | 0b11111000;
+        }
+    }
+};
+
+void write(Timer & timer, uint16_t address, uint8_t value) {
+    if (address == DIV) {
+        timer.reset_div();
+    }
+    else if (address == TIMA) {
+        timer.write_tima(value);
+    }
+    else if (address == TMA) {
+        timer.write_tma(value);
+    }
+    else {
+        timer.write_tac(value);
+    }
+}
+
+/*
+ * Run both timers through random instructions and register writes, and check
+ * that they agree after every instruction.
+ */
+TEST(Timer_Test, Matches_Reference_Timer) {
+    const uint32_t instruction_cycles[] = {4, 8, 12, 16, 20, 24};
+    const uint16_t registers[] = {DIV, TIMA, TMA, TAC};
+
+    for (int run = 0; run < 20; run++) {
+        Timer timer;
+        ReferenceTimer reference;
+
+        for (int i = 0; i < 200000; i++) {
+            if (rand() % 500 == 0) {
+                uint16_t address = registers[rand() % 4];
+                uint8_t value = random_byte();
+
+                // Mostly write values that overflow soon.
+                if (address != TAC and rand() % 2 == 0) {
+                    value = 0xF0 | (value & 0x0F);
+                }
+
+                write(timer, address, value);
+                reference.write(address, value);
+            }
+
+            uint32_t cycles = instruction_cycles[rand() % 6];
+            ASSERT_EQ(reference.tick(cycles), timer.tick(cycles)) << "instruction " << i;
+            ASSERT_EQ(reference.div, timer.load_byte(DIV)) << "instruction " << i;
+            ASSERT_EQ(reference.tima, timer.load_byte(TIMA)) << "instruction " << i;
+        }
+    }
+}
+
+/*
+ * Test that cycles counted while the timer is disabled are added to TIMA once
+ * it is enabled again.
+ */
+TEST(Timer_Test, Disabled_Cycles_Are_Kept) {
+    Timer timer;
+    timer.write_tac(0b101); // Increment every 16 cycles.
+    timer.tick(32);
+    EXPECT_EQ(2, timer.load_byte(TIMA));
+
+    timer.write_tac(0b001);
+    timer.tick(64);
+    EXPECT_EQ(2, timer.load_byte(TIMA));
+
+    timer.write_tac(0b101);
+    timer.tick(16);
+    EXPECT_EQ(7, timer.load_byte(TIMA));
+}
+
+/*
+ * Test that an overflow requests an interrupt, and that TIMA is reloaded with
+ * TMA an instruction later.
+ */
+TEST(Timer_Test, Overflow_Reloads_TMA) {
+    Timer timer;
+    timer.write_tma(0x42);
+    timer.write_tima(0xFE);
+    timer.write_tac(0b101);
+
+    EXPECT_FALSE(timer.tick(16));
+    EXPECT_EQ(0xFF, timer.load_byte(TIMA));
+
+    EXPECT_TRUE(timer.tick(16));
+    EXPECT_EQ(0x00, timer.load_byte(TIMA));
+
+    EXPECT_FALSE(timer.tick(4));
+    EXPECT_EQ(0x42, timer.load_byte(TIMA));
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
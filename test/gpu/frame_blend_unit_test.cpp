@@ -0,0 +1,101 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the LCD ghosting blend.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/gpu/frame_blend.h"
+
+using namespace testing;
+
+vector<Pixel> random_frame() {
+    vector<Pixel> frame(NUM_PIXELS);
+    uint8_t *bytes = random_byte_array(NUM_PIXELS * 4);
+    memcpy(frame.data(), bytes, NUM_PIXELS * 4);
+    delete[] bytes;
+    return frame;
+}
+
+/*
+ * Test that each channel moves towards the new frame by the distance scaled
+ * by 1 - persistence, rounded up.
+ */
+TEST(Frame_Blend_Test, Blend_Matches_Formula) {
+    FrameBlend blend(0.75); // A weight of 192 out of 256.
+    vector<Pixel> history = random_frame();
+    blend.apply(history.data());
+
+    for (int n = 0; n < 4; n++) {
+        vector<Pixel> frame = random_frame();
+        vector<Pixel> blended = frame;
+        blend.apply(blended.data());
+
+        const uint8_t *c = reinterpret_cast<const uint8_t *>(frame.data());
+        const uint8_t *h = reinterpret_cast<const uint8_t *>(history.data());
+        const uint8_t *b = reinterpret_cast<const uint8_t *>(blended.data());
+
+        for (int i = 0; i < NUM_PIXELS * 4; i++) {
+            int distance = c[i] > h[i] ? c[i] - h[i] : h[i] - c[i];
+            int step = (distance * 64 + 255) >> 8;
+            ASSERT_EQ(c[i] > h[i] ? h[i] + step : h[i] - step, b[i]);
+        }
+        ASSERT_FALSE(blend.is_settled());
+        history = blended;
+    }
+}
+
+/*
+ * Test that the blend reaches a still frame exactly, and reports that it has
+ * settled once it does.
+ */
+TEST(Frame_Blend_Test, Settles_On_Still_Frame) {
+    FrameBlend blend(0.9);
+    vector<Pixel> first = random_frame();
+    vector<Pixel> still = random_frame();
+
+    blend.apply(first.data());
+    ASSERT_TRUE(blend.is_settled());
+
+    int frames = 0;
+    vector<Pixel> frame;
+    do {
+        frame = still;
+        blend.apply(frame.data());
+        frames += 1;
+        ASSERT_LT(frames, 256);
+    } while (!blend.is_settled());
+
+    ASSERT_EQ(0, memcmp(still.data(), frame.data(), NUM_PIXELS * 4));
+}
+
+/*
+ * Test that a persistence of 0 leaves frames unchanged.
+ */
+TEST(Frame_Blend_Test, No_Persistence) {
+    FrameBlend blend(0);
+    vector<Pixel> first = random_frame();
+    blend.apply(first.data());
+
+    vector<Pixel> second = random_frame();
+    vector<Pixel> blended = second;
+    blend.apply(blended.data());
+
+    ASSERT_EQ(0, memcmp(second.data(), blended.data(), NUM_PIXELS * 4));
+    ASSERT_TRUE(blend.is_settled());
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
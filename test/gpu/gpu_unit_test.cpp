@@ -0,0 +1,227 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the timing of the LCD modes, the STAT interrupt, and the lines the GPU
+ * finds changed at the end of each frame.
+ */
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "../../src/gpu/gpu.h"
+
+using namespace testing;
+
+/*
+ * Step the GPU to the end of the frame it is in.
+ */
+void run_frame(GPU & gpu) {
+    uint64_t frame = gpu.get_frame_count();
+    while (gpu.get_frame_count() == frame) {
+        gpu.render_screen(4);
+    }
+}
+
+/*
+ * Step the GPU a cycle at a time until it reaches a line and mode.
+ *
+ * @return: The number of cycles stepped.
+ */
+int run_until(GPU & gpu, Memory & memory, uint8_t ly, uint8_t mode) {
+    int cycles = 0;
+    while (memory.load_byte(LY) != ly or (memory.load_byte(STAT) & 0x03) != mode) {
+        gpu.render_screen(1);
+        cycles += 1;
+    }
+    return cycles;
+}
+
+/*
+ * @return: True if the STAT interrupt has been requested.
+ */
+bool stat_requested(Memory & memory) {
+    return (memory.load_byte(IF) & LCDC_INTERRUPT_BIT) != 0;
+}
+
+/*
+ * Test that the STAT interrupt is requested when the STAT line goes high, and
+ * not again while it stays high from one source to the next.
+ */
+TEST(GPU_Test, STAT_Rising_Edge) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory, true);
+
+    // Use the H-Blank and OAM sources, which follow each other.
+    run_until(gpu, memory, 1, VRAM_ACCESS);
+    memory.store_byte(STAT, 0x28);
+    memory.store_byte(IF, 0x00);
+    gpu.render_screen(0);
+    EXPECT_FALSE(stat_requested(memory));
+
+    run_until(gpu, memory, 1, H_BLANK);
+    EXPECT_TRUE(stat_requested(memory));
+
+    // The line is still high going from H-Blank into OAM access.
+    memory.store_byte(IF, 0x00);
+    run_until(gpu, memory, 2, OAM_ACCESS);
+    EXPECT_FALSE(stat_requested(memory));
+
+    run_until(gpu, memory, 2, VRAM_ACCESS);
+    EXPECT_FALSE(stat_requested(memory));
+
+    run_until(gpu, memory, 2, H_BLANK);
+    EXPECT_TRUE(stat_requested(memory));
+    delete[] rom;
+}
+
+/*
+ * Test that a write to LYC that makes it match LY requests the STAT interrupt
+ * straight away, in the middle of the line.
+ */
+TEST(GPU_Test, LYC_Write_Mid_Line) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory, true);
+
+    run_until(gpu, memory, 5, VRAM_ACCESS);
+    memory.store_byte(STAT, 0x40);
+    memory.store_byte(IF, 0x00);
+    gpu.render_screen(0);
+    EXPECT_FALSE(stat_requested(memory));
+
+    memory.store_byte(LYC, 5);
+    gpu.render_screen(0);
+    EXPECT_TRUE(stat_requested(memory));
+    EXPECT_EQ(5, memory.load_byte(LY));
+    EXPECT_EQ(0x04 | VRAM_ACCESS, memory.load_byte(STAT) & 0x07);
+    delete[] rom;
+}
+
+/*
+ * Test that each line of V-Blank lasts as long as a visible line.
+ */
+TEST(GPU_Test, V_Blank_Line_Length) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory, true);
+
+    run_until(gpu, memory, SCREEN_HEIGHT, V_BLANK);
+    for (int ly = SCREEN_HEIGHT + 1; ly < SCREEN_HEIGHT + V_BLANK_LINES; ly++) {
+        EXPECT_EQ(456, run_until(gpu, memory, ly, V_BLANK));
+    }
+    EXPECT_EQ(456, run_until(gpu, memory, 0, OAM_ACCESS));
+    delete[] rom;
+}
+
+/*
+ * Test that every line is dirty in the first frame, that no line is dirty
+ * when nothing changes, and that only the lines that changed are dirty after.
+ */
+TEST(GPU_Test, Dirty_Lines) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory, true);
+
+    run_frame(gpu);
+    EXPECT_EQ(SCREEN_HEIGHT, gpu.get_num_dirty_lines());
+    EXPECT_TRUE(gpu.is_line_dirty(0));
+    EXPECT_TRUE(gpu.is_line_dirty(SCREEN_HEIGHT - 1));
+
+    run_frame(gpu);
+    EXPECT_EQ(0, gpu.get_num_dirty_lines());
+    EXPECT_FALSE(gpu.is_line_dirty(0));
+
+    // Clear tile 0, and show it in the second row of tiles, lines 8 to 15.
+    for (uint16_t address = 0x8000; address < 0x8010; address++) {
+        memory.store_byte(address, 0x00);
+    }
+    memory.store_byte(0x9800 + 32, 0x00);
+
+    run_frame(gpu);
+    EXPECT_EQ(8, gpu.get_num_dirty_lines());
+    EXPECT_FALSE(gpu.is_line_dirty(7));
+    EXPECT_TRUE(gpu.is_line_dirty(8));
+    EXPECT_TRUE(gpu.is_line_dirty(15));
+    EXPECT_FALSE(gpu.is_line_dirty(16));
+    delete[] rom;
+}
+
+/*
+ * Test that presenting a frame only uploads the lines that changed since the
+ * last frame presented.
+ */
+TEST(GPU_Test, Uploads_Changed_Lines) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory);
+
+    run_frame(gpu);
+    EXPECT_EQ(SCREEN_HEIGHT, gpu.get_num_uploaded_lines());
+
+    run_frame(gpu);
+    EXPECT_EQ(SCREEN_HEIGHT, gpu.get_num_uploaded_lines());
+
+    // Clear tile 0, and show it in the second row of tiles, lines 8 to 15.
+    for (uint16_t address = 0x8000; address < 0x8010; address++) {
+        memory.store_byte(address, 0x00);
+    }
+    memory.store_byte(0x9800 + 32, 0x00);
+
+    run_frame(gpu);
+    EXPECT_EQ(SCREEN_HEIGHT + 8, gpu.get_num_uploaded_lines());
+    delete[] rom;
+}
+
+/*
+ * Test that the frame and line hashes change when one line changes, and stay
+ * the same when nothing does.
+ */
+TEST(GPU_Test, Frame_Hash) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory, true);
+
+    // Tile 0 looks like every other tile until it is changed.
+    memory.store_byte(0x9800 + 32, 0x00);
+    run_frame(gpu);
+    uint64_t frame = gpu.frame_hash();
+    uint64_t lines[SCREEN_HEIGHT];
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        lines[y] = gpu.line_hash(y);
+    }
+
+    run_frame(gpu);
+    EXPECT_EQ(frame, gpu.frame_hash());
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        EXPECT_EQ(lines[y], gpu.line_hash(y));
+    }
+
+    // Clear the top row of tile 0, which is line 8.
+    memory.store_byte(0x8000, 0x00);
+    memory.store_byte(0x8001, 0x00);
+    run_frame(gpu);
+    EXPECT_NE(frame, gpu.frame_hash());
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        if (y == 8) {
+            EXPECT_NE(lines[y], gpu.line_hash(y));
+        }
+        else {
+            EXPECT_EQ(lines[y], gpu.line_hash(y));
+        }
+    }
+    delete[] rom;
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
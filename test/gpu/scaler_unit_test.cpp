@@ -0,0 +1,179 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the vectorized scale filters against a plain implementation of each
+ * filter.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/gpu/scaler.h"
+
+using namespace testing;
+
+const Pixel shades[4] = {WHITE, LIGHT_GREY, DARK_GREY, BLACK};
+
+/*
+ * Generate a frame made of blocks of random shades, so that the frame has
+ * both flat areas and edges.
+ */
+vector<Pixel> random_frame() {
+    vector<Pixel> frame(NUM_PIXELS);
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            if (rand() % 3 == 0 or (x == 0 and y == 0)) {
+                frame[y * SCREEN_WIDTH + x] = shades[rand() % 4];
+            }
+            else if (rand() % 2 == 0 and y > 0) {
+                frame[y * SCREEN_WIDTH + x] = frame[(y - 1) * SCREEN_WIDTH + x];
+            }
+            else {
+                frame[y * SCREEN_WIDTH + x] = frame[y * SCREEN_WIDTH + (x > 0 ? x - 1 : x)];
+            }
+        }
+    }
+    return frame;
+}
+
+/*
+ * @return: The pixel at (x, y), with the edges of the frame repeated.
+ */
+uint32_t pixel_at(const vector<Pixel> & frame, int x, int y) {
+    x = x < 0 ? 0 : (x >= SCREEN_WIDTH ? SCREEN_WIDTH - 1 : x);
+    y = y < 0 ? 0 : (y >= SCREEN_HEIGHT ? SCREEN_HEIGHT - 1 : y);
+
+    const Pixel & p = frame[y * SCREEN_WIDTH + x];
+    return p.b | (p.g << 8) | (p.r << 16) | (p.a << 24);
+}
+
+uint32_t average(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    for (int i = 0; i < 32; i += 8) {
+        result |= ((((a >> i) & 0xFF) + ((b >> i) & 0xFF) + 1) / 2) << i;
+    }
+    return result;
+}
+
+/*
+ * A plain implementation of every filter, one output block at a time.
+ */
+vector<uint32_t> reference_scale(ScaleFilter filter, const vector<Pixel> & frame) {
+    int factor = scale_factor(filter);
+    int width = SCREEN_WIDTH * factor;
+    vector<uint32_t> out(NUM_PIXELS * factor * factor);
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            uint32_t a = pixel_at(frame, x - 1, y - 1);
+            uint32_t b = pixel_at(frame, x, y - 1);
+            uint32_t c = pixel_at(frame, x + 1, y - 1);
+            uint32_t d = pixel_at(frame, x - 1, y);
+            uint32_t e = pixel_at(frame, x, y);
+            uint32_t f = pixel_at(frame, x + 1, y);
+            uint32_t g = pixel_at(frame, x - 1, y + 1);
+            uint32_t h = pixel_at(frame, x, y + 1);
+            uint32_t i = pixel_at(frame, x + 1, y + 1);
+
+            uint32_t block[16];
+            for (int k = 0; k < 16; k++) {
+                block[k] = e;
+            }
+
+            bool top_left = d == b and b != f and d != h;
+            bool top_right = b == f and b != d and f != h;
+            bool bottom_left = d == h and d != b and h != f;
+            bool bottom_right = h == f and d != h and b != f;
+
+            if (filter == SCALE_2X) {
+                block[0] = top_left ? d : e;
+                block[1] = top_right ? f : e;
+                block[2] = bottom_left ? d : e;
+                block[3] = bottom_right ? f : e;
+            }
+            else if (filter == XBR_LITE_2X) {
+                uint32_t d_blend = average(d, average(d, e));
+                uint32_t f_blend = average(f, average(f, e));
+                block[0] = top_left ? d_blend : e;
+                block[1] = top_right ? f_blend : e;
+                block[2] = bottom_left ? d_blend : e;
+                block[3] = bottom_right ? f_blend : e;
+            }
+            else if (filter == SCALE_3X) {
+                block[0] = top_left ? d : e;
+                block[1] = (top_left and e != c) or (top_right and e != a) ? b : e;
+                block[2] = top_right ? f : e;
+                block[3] = (top_left and e != g) or (bottom_left and e != a) ? d : e;
+                block[5] = (top_right and e != i) or (bottom_right and e != c) ? f : e;
+                block[6] = bottom_left ? d : e;
+                block[7] = (bottom_left and e != i) or (bottom_right and e != g) ? h : e;
+                block[8] = bottom_right ? f : e;
+            }
+
+            for (int n = 0; n < factor; n++) {
+                for (int m = 0; m < factor; m++) {
+                    out[(y * factor + n) * width + x * factor + m] = block[n * factor + m];
+                }
+            }
+        }
+    }
+    return out;
+}
+
+void check_filter(ScaleFilter filter) {
+    Scaler scaler(filter);
+    vector<Pixel> frame = random_frame();
+    vector<Pixel> out(scaler.get_width() * scaler.get_height());
+
+    scaler.scale(frame.data(), out.data());
+    vector<uint32_t> expected = reference_scale(filter, frame);
+
+    ASSERT_EQ(expected.size(), out.size());
+    for (size_t k = 0; k < out.size(); k++) {
+        const Pixel & p = out[k];
+        ASSERT_EQ(expected[k], p.b | (p.g << 8) | (p.r << 16) | (p.a << 24)) << "pixel " << k;
+    }
+
+    // The worker thread produces the same frame.
+    scaler.submit(frame.data());
+    const Pixel *scaled = scaler.wait();
+    for (size_t k = 0; k < out.size(); k++) {
+        ASSERT_TRUE(out[k] == scaled[k]);
+    }
+}
+
+TEST(Scaler_Test, Nearest_2X) {
+    check_filter(NEAREST_2X);
+}
+
+TEST(Scaler_Test, Nearest_3X) {
+    check_filter(NEAREST_3X);
+}
+
+TEST(Scaler_Test, Nearest_4X) {
+    check_filter(NEAREST_4X);
+}
+
+TEST(Scaler_Test, Scale_2X) {
+    check_filter(SCALE_2X);
+}
+
+TEST(Scaler_Test, Scale_3X) {
+    check_filter(SCALE_3X);
+}
+
+TEST(Scaler_Test, XBR_Lite_2X) {
+    check_filter(XBR_LITE_2X);
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
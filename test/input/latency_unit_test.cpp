@@ -0,0 +1,92 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that the latency probe follows button presses to the screen.
+ */
+
+#include <cstdint>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "../../src/input/latency.h"
+
+using namespace testing;
+
+/*
+ * Test that a press is followed from the key event, to the frame the game
+ * reads it in, to the first frame that changes, to when that frame is
+ * presented.
+ */
+TEST(Latency_Test, Follows_Press_To_Screen) {
+    Cartridge cartridge;
+    Memory memory = Memory(cartridge);
+    LatencyProbe latency(memory);
+
+    memory.store_byte(P1, 0x30);
+    memory.set_buttons(1 << BUTTON_A);
+    latency.buttons_polled(5, 1.000);
+
+    // The screen changing before the game has read the button doesn't count.
+    latency.frame_emulated(5, true, 1.010);
+    latency.frame_presented(5, 1.012);
+
+    memory.store_byte(P1, 0x10); // Buttons.
+    memory.load_byte(P1);
+    latency.frame_emulated(6, false, 1.020);
+    latency.frame_emulated(7, true, 1.030);
+    EXPECT_EQ(0, latency.get_samples().size());
+
+    latency.frame_presented(7, 1.045);
+    ASSERT_EQ(1, latency.get_samples().size());
+
+    const LatencySample & sample = latency.get_samples()[0];
+    EXPECT_EQ(5, sample.input_frame);
+    EXPECT_EQ(6, sample.read_frame);
+    EXPECT_EQ(7, sample.output_frame);
+    EXPECT_DOUBLE_EQ(1.000, sample.event_time);
+    EXPECT_DOUBLE_EQ(1.030, sample.output_time);
+    EXPECT_DOUBLE_EQ(1.045, sample.present_time);
+
+    std::ostringstream report;
+    latency.report(report);
+    EXPECT_NE(std::string::npos, report.str().find("1 button changes, 0 with no response"));
+}
+
+/*
+ * Test that presses that the game never reads, or never responds to, are
+ * dropped.
+ */
+TEST(Latency_Test, Drops_Ignored_Presses) {
+    Cartridge cartridge;
+    Memory memory = Memory(cartridge);
+    LatencyProbe latency(memory);
+
+    memory.store_byte(P1, 0x30);
+    memory.set_buttons(1 << BUTTON_START);
+    latency.buttons_polled(0, 0.0);
+
+    // Holding a button isn't a change.
+    latency.buttons_polled(1, 0.0);
+
+    for (uint64_t frame = 0; frame <= LATENCY_TIMEOUT_FRAMES; frame++) {
+        latency.frame_emulated(frame, false, 0.0);
+    }
+    EXPECT_EQ(1, latency.get_dropped());
+    EXPECT_EQ(0, latency.get_samples().size());
+
+    memory.set_buttons(0);
+    latency.buttons_polled(200, 0.0);
+    memory.store_byte(P1, 0x10);
+    memory.load_byte(P1);
+    for (uint64_t frame = 200; frame <= 200 + LATENCY_TIMEOUT_FRAMES; frame++) {
+        latency.frame_emulated(frame, false, 0.0);
+    }
+    EXPECT_EQ(2, latency.get_dropped());
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
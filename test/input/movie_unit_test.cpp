@@ -0,0 +1,128 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests writing and reading input movies.
+ */
+
+#include <cstdint>
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+#include "../../src/input/movie.h"
+#include "../../src/input/joypad.h"
+
+using namespace testing;
+
+/*
+ * @return: The size of a file in bytes.
+ */
+long movie_file_size(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+/*
+ * Test that every frame reads back with the buttons it was recorded with, and
+ * that only changes are written.
+ */
+TEST(Movie_Test, Round_Trip) {
+    const char *path = "/tmp/movie_round_trip_test.gbmovie";
+    uint8_t buttons[1000];
+    for (int frame = 0; frame < 1000; frame++) {
+        // Hold each combination of buttons for 37 frames, with a long gap.
+        buttons[frame] = frame < 300 or frame >= 700 ? (frame / 37) * 29 : 0;
+    }
+
+    MovieWriter writer(path, 0x1234567890ABCDEF, MOVIE_POWER_ON);
+    ASSERT_TRUE(writer.is_open());
+    for (int frame = 0; frame < 1000; frame++) {
+        writer.record(frame, buttons[frame]);
+    }
+    writer.finish();
+    EXPECT_EQ(999, writer.get_num_frames());
+
+    MovieReader reader(path);
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(0x1234567890ABCDEF, reader.get_rom_hash());
+    EXPECT_EQ(MOVIE_POWER_ON, reader.get_start_state());
+    EXPECT_EQ(999, reader.get_num_frames());
+
+    size_t changes = 0;
+    for (int frame = 0; frame < 1000; frame++) {
+        ASSERT_EQ(buttons[frame], reader.get_buttons(frame));
+        changes += frame > 0 and buttons[frame] != buttons[frame - 1];
+    }
+    EXPECT_EQ(changes, reader.get_num_inputs());
+
+    // Each change is a 1 byte frame count, or 2 across the gap, and a button byte.
+    EXPECT_EQ(MOVIE_HEADER_SIZE + changes * 2 + 1, movie_file_size(path));
+
+    // Frames can also be looked up out of order.
+    EXPECT_EQ(buttons[800], reader.get_buttons(800));
+    EXPECT_EQ(buttons[40], reader.get_buttons(40));
+    EXPECT_EQ(buttons[0], reader.get_buttons(0));
+    remove(path);
+}
+
+/*
+ * Test that a movie that was never finished can still be played up to its
+ * last change of buttons.
+ */
+TEST(Movie_Test, Cut_Short) {
+    const char *path = "/tmp/movie_cut_short_test.gbmovie";
+    FILE *file = fopen(path, "wb");
+    ASSERT_NE(nullptr, file);
+
+    const uint8_t movie[] = {
+        'G', 'B', 'M', 'O', 'V', 'I', 'E', 0,
+        MOVIE_VERSION, 0, 0, 0,
+        1, 2, 3, 4, 5, 6, 7, 8,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        10, 1 << BUTTON_START,
+        0x80, 0x01, 0, // 128 frames later.
+        0x05 // A record cut in half.
+    };
+    fwrite(movie, 1, sizeof(movie), file);
+    fclose(file);
+
+    MovieReader reader(path);
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(0x0807060504030201, reader.get_rom_hash());
+    EXPECT_EQ(2, reader.get_num_inputs());
+    EXPECT_EQ(138, reader.get_num_frames());
+    EXPECT_EQ(0, reader.get_buttons(9));
+    EXPECT_EQ(1 << BUTTON_START, reader.get_buttons(10));
+    EXPECT_EQ(1 << BUTTON_START, reader.get_buttons(137));
+    EXPECT_EQ(0, reader.get_buttons(138));
+    remove(path);
+}
+
+/*
+ * Test that files that aren't movies are rejected.
+ */
+TEST(Movie_Test, Rejects_Invalid_Files) {
+    const char *path = "/tmp/movie_invalid_test.gbmovie";
+    FILE *file = fopen(path, "wb");
+    ASSERT_NE(nullptr, file);
+    uint8_t header[MOVIE_HEADER_SIZE] = {'G', 'B', 'R', 'E', 'C'};
+    fwrite(header, 1, sizeof(header), file);
+    fclose(file);
+
+    EXPECT_FALSE(MovieReader(path).is_open());
+    EXPECT_FALSE(MovieReader("/tmp/movie_that_does_not_exist.gbmovie").is_open());
+    remove(path);
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -7,12 +7,51 @@
 
 #include "../../src/cpu/cpu.h"
 #include "../../src/gpu/gpu.h"
-#include "../../src/input/keyboard.h"
+#include "../../src/capture/frame_capture.h"
+#include "../../src/capture/wav_writer.h"
+#include "../../src/input/movie.h"
+#include "../../src/state/save_state.h"
+#include "../../src/state/rewind.h"
 
 using namespace testing;
 
 char file_path[1024];
 
+/*
+ * @return: The contents of a ROM file.
+ */
+uint8_t *read_rom(const char * rom_file_name) {
+    ifstream rom_file = ifstream(rom_file_name);
+    return read_file(rom_file);
+}
+
+/*
+ * A machine running a ROM, set up the way the emulator sets one up.
+ */
+struct Machine {
+    Cartridge cartridge;
+    Memory memory;
+    CPU cpu;
+    GPU gpu;
+
+    /*
+     * @param rom_file_name: The path to the ROM to run.
+     * @param headless: True to run without a window.
+     */
+    Machine(const char * rom_file_name, bool headless)
+        : cartridge(read_rom(rom_file_name)), memory(cartridge), cpu(memory), gpu(memory, headless) {
+    }
+
+    /*
+     * Execute the next instruction, and move the GPU on by the cycles it took.
+     */
+    void step() {
+        uint32_t cycles = cpu.execute_next_instr();
+        cpu.handle_interrupts();
+        gpu.render_screen(cycles);
+    }
+};
+
 /*
  * Execute a ROM for the specified number of cycles.
  *
@@ -21,26 +60,159 @@ char file_path[1024];
  * @return: The hash of the Game Boy screen.
  */
 uint64_t execute_rom(const char * rom_file_name, uint32_t max_instructions) {
-    ifstream rom_file = ifstream(rom_file_name);
+    Machine machine(rom_file_name, false);
 
-    Cartridge cartridge = Cartridge(read_file(rom_file));
-    Memory memory = Memory(cartridge);
-    CPU cpu = CPU(memory);
-    GPU gpu = GPU(memory);
-    Keyboard keyboard = Keyboard(gpu, memory);
+    while (machine.gpu.window_open() && machine.cpu.get_num_instructions() < max_instructions) {
+        machine.step();
+    }
 
-    uint32_t cycles = 0;
+    glfwTerminate();
+    return machine.gpu.screen_hash();
+}
 
-    while (gpu.window_open() && cpu.get_num_instructions() < max_instructions) {
-        cycles = cpu.execute_next_instr();
-        cpu.handle_interrupts();
-        gpu.render_screen(cycles);
+/*
+ * Execute a ROM with the given frame skipping policy.
+ *
+ * @return: The state of the CPU registers after executing the ROM.
+ */
+string execute_rom_with_frame_skip(const char * rom_file_name, uint32_t max_instructions,
+                                   FrameSkip policy, int n) {
+    Machine machine(rom_file_name, false);
+
+    machine.gpu.set_frame_skip(policy, n);
 
-        keyboard.process_key_events();
+    while (machine.gpu.window_open() && machine.cpu.get_num_instructions() < max_instructions) {
+        machine.step();
     }
 
     glfwTerminate();
-    return gpu.screen_hash();
+    return machine.cpu.to_string();
+}
+
+/*
+ * Execute a ROM headless, hashing the audio it plays.
+ *
+ * @return: The hash of the audio.
+ */
+uint64_t execute_rom_audio_hash(const char * rom_file_name, uint32_t max_instructions) {
+    Machine machine(rom_file_name, true);
+    WavWriter audio(nullptr, false);
+
+    machine.memory.get_apu().set_sink(&audio);
+    while (machine.cpu.get_num_instructions() < max_instructions) {
+        machine.step();
+    }
+    machine.memory.get_apu().set_sink(nullptr);
+
+    return audio.get_audio_hash();
+}
+
+/*
+ * Execute a ROM headless for a number of frames, either pressing buttons in a
+ * fixed pattern and recording them to a movie, or playing a movie back.
+ *
+ * @param record_path: The movie to record, or nullptr to play one back.
+ * @param play_path: The movie to play back, or nullptr to record one.
+ * @return: The hash of the screen after every frame and the buttons held down
+ * in the next one, followed by the state of the CPU registers.
+ */
+vector<string> execute_rom_with_movie(const char * rom_file_name, uint64_t frames,
+                                      const char *record_path, const char *play_path) {
+    Machine machine(rom_file_name, true);
+
+    MovieWriter *writer = nullptr;
+    MovieReader *reader = nullptr;
+    if (record_path != nullptr) {
+        writer = new MovieWriter(record_path, machine.cartridge.rom_hash(), MOVIE_POWER_ON);
+    }
+    else {
+        reader = new MovieReader(play_path);
+        EXPECT_EQ(machine.cartridge.rom_hash(), reader->get_rom_hash());
+        EXPECT_EQ(frames, reader->get_num_frames());
+    }
+
+    vector<string> hashes;
+    uint64_t frame = 0;
+    while (machine.gpu.get_frame_count() < frames) {
+        machine.step();
+
+        if (machine.gpu.get_frame_count() != frame) {
+            frame = machine.gpu.get_frame_count();
+            hashes.push_back(to_string(machine.gpu.frame_hash()));
+
+            if (writer != nullptr) {
+                machine.memory.set_buttons(static_cast<uint8_t>((frame / 5) * 37));
+                writer->record(frame, machine.memory.get_buttons());
+            }
+            else {
+                machine.memory.set_buttons(reader->get_buttons(frame));
+            }
+            hashes.back() += " " + to_string(machine.memory.get_buttons());
+        }
+    }
+    hashes.push_back(machine.cpu.to_string());
+
+    delete writer;
+    delete reader;
+    return hashes;
+}
+
+/*
+ * Run a machine for a number of frames, hashing its audio.
+ *
+ * @return: The hash of the screen after every frame, followed by the state of
+ * the CPU registers and the hash of the audio. The number of instructions
+ * executed is left out, since it isn't saved.
+ */
+vector<string> run_frames(Machine & machine, uint64_t frames) {
+    WavWriter audio(nullptr, false);
+    machine.memory.get_apu().set_sink(&audio);
+
+    vector<string> hashes;
+    uint64_t end = machine.gpu.get_frame_count() + frames;
+    uint64_t frame = machine.gpu.get_frame_count();
+    while (machine.gpu.get_frame_count() < end) {
+        machine.step();
+
+        if (machine.gpu.get_frame_count() != frame) {
+            frame = machine.gpu.get_frame_count();
+            hashes.push_back(to_string(machine.gpu.frame_hash()));
+        }
+    }
+    machine.memory.get_apu().set_sink(nullptr);
+
+    string registers = machine.cpu.to_string();
+    hashes.push_back(registers.substr(registers.find("Op:")));
+    hashes.push_back(to_string(audio.get_audio_hash()));
+    return hashes;
+}
+
+/*
+ * Execute a ROM headless, either running it for a number of frames and then
+ * saving its state, or starting it from a saved state.
+ *
+ * @param save_frame: The frame to save the state at, or 0 to load the state.
+ * @param frames: The number of frames to run after the state is saved or
+ * loaded.
+ * @param state: The state to save or load.
+ * @return: What run_frames returns for the frames run after the state was
+ * saved or loaded.
+ */
+vector<string> execute_rom_with_state(const char * rom_file_name, uint64_t save_frame,
+                                      uint64_t frames, StateWriter & state) {
+    Machine machine(rom_file_name, true);
+
+    if (save_frame == 0) {
+        StateReader reader(state.get_data(), state.get_size());
+        EXPECT_EQ(STATE_LOADED, load_state(reader, machine.cpu, machine.gpu, machine.memory));
+        return run_frames(machine, frames);
+    }
+
+    while (machine.gpu.get_frame_count() < save_frame) {
+        machine.step();
+    }
+    save_state(state, machine.cpu, machine.gpu, machine.memory);
+    return run_frames(machine, frames);
 }
 
 /*
@@ -184,6 +356,191 @@ TEST(Memory_Test, Unused_HWIO) {
     ASSERT_EQ(0x7dce967813f, screen_hash);
 }
 
+/*
+ * Test that an OAM DMA transfer blocks the CPU from the source bus for
+ * exactly 160 M-cycles
+ */
+TEST(Timing_Test, OAM_DMA_Timing) {
+    sprintf(file_path, TIMING_TEST_ROM_PATH, "oam_dma_timing.gb");
+    uint64_t screen_hash = execute_rom(file_path, 300000);
+    ASSERT_EQ(0x734cf9f1dbb, screen_hash);
+}
+
+/*
+ * Test that skipping frames does not change the behavior of the game
+ */
+TEST(GPU_Test, Frame_Skip_Preserves_Timing) {
+    sprintf(file_path, CPU_TEST_ROM_PATH, "cpu_reg_f.gb");
+    string expected = execute_rom_with_frame_skip(file_path, 500000, NO_FRAME_SKIP, 1);
+
+    ASSERT_EQ(expected, execute_rom_with_frame_skip(file_path, 500000, RENDER_ONE_IN_N, 4));
+    ASSERT_EQ(expected, execute_rom_with_frame_skip(file_path, 500000, SKIP_ONE_IN_N, 2));
+    ASSERT_EQ(expected, execute_rom_with_frame_skip(file_path, 500000, SKIP_ALL_FRAMES, 1));
+}
+
+/*
+ * Test that LY stays at 0 and no LCD interrupts are requested while the LCD is
+ * off, that frames still end on time, and that the LCD starts again from line
+ * 0 when it is switched back on
+ */
+TEST(GPU_Test, LCD_Off) {
+    Cartridge cartridge;
+    Memory memory = Memory(cartridge);
+    GPU gpu = GPU(memory, true);
+
+    memory.store_byte(IF, 0x00);
+    memory.store_byte(STAT, 0x78); // Every STAT interrupt source.
+    memory.store_byte(LCDC, 0x11);
+    gpu.render_screen(4);
+
+    for (int i = 0; i < FRAME_CYCLES; i += 4) {
+        gpu.render_screen(4);
+        ASSERT_EQ(0, memory.load_byte(LY));
+    }
+    EXPECT_EQ(H_BLANK, memory.load_byte(STAT) & 0x03);
+    EXPECT_EQ(0x00, memory.load_byte(IF) & 0x1F);
+    EXPECT_EQ(1, gpu.get_frame_count());
+
+    memory.store_byte(LCDC, 0x91);
+    gpu.render_screen(4);
+    EXPECT_EQ(OAM_ACCESS, memory.load_byte(STAT) & 0x03);
+
+    gpu.render_screen(LINE_TIME * 3);
+    EXPECT_EQ(3, memory.load_byte(LY));
+}
+
+/*
+ * Test that frames captured while running headless match the frame buffer
+ */
+TEST(Capture_Test, Headless_Raw_Capture) {
+    sprintf(file_path, CPU_TEST_ROM_PATH, "cpu_reg_f.gb");
+    const char *capture_path = "headless_raw_capture.rgba";
+
+    Machine machine(file_path, true);
+    FrameCapture capture(capture_path, RAW_RGBA_CAPTURE, 2);
+
+    machine.gpu.set_capture(&capture);
+    while (machine.gpu.get_frame_count() < 99) {
+        machine.step();
+    }
+    capture.close();
+
+    ASSERT_EQ(50, capture.get_frames_written() + capture.get_frames_dropped());
+
+    // Check the last frame in the file against the frame buffer.
+    ifstream capture_file = ifstream(capture_path, ios::binary);
+    ASSERT_EQ(capture.get_frames_written() * NUM_PIXELS * 4, file_size(capture_file));
+
+    capture_file.seekg(-NUM_PIXELS * 4, ios::end);
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        const Pixel *line = machine.gpu.get_line(y);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            uint8_t rgba[4];
+            capture_file.read((char *)rgba, 4);
+            ASSERT_EQ(line[x].r, rgba[0]);
+            ASSERT_EQ(line[x].g, rgba[1]);
+            ASSERT_EQ(line[x].b, rgba[2]);
+        }
+    }
+    remove(capture_path);
+}
+
+/*
+ * Test that the audio played by a ROM doesn't change
+ */
+TEST(Audio_Test, Audio_Hash) {
+    sprintf(file_path, MEMORY_TEST_ROM_PATH, "mem_timing-2.gb");
+    uint64_t audio_hash = execute_rom_audio_hash(file_path, 2000000);
+    ASSERT_EQ(0x6e38f51fda7e7bf2, audio_hash);
+}
+
+/*
+ * Test that playing back a movie reproduces every frame of the run it was
+ * recorded from
+ */
+TEST(Movie_Test, Replay_Is_Bit_Exact) {
+    sprintf(file_path, CPU_TEST_ROM_PATH, "cpu_reg_f.gb");
+    const char *movie_path = "replay_is_bit_exact.gbmovie";
+
+    vector<string> recorded = execute_rom_with_movie(file_path, 300, movie_path, nullptr);
+    vector<string> replayed = execute_rom_with_movie(file_path, 300, nullptr, movie_path);
+
+    ASSERT_EQ(301, recorded.size());
+    ASSERT_EQ(recorded, replayed);
+    remove(movie_path);
+}
+
+/*
+ * Test that a machine started from a saved state runs exactly like the
+ * machine the state was saved from
+ */
+TEST(State_Test, Load_Resumes_Exactly) {
+    sprintf(file_path, CPU_TEST_ROM_PATH, "instructions_test.gb");
+    StateWriter state;
+
+    vector<string> saved = execute_rom_with_state(file_path, 100, 300, state);
+    vector<string> loaded = execute_rom_with_state(file_path, 0, 300, state);
+
+    ASSERT_EQ(302, saved.size());
+    ASSERT_EQ(saved, loaded);
+}
+
+/*
+ * Test that running a machine again from a snapshot repeats every frame and
+ * all of the audio
+ */
+TEST(State_Test, Snapshot_Replays_Exactly) {
+    sprintf(file_path, CPU_TEST_ROM_PATH, "instructions_test.gb");
+    Machine machine(file_path, true);
+
+    run_frames(machine, 100);
+    vector<uint8_t> arena(snapshot_size(machine.cpu, machine.gpu, machine.memory));
+    snapshot_into(arena.data(), machine.cpu, machine.gpu, machine.memory);
+
+    vector<string> first = run_frames(machine, 300);
+    ASSERT_TRUE(restore_from(arena.data(), machine.cpu, machine.gpu, machine.memory));
+    vector<string> second = run_frames(machine, 300);
+
+    ASSERT_EQ(302, first.size());
+    ASSERT_EQ(first, second);
+}
+
+/*
+ * @return: The hash of the screen and the state of the CPU registers.
+ */
+string machine_state(Machine & machine) {
+    string registers = machine.cpu.to_string();
+    return to_string(machine.gpu.frame_hash()) + " " + registers.substr(registers.find("Op:"));
+}
+
+/*
+ * Test that rewinding steps back through the frames that were played
+ */
+TEST(State_Test, Rewind_Steps_Back) {
+    sprintf(file_path, CPU_TEST_ROM_PATH, "instructions_test.gb");
+    Machine machine(file_path, true);
+    RewindBuffer rewind(machine.cpu, machine.gpu, machine.memory, 5, 1);
+
+    vector<string> states;
+    uint64_t frame = 0;
+    while (machine.gpu.get_frame_count() < 300) {
+        machine.step();
+
+        if (machine.gpu.get_frame_count() != frame) {
+            frame = machine.gpu.get_frame_count();
+            rewind.frame_ended();
+            states.push_back(machine_state(machine));
+        }
+    }
+    ASSERT_EQ(300, rewind.get_num_snapshots());
+
+    for (int i = 0; i < 300; i++) {
+        ASSERT_TRUE(rewind.step_back());
+        ASSERT_EQ(states[299 - i], machine_state(machine));
+    }
+    EXPECT_FALSE(rewind.step_back());
+}
+
 int main(int argc, char **argv) {
     srand(time(NULL));
     InitGoogleTest(&argc, argv);
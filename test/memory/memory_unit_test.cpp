@@ -127,38 +127,220 @@ TEST(Memory_Test, Address_Space_Partitioning_Store_Ops) {
     memory.store_word(ram_addr, 0x5678);
 }
 
-TEST(Memory_Test, Memory_Flags_Access) {
+/*
+ * Test that writes to DIV and TAC go straight to the timer, which increments
+ * TIMA when the write makes the bit it counts fall.
+ */
+TEST(Memory_Test, Timer_Writes) {
     StrictMock<MockCartridge> mock_cartridge;
     Memory memory = Memory(mock_cartridge);
+    Timer & timer = memory.get_timer();
 
-    EXPECT_EQ(false, memory.get_flag(RESET_DIV_CYCLES_FLAG));
-    EXPECT_EQ(false, memory.get_flag(RELOAD_TIMER_A_FLAG));
+    memory.store_byte(TAC, 0b101); // Count bit 3.
+    timer.tick(8);
+    EXPECT_EQ(0x00, memory.load_byte(TIMA));
 
-    memory.set_flag(RESET_DIV_CYCLES_FLAG, true);
-    EXPECT_EQ(true, memory.get_flag(RESET_DIV_CYCLES_FLAG));
-    EXPECT_EQ(false, memory.get_flag(RELOAD_TIMER_A_FLAG));
+    memory.store_byte(DIV, 0x12);
+    EXPECT_EQ(0x00, memory.load_byte(DIV));
+    EXPECT_EQ(0x01, memory.load_byte(TIMA));
 
-    EXPECT_EQ(true, memory.get_flag(RESET_DIV_CYCLES_FLAG));
-    EXPECT_EQ(false, memory.get_flag(RELOAD_TIMER_A_FLAG));
+    timer.tick(8);
+    memory.store_byte(TAC, 0b100); // Count bit 9, which is clear.
+    EXPECT_EQ(0x02, memory.load_byte(TIMA));
+
+    // Disabling the timer is a falling edge too.
+    memory.store_byte(TAC, 0b101);
+    timer.tick(4);
+    memory.store_byte(TAC, 0b001);
+    EXPECT_EQ(0x03, memory.load_byte(TIMA));
+}
 
-    memory.set_flag(RELOAD_TIMER_A_FLAG, true);
-    EXPECT_EQ(true, memory.get_flag(RESET_DIV_CYCLES_FLAG));
-    EXPECT_EQ(true, memory.get_flag(RELOAD_TIMER_A_FLAG));
+/*
+ * Test that writes to the memory that the screen is drawn from are tracked,
+ * and that writes that do not change the memory are ignored.
+ */
+TEST(Memory_Test, Video_Write_Generations) {
+    StrictMock<MockCartridge> mock_cartridge;
+    Memory memory = Memory(mock_cartridge);
 
-    memory.set_flag(RESET_DIV_CYCLES_FLAG, false);
-    EXPECT_EQ(false, memory.get_flag(RESET_DIV_CYCLES_FLAG));
-    EXPECT_EQ(true, memory.get_flag(RELOAD_TIMER_A_FLAG));
+    uint16_t vram_addr = random_word(0x8000, 0xA000);
+    uint16_t oam_addr = random_word(0xFE00, 0xFEA0);
+
+    memory.store_byte(vram_addr, 0x12);
+    memory.store_byte(oam_addr, 0x34);
+    memory.store_byte(SCX, 0x56);
+
+    EXPECT_EQ(1, memory.get_vram_generation());
+    EXPECT_EQ(1, memory.get_oam_generation());
+    EXPECT_EQ(1, memory.get_video_register_generation());
+
+    memory.store_byte(vram_addr, 0x12);
+    memory.store_byte(oam_addr, 0x34);
+    memory.store_byte(SCX, 0x56);
+    memory.store_byte(random_word(0xC000, 0xCFFF), 0x78);
+
+    EXPECT_EQ(1, memory.get_vram_generation());
+    EXPECT_EQ(1, memory.get_oam_generation());
+    EXPECT_EQ(1, memory.get_video_register_generation());
 }
 
-TEST(Memory_Test, Memory_Flags_Write_to_DIV) {
+/*
+ * Test that P1 shows the buttons on the lines the game selected.
+ */
+TEST(Memory_Test, Joypad_Select_Lines) {
     StrictMock<MockCartridge> mock_cartridge;
     Memory memory = Memory(mock_cartridge);
 
-    EXPECT_EQ(false, memory.get_flag(RESET_DIV_CYCLES_FLAG));
+    memory.set_buttons((1 << BUTTON_UP) | (1 << BUTTON_START));
+
+    memory.store_byte(P1, 0x20); // Directions.
+    EXPECT_EQ(0xEB, memory.load_byte(P1));
+
+    memory.store_byte(P1, 0x10); // Buttons.
+    EXPECT_EQ(0xD7, memory.load_byte(P1));
+
+    memory.store_byte(P1, 0x30);
+    EXPECT_EQ(0xFF, memory.load_byte(P1));
+    EXPECT_EQ(0xFF, memory.get_byte_reference(P1));
+}
+
+/*
+ * Test that the joypad interrupt is only raised when a line of P1 goes from
+ * high to low.
+ */
+TEST(Memory_Test, Joypad_Interrupt_Edges) {
+    StrictMock<MockCartridge> mock_cartridge;
+    Memory memory = Memory(mock_cartridge);
+
+    memory.store_byte(P1, 0x20);
+    memory.store_byte(IF, 0x00);
+
+    // Buttons on the line that isn't selected can't be seen.
+    memory.set_buttons(1 << BUTTON_A);
+    EXPECT_EQ(0, memory.load_byte(IF) & JOYPAD_INTERRUPT_BIT);
+
+    memory.set_buttons((1 << BUTTON_A) | (1 << BUTTON_LEFT));
+    EXPECT_EQ(JOYPAD_INTERRUPT_BIT, memory.load_byte(IF) & JOYPAD_INTERRUPT_BIT);
+
+    // Holding or releasing a button isn't an edge.
+    memory.store_byte(IF, 0x00);
+    memory.set_buttons((1 << BUTTON_A) | (1 << BUTTON_LEFT));
+    memory.set_buttons(1 << BUTTON_A);
+    EXPECT_EQ(0, memory.load_byte(IF) & JOYPAD_INTERRUPT_BIT);
+
+    // Selecting a line with a button held down is.
+    memory.store_byte(P1, 0x10);
+    EXPECT_EQ(JOYPAD_INTERRUPT_BIT, memory.load_byte(IF) & JOYPAD_INTERRUPT_BIT);
+}
 
-    memory.store_byte(DIV, 0x00);
+/*
+ * Test that a change of buttons is only read once the game reads P1 with
+ * the changed button's line selected.
+ */
+TEST(Memory_Test, Joypad_Unread_Changes) {
+    StrictMock<MockCartridge> mock_cartridge;
+    Memory memory = Memory(mock_cartridge);
+    Joypad & joypad = memory.get_joypad();
+
+    memory.store_byte(P1, 0x30);
+    memory.set_buttons((1 << BUTTON_DOWN) | (1 << BUTTON_B));
+    EXPECT_EQ((1 << BUTTON_DOWN) | (1 << BUTTON_B), joypad.get_unread());
+
+    memory.load_byte(P1);
+    EXPECT_EQ((1 << BUTTON_DOWN) | (1 << BUTTON_B), joypad.get_unread());
+
+    memory.store_byte(P1, 0x20); // Directions.
+    memory.load_byte(P1);
+    EXPECT_EQ(1 << BUTTON_B, joypad.get_unread());
+
+    // Releasing a button is a change too.
+    memory.set_buttons(1 << BUTTON_B);
+    EXPECT_EQ((1 << BUTTON_DOWN) | (1 << BUTTON_B), joypad.get_unread());
+
+    memory.store_byte(P1, 0x00);
+    memory.load_byte(P1);
+    EXPECT_EQ(0, joypad.get_unread());
+}
+
+/*
+ * Test that the pending interrupts follow IE and IF, however they are written.
+ */
+TEST(Memory_Test, Pending_Interrupts) {
+    StrictMock<MockCartridge> mock_cartridge;
+    Memory memory = Memory(mock_cartridge);
+
+    // The V-Blank interrupt is requested at boot, but not enabled.
+    EXPECT_EQ(0x00, memory.get_pending_interrupts());
+
+    memory.store_byte(IE, 0xFF);
+    EXPECT_EQ(0x01, memory.get_pending_interrupts());
+
+    memory.request_interrupt(0x04);
+    EXPECT_EQ(0x05, memory.get_pending_interrupts());
+
+    memory.store_byte(IF, 0x00);
+    EXPECT_EQ(0x00, memory.get_pending_interrupts());
+
+    memory.store_word(0xFFFE, 0x0000);
+    memory.store_byte(P1, 0x10);
+    memory.set_buttons(1 << BUTTON_A);
+    EXPECT_EQ(0x00, memory.get_pending_interrupts());
+
+    // IE can be written by a push too.
+    memory.store_word(0xFFFE, 0x1000);
+    EXPECT_EQ(0x10, memory.get_pending_interrupts());
+
+    // A write through a reference can't be seen until the mask is refreshed.
+    memory.get_byte_reference(IE) = 0x00;
+    EXPECT_NE(0x00, memory.get_pending_interrupts());
+    EXPECT_EQ(0x00, memory.refresh_pending_interrupts());
+    EXPECT_EQ(0x00, memory.get_pending_interrupts());
+}
+
+/*
+ * Test that an OAM DMA transfer copies one byte every M-cycle, and that the
+ * CPU can only use the bus the transfer isn't using until it's done.
+ */
+TEST(Memory_Test, OAM_DMA_Transfer) {
+    StrictMock<MockCartridge> mock_cartridge;
+    Memory memory = Memory(mock_cartridge);
 
-    EXPECT_EQ(memory.get_flag(RESET_DIV_CYCLES_FLAG), true);
+    for (int i = 0; i < OAM_DMA_LENGTH; i++) {
+        memory.store_byte(0xC100 + i, i + 1);
+    }
+    memory.store_byte(0x8000, 0x12);
+    memory.store_byte(0xFF80, 0x34);
+
+    // The GPU still sees OAM while the CPU can't.
+    uint8_t oam[OAM_DMA_LENGTH];
+    uint8_t unset = memory.load_byte(0xFE00);
+
+    memory.store_byte(DMA, 0xC1);
+    memory.tick_oam_dma(4); // The end of the instruction that wrote DMA.
+    memory.copy(oam, 0xFE00, OAM_DMA_LENGTH);
+    EXPECT_EQ(unset, oam[0]);
+
+    memory.tick_oam_dma(4 * 10);
+    memory.copy(oam, 0xFE00, OAM_DMA_LENGTH);
+    EXPECT_EQ(10, oam[9]);
+    EXPECT_EQ(unset, oam[10]);
+
+    // Work RAM and OAM are blocked, while VRAM, IO and HRAM are not.
+    EXPECT_EQ(0xFF, memory.load_byte(0xC100));
+    EXPECT_EQ(0xFF, memory.load_byte(0xFE00));
+    EXPECT_EQ(0x12, memory.load_byte(0x8000));
+    EXPECT_EQ(0x34, memory.load_byte(0xFF80));
+    EXPECT_EQ(0xC1, memory.load_byte(DMA));
+
+    memory.store_byte(0xC100, 0xAB);
+    memory.tick_oam_dma(4 * (OAM_DMA_LENGTH - 10) - 1);
+    EXPECT_EQ(0xFF, memory.load_byte(0xC100));
+
+    memory.tick_oam_dma(1);
+    EXPECT_EQ(0x01, memory.load_byte(0xC100));
+    for (int i = 0; i < OAM_DMA_LENGTH; i++) {
+        EXPECT_EQ(i + 1, memory.load_byte(0xFE00 + i));
+    }
 }
 
 int main(int argc, char **argv) {
@@ -0,0 +1,161 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests the serial port, on its own and linked to a second serial port
+ * running on another thread.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/memory/memory.h"
+
+using namespace testing;
+
+/*
+ * Test that a transfer with no cable connected shifts in 1 bits, and finishes
+ * after 8 bits.
+ */
+TEST(Serial_Test, No_Cable_Shifts_In_Ones) {
+    Serial serial;
+    serial.write_sb(0x42);
+    serial.write_sc(0x81);
+
+    for (int i = 0; i < SERIAL_TRANSFER_CYCLES - 4; i += 4) {
+        ASSERT_FALSE(serial.tick(4));
+    }
+    EXPECT_EQ(0xFF, serial.load_byte(SC));
+
+    EXPECT_TRUE(serial.tick(4));
+    EXPECT_EQ(0xFF, serial.load_byte(SB));
+    EXPECT_EQ(0x7F, serial.load_byte(SC));
+}
+
+/*
+ * Test that a transfer waiting for an external clock never finishes with no
+ * cable connected.
+ */
+TEST(Serial_Test, External_Clock_Waits) {
+    Serial serial;
+    serial.write_sb(0x42);
+    serial.write_sc(0x80);
+
+    for (int i = 0; i < 100000; i++) {
+        ASSERT_FALSE(serial.tick(4));
+    }
+    EXPECT_EQ(0x42, serial.load_byte(SB));
+    EXPECT_EQ(0xFE, serial.load_byte(SC));
+}
+
+/*
+ * Run a serial port for a number of cycles in random instruction lengths.
+ *
+ * @param on_interrupt: Called with the cycle count after each transfer.
+ */
+template <typename F>
+void run_serial(Serial & serial, uint64_t total_cycles, unsigned seed, F on_interrupt) {
+    const uint32_t instruction_cycles[] = {4, 8, 12, 16, 20, 24};
+    uint64_t cycles = 0;
+
+    while (cycles < total_cycles) {
+        uint32_t elapsed = instruction_cycles[rand_r(&seed) % 6];
+        cycles += elapsed;
+
+        if (serial.tick(elapsed)) {
+            on_interrupt(cycles);
+        }
+    }
+    serial.disconnect();
+}
+
+/*
+ * Test that two linked serial ports on separate threads swap bytes at the
+ * cycle the transfer finishes at.
+ */
+TEST(Serial_Test, Link_Swaps_Bytes) {
+    LinkCable cable;
+    Serial master;
+    Serial slave;
+    master.connect(cable.get_endpoint(0));
+    slave.connect(cable.get_endpoint(1));
+
+    // The slave sends back the byte it received in the transfer before.
+    slave.write_sb(0xA5);
+    slave.write_sc(0x80);
+    master.write_sb(0);
+    master.write_sc(0x81);
+
+    vector<uint8_t> received;
+    vector<uint64_t> master_cycles;
+    vector<uint64_t> slave_cycles;
+
+    std::thread slave_thread([&]() {
+        run_serial(slave, 2100000, rand(), [&](uint64_t cycles) {
+            slave_cycles.push_back(cycles);
+            slave.write_sb(slave.load_byte(SB));
+            slave.write_sc(0x80);
+        });
+    });
+
+    run_serial(master, 2000000, rand(), [&](uint64_t cycles) {
+        master_cycles.push_back(cycles);
+        received.push_back(master.load_byte(SB));
+
+        master.write_sb(static_cast<uint8_t>(received.size()));
+        master.write_sc(0x81);
+    });
+    slave_thread.join();
+
+    ASSERT_GT(received.size(), 100u);
+    EXPECT_EQ(0xA5, received[0]);
+    for (size_t i = 1; i < received.size(); i++) {
+        ASSERT_EQ(static_cast<uint8_t>(i - 1), received[i]);
+    }
+
+    // Each transfer finishes on the first instruction of each emulator that
+    // ends at or after the end of the transfer.
+    ASSERT_LE(master_cycles.size(), slave_cycles.size() + 1);
+    uint64_t start = 0;
+    for (size_t i = 0; i < master_cycles.size() and i < slave_cycles.size(); i++) {
+        uint64_t end = start + SERIAL_TRANSFER_CYCLES;
+        ASSERT_GE(master_cycles[i], end);
+        ASSERT_LT(master_cycles[i], end + 24);
+        ASSERT_GE(slave_cycles[i], end);
+        ASSERT_LT(slave_cycles[i], end + 24);
+        start = master_cycles[i];
+    }
+}
+
+/*
+ * Test that a transfer finishes with 1 bits when the other end of the cable
+ * is unplugged.
+ */
+TEST(Serial_Test, Unplugged_Cable) {
+    LinkCable cable;
+    Serial serial;
+    serial.connect(cable.get_endpoint(0));
+    cable.get_endpoint(1)->disconnect();
+
+    serial.write_sb(0x42);
+    serial.write_sc(0x81);
+
+    bool finished = false;
+    for (int i = 0; i < SERIAL_TRANSFER_CYCLES; i += 4) {
+        finished = serial.tick(4) or finished;
+    }
+    EXPECT_TRUE(finished);
+    EXPECT_EQ(0xFF, serial.load_byte(SB));
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,144 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that deltas are encoded and applied correctly, and that the rewind
+ * buffer steps back through its snapshots in order.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../src/state/rewind.h"
+
+using namespace testing;
+
+/*
+ * Test that applying a delta to either block gives the other.
+ */
+TEST(Rewind_Test, Delta_Round_Trip) {
+    vector<uint8_t> from(10000), to(10000);
+    for (size_t i = 0; i < from.size(); i++) {
+        from[i] = static_cast<uint8_t>(i * 13);
+    }
+    to = from;
+    to[0] ^= 0xFF;
+    to[100] = 1;
+    to[103] = 2;
+    for (size_t i = 5000; i < 5300; i++) {
+        to[i] = 0;
+    }
+    to[9999] ^= 1;
+
+    vector<uint8_t> delta;
+    xor_delta_encode(from.data(), to.data(), from.size(), delta);
+    EXPECT_LT(delta.size(), 350);
+
+    vector<uint8_t> data = from;
+    ASSERT_TRUE(xor_delta_apply(delta, data.data(), data.size()));
+    EXPECT_EQ(to, data);
+    ASSERT_TRUE(xor_delta_apply(delta, data.data(), data.size()));
+    EXPECT_EQ(from, data);
+
+    // Identical blocks have an empty delta.
+    xor_delta_encode(from.data(), from.data(), from.size(), delta);
+    EXPECT_EQ(0, delta.size());
+
+    // A delta that runs past the end of the block is rejected.
+    xor_delta_encode(from.data(), to.data(), from.size(), delta);
+    EXPECT_FALSE(xor_delta_apply(delta, data.data(), 9999));
+}
+
+/*
+ * Run the machine for a number of frames, telling the rewind buffer about
+ * each one.
+ *
+ * @return: The state of the CPU registers at the end of every frame.
+ */
+vector<string> run_frames(CPU & cpu, GPU & gpu, RewindBuffer & rewind, int frames) {
+    vector<string> states;
+    uint64_t end = gpu.get_frame_count() + frames;
+    uint64_t frame = gpu.get_frame_count();
+
+    while (gpu.get_frame_count() < end) {
+        uint32_t cycles = cpu.execute_next_instr();
+        cpu.handle_interrupts();
+        gpu.render_screen(cycles);
+
+        if (gpu.get_frame_count() != frame) {
+            frame = gpu.get_frame_count();
+            rewind.frame_ended();
+
+            string registers = cpu.to_string();
+            states.push_back(registers.substr(registers.find("Op:")));
+        }
+    }
+    return states;
+}
+
+/*
+ * Test that stepping back restores the snapshots in reverse order, and that
+ * only the last few seconds are kept.
+ */
+TEST(Rewind_Test, Steps_Back_In_Order) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    rom[0x100] = 0x3C; // INC A
+    rom[0x101] = 0x18; // JR -3
+    rom[0x102] = 0xFD;
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    // 1 second, with a snapshot every 2 frames, holds 31 snapshots.
+    RewindBuffer rewind(cpu, gpu, memory, 1, 2);
+    vector<string> states = run_frames(cpu, gpu, rewind, 100);
+    ASSERT_EQ(31, rewind.get_num_snapshots());
+
+    for (int i = 0; i < 31; i++) {
+        ASSERT_TRUE(rewind.step_back());
+        string registers = cpu.to_string();
+        EXPECT_EQ(states[99 - 2 * i], registers.substr(registers.find("Op:")));
+    }
+    EXPECT_FALSE(rewind.step_back());
+    EXPECT_EQ(0, rewind.get_num_snapshots());
+
+    // Play on from the oldest snapshot, then step back into the new run.
+    states = run_frames(cpu, gpu, rewind, 4);
+    ASSERT_TRUE(rewind.step_back());
+    string registers = cpu.to_string();
+    EXPECT_EQ(states[3], registers.substr(registers.find("Op:")));
+    delete[] rom;
+}
+
+/*
+ * Test that stepping back keeps the buttons that are held down now, not the
+ * ones that were held when the snapshot was taken.
+ */
+TEST(Rewind_Test, Keeps_Host_Buttons) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    rom[0x100] = 0x18; // JR -2
+    rom[0x101] = 0xFE;
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    RewindBuffer rewind(cpu, gpu, memory, 1, 1);
+    memory.set_buttons(1 << BUTTON_A);
+    run_frames(cpu, gpu, rewind, 1);
+
+    memory.set_buttons(0);
+    ASSERT_TRUE(rewind.step_back());
+    EXPECT_EQ(0, memory.get_buttons());
+    EXPECT_EQ(0xCF, memory.load_byte(P1));
+    delete[] rom;
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that snapshots restore the machine without allocating.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../src/state/save_state.h"
+
+using namespace testing;
+
+// The number of times memory has been allocated with new.
+static atomic<uint64_t> allocations(0);
+
+/*
+ * Count an allocation, and make it with malloc. Every form of new and delete
+ * is replaced, so all memory is freed by the allocator it came from.
+ */
+static void *counted_malloc(size_t size) {
+    allocations += 1;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void *operator new(size_t size) {
+    void *memory = counted_malloc(size);
+    if (memory == nullptr) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    return counted_malloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+    return counted_malloc(size);
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, const nothrow_t &) noexcept {
+    free(memory);
+}
+
+void operator delete[](void *memory, const nothrow_t &) noexcept {
+    free(memory);
+}
+
+/*
+ * Run the machine for a number of instructions.
+ */
+void run_instructions(CPU & cpu, GPU & gpu, int instructions) {
+    for (int i = 0; i < instructions; i++) {
+        uint32_t cycles = cpu.execute_next_instr();
+        cpu.handle_interrupts();
+        gpu.render_screen(cycles);
+    }
+}
+
+/*
+ * Test that taking a snapshot and restoring it doesn't allocate, and puts the
+ * machine back where it was.
+ */
+TEST(Save_State_Test, Snapshot_Does_Not_Allocate) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(MBC5, rom, 0x8000, 0x2000);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    run_instructions(cpu, gpu, 1000);
+    vector<uint8_t> arena(snapshot_size(cpu, gpu, memory));
+    memory.store_byte(0xA000, 0x12);
+
+    uint64_t before = allocations.load();
+    snapshot_into(arena.data(), cpu, gpu, memory);
+    uint16_t pc = cpu.PC;
+    uint8_t wram = memory.load_byte(0xC000);
+
+    run_instructions(cpu, gpu, 1000);
+    memory.store_byte(0xA000, 0x34);
+    memory.store_byte(0xC000, wram + 1);
+    EXPECT_NE(pc, cpu.PC);
+
+    ASSERT_TRUE(restore_from(arena.data(), cpu, gpu, memory));
+    EXPECT_EQ(before, allocations.load());
+
+    EXPECT_EQ(pc, cpu.PC);
+    EXPECT_EQ(0x12, memory.load_byte(0xA000));
+    EXPECT_EQ(wram, memory.load_byte(0xC000));
+    delete[] rom;
+}
+
+/*
+ * Test that a snapshot can only be restored while running the same ROM.
+ */
+TEST(Save_State_Test, Snapshot_Checks_ROM) {
+    uint8_t *rom = new uint8_t[0x8000]();
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, 0x8000, 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    vector<uint8_t> arena(snapshot_size(cpu, gpu, memory));
+    snapshot_into(arena.data(), cpu, gpu, memory);
+
+    uint8_t *other_rom = new uint8_t[0x8000]();
+    other_rom[0] = 1;
+    Cartridge other_cartridge = Cartridge(ROM_ONLY, other_rom, 0x8000, 0);
+    Memory other_memory = Memory(other_cartridge);
+    CPU other_cpu = CPU(other_memory);
+    GPU other_gpu = GPU(other_memory, true);
+
+    EXPECT_FALSE(restore_from(arena.data(), other_cpu, other_gpu, other_memory));
+    EXPECT_TRUE(restore_from(arena.data(), cpu, gpu, memory));
+    delete[] rom;
+    delete[] other_rom;
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
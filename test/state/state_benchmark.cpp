@@ -0,0 +1,85 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Measures how long snapshots and rewinding take. Kept out of the tests, since the times
+ * depend on the machine the benchmark runs on.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "../../src/state/save_state.h"
+#include "../../src/state/rewind.h"
+
+/*
+ * Run a machine for a number of frames.
+ */
+void run_frames(CPU & cpu, GPU & gpu, uint64_t frames) {
+    uint64_t end = gpu.get_frame_count() + frames;
+    while (gpu.get_frame_count() < end) {
+        uint32_t cycles = cpu.execute_next_instr();
+        cpu.handle_interrupts();
+        gpu.render_screen(cycles);
+    }
+}
+
+/*
+ * Measure how long it takes to take a snapshot and restore it.
+ */
+void snapshot_round_trip(CPU & cpu, GPU & gpu, Memory & memory) {
+    vector<uint8_t> arena(snapshot_size(cpu, gpu, memory));
+
+    const int round_trips = 1000;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < round_trips; i++) {
+        snapshot_into(arena.data(), cpu, gpu, memory);
+        restore_from(arena.data(), cpu, gpu, memory);
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+
+    cout << "Snapshot: " << arena.size() << " bytes, " << elapsed.count() / round_trips
+         << " us per round trip" << endl;
+}
+
+/*
+ * Measure how much space each rewind snapshot takes, and how long the slowest
+ * step back takes.
+ */
+void rewind_step_back(CPU & cpu, GPU & gpu, Memory & memory) {
+    RewindBuffer rewind(cpu, gpu, memory, 5, 1);
+    for (int i = 0; i < 300; i++) {
+        run_frames(cpu, gpu, 1);
+        rewind.frame_ended();
+    }
+    double bytes = static_cast<double>(rewind.get_delta_bytes()) / (rewind.get_num_snapshots() - 1);
+
+    double slowest = 0;
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        if (!rewind.step_back()) {
+            break;
+        }
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        slowest = max(slowest, elapsed.count());
+    }
+
+    cout << "Rewind: " << bytes << " bytes per snapshot, slowest step back " << slowest << " ms" << endl;
+}
+
+int main(int argc, char **argv) {
+    char file_path[1024];
+    sprintf(file_path, CPU_TEST_ROM_PATH, "instructions_test.gb");
+    ifstream rom_file = ifstream(file_path);
+
+    Cartridge cartridge = Cartridge(read_file(rom_file));
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    run_frames(cpu, gpu, 100);
+    snapshot_round_trip(cpu, gpu, memory);
+    rewind_step_back(cpu, gpu, memory);
+    return 0;
+}
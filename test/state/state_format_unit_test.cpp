@@ -0,0 +1,169 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that save states are written and read back correctly, and that
+ * damaged states are rejected.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../src/state/state_format.h"
+#include "../../src/state/save_state.h"
+
+using namespace testing;
+
+/*
+ * Write a state with two chunks.
+ */
+void write_test_state(StateWriter & writer) {
+    uint32_t registers[3] = {1, 2, 3};
+    uint8_t ram[100];
+    for (int i = 0; i < 100; i++) {
+        ram[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    writer.begin(0x1234567890ABCDEF);
+    writer.begin_chunk("CPU ");
+    writer.write(registers, sizeof(registers));
+    writer.end_chunk();
+    writer.begin_chunk("MEM ");
+    writer.write(ram, sizeof(ram));
+    writer.end_chunk();
+}
+
+/*
+ * Test that chunks are read back as they were written, in any order.
+ */
+TEST(State_Format_Test, Round_Trip) {
+    StateWriter writer;
+    write_test_state(writer);
+    ASSERT_EQ(STATE_HEADER_SIZE + 2 * STATE_CHUNK_HEADER_SIZE + 12 + 100, writer.get_size());
+
+    StateReader reader(writer.get_data(), writer.get_size());
+    ASSERT_TRUE(reader.is_valid());
+    EXPECT_EQ(STATE_VERSION, reader.get_version());
+    EXPECT_EQ(0x1234567890ABCDEF, reader.get_rom_hash());
+
+    uint8_t ram[100];
+    ASSERT_TRUE(reader.open_chunk("MEM "));
+    ASSERT_TRUE(reader.read(ram, sizeof(ram)));
+    EXPECT_EQ(7, ram[1]);
+    EXPECT_EQ(static_cast<uint8_t>(99 * 7), ram[99]);
+    EXPECT_FALSE(reader.read(ram, 1));
+    EXPECT_TRUE(reader.chunk_finished());
+
+    uint32_t registers[3];
+    ASSERT_TRUE(reader.open_chunk("CPU "));
+    EXPECT_TRUE(reader.chunk_has_size(12));
+    EXPECT_FALSE(reader.chunk_has_size(11));
+    ASSERT_TRUE(reader.read(registers, 8));
+    EXPECT_FALSE(reader.chunk_finished());
+    ASSERT_TRUE(reader.read(registers + 2, 4));
+    EXPECT_EQ(3, registers[2]);
+
+    EXPECT_FALSE(reader.open_chunk("GPU "));
+
+    // Writing a second state reuses the writer.
+    write_test_state(writer);
+    EXPECT_TRUE(StateReader(writer.get_data(), writer.get_size()).is_valid());
+}
+
+/*
+ * Test that a state with a changed byte, or that is cut short, is rejected.
+ */
+TEST(State_Format_Test, Damaged_State) {
+    StateWriter writer;
+    write_test_state(writer);
+    vector<uint8_t> data(writer.get_data(), writer.get_data() + writer.get_size());
+
+    data[data.size() - 10] ^= 1;
+    StateReader damaged(data.data(), data.size());
+    EXPECT_FALSE(damaged.is_valid());
+    EXPECT_FALSE(damaged.open_chunk("CPU "));
+
+    data[data.size() - 10] ^= 1;
+    EXPECT_TRUE(StateReader(data.data(), data.size()).is_valid());
+    EXPECT_FALSE(StateReader(data.data(), data.size() - 1).is_valid());
+    EXPECT_FALSE(StateReader(data.data(), STATE_HEADER_SIZE - 1).is_valid());
+
+    data[0] = 'X';
+    EXPECT_FALSE(StateReader(data.data(), data.size()).is_valid());
+}
+
+/*
+ * Test that a machine state is only loaded if it was saved by the same
+ * version, from the same ROM.
+ */
+TEST(State_Format_Test, Wrong_Version_Or_ROM) {
+    uint8_t rom[0x8000] = {0};
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, sizeof(rom), 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    StateWriter writer;
+    save_state(writer, cpu, gpu, memory);
+    vector<uint8_t> data(writer.get_data(), writer.get_data() + writer.get_size());
+
+    StateReader reader(data.data(), data.size());
+    EXPECT_EQ(STATE_LOADED, load_state(reader, cpu, gpu, memory));
+
+    uint32_t version = STATE_VERSION + 1;
+    memcpy(data.data() + 8, &version, 4);
+    StateReader newer(data.data(), data.size());
+    EXPECT_EQ(STATE_WRONG_VERSION, load_state(newer, cpu, gpu, memory));
+
+    uint8_t other_rom[0x8000] = {1};
+    Cartridge other_cartridge = Cartridge(ROM_ONLY, other_rom, sizeof(other_rom), 0);
+    Memory other_memory = Memory(other_cartridge);
+    CPU other_cpu = CPU(other_memory);
+    StateReader other(writer.get_data(), writer.get_size());
+    EXPECT_EQ(STATE_WRONG_ROM, load_state(other, other_cpu, gpu, other_memory));
+}
+
+/*
+ * Test that a machine state with a chunk of the wrong size is rejected, and
+ * that nothing is changed by it.
+ */
+TEST(State_Format_Test, Wrong_Chunk_Size) {
+    uint8_t rom[0x8000] = {0};
+    Cartridge cartridge = Cartridge(ROM_ONLY, rom, sizeof(rom), 0);
+    Memory memory = Memory(cartridge);
+    CPU cpu = CPU(memory);
+    GPU gpu = GPU(memory, true);
+
+    // The CPU chunk is fine, but the memory chunk has a byte too many.
+    uint8_t extra = 0;
+    cpu.PC = 0x1234;
+    StateWriter writer;
+    writer.begin(cartridge.rom_hash());
+    writer.begin_chunk("CPU ");
+    cpu.save_state(writer);
+    writer.end_chunk();
+    writer.begin_chunk("MEM ");
+    memory.save_state(writer);
+    writer.write(&extra, 1);
+    writer.end_chunk();
+    writer.begin_chunk("CART");
+    cartridge.save_state(writer);
+    writer.end_chunk();
+    writer.begin_chunk("GPU ");
+    gpu.save_state(writer);
+    writer.end_chunk();
+
+    cpu.PC = 0x0100;
+    StateReader reader(writer.get_data(), writer.get_size());
+    ASSERT_TRUE(reader.is_valid());
+    EXPECT_EQ(STATE_INVALID, load_state(reader, cpu, gpu, memory));
+    EXPECT_EQ(0x0100, cpu.PC);
+}
+
+int main(int argc, char **argv) {
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
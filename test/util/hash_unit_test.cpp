@@ -0,0 +1,69 @@
+/*
+ * @author: Viraj Mahesh (virajmahesh@gmail.com)
+ *
+ * Tests that the hash function is consistent and sensitive to its input.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../test_util.h"
+#include "../../src/util/hash.h"
+
+using namespace testing;
+
+/*
+ * Test that the vectorized hash matches the scalar hash for inputs of every
+ * length up to a few blocks.
+ */
+TEST(Hash_Test, Vector_Matches_Scalar) {
+    uint32_t size = HASH_BLOCK_SIZE * 3 + 1;
+    uint8_t *data = random_byte_array(size);
+
+    for (uint32_t length = 0; length <= size; length++) {
+        ASSERT_EQ(hash64_scalar(data, length), hash64(data, length));
+    }
+
+    delete[] data;
+}
+
+/*
+ * Test that flipping any single bit of the input changes the hash.
+ */
+TEST(Hash_Test, Single_Bit_Changes_Hash) {
+    uint32_t size = 640; // One screen line.
+    uint8_t *data = random_byte_array(size);
+    uint64_t hash = hash64(data, size);
+
+    for (uint32_t i = 0; i < size * 8; i++) {
+        data[i / 8] ^= 1 << (i % 8);
+        ASSERT_NE(hash, hash64(data, size));
+        data[i / 8] ^= 1 << (i % 8);
+    }
+    ASSERT_EQ(hash, hash64(data, size));
+
+    delete[] data;
+}
+
+/*
+ * Test that inputs that only differ by trailing zeros have different hashes.
+ */
+TEST(Hash_Test, Length_Changes_Hash) {
+    uint8_t data[HASH_STRIPE_SIZE * 2];
+    memset(data, 0, sizeof(data));
+
+    for (uint32_t length = 1; length < sizeof(data); length++) {
+        ASSERT_NE(hash64(data, length - 1), hash64(data, length));
+    }
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+    InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}